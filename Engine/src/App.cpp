@@ -34,6 +34,7 @@ namespace ash
 		// TODO: load from scene file
 		loadGameObjects();
 		m_graphics->createDescriptorSets(m_gameObjects);
+		m_graphics->printMemoryStats();
 		auto currentTime = std::chrono::high_resolution_clock::now();
 
 		// Create the viewer object which will contain the camera's position and rotation
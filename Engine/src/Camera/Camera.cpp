@@ -89,4 +89,21 @@ namespace ash
 		m_viewMatrix[3][1] = -glm::dot(v, position);
 		m_viewMatrix[3][2] = -glm::dot(w, position);
 	}
+
+	std::array<glm::vec4, 6> Camera::getFrustumPlanes() const
+	{
+		// rows of the view projection matrix combine into the clip planes, depth is zero to one
+		const glm::mat4	viewProjection	{ m_projectionMatrix * m_viewMatrix };
+		const glm::vec4	row0			{ viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0] };
+		const glm::vec4	row1			{ viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1] };
+		const glm::vec4	row2			{ viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2] };
+		const glm::vec4	row3			{ viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3] };
+
+		std::array<glm::vec4, 6> planes{ row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2 };
+		for (glm::vec4& plane : planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return planes;
+	}
 }
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/euler_angles.hpp>
 
+#include <array>
+
 namespace ash
 {
 	/**
@@ -60,6 +62,13 @@ namespace ash
 		 */
 		const glm::mat4& getView() const { return m_viewMatrix; }
 
+		/**
+		 * Returns the world space planes of the view frustum: left, right, bottom, top, near, far.
+		 * xyz is the normalized normal pointing into the frustum and w the distance,
+		 * points inside have dot(plane.xyz, point) + plane.w >= 0
+		 */
+		std::array<glm::vec4, 6> getFrustumPlanes() const;
+
 	private:
 
 		/**
@@ -3,15 +3,25 @@
  */
 #include "GameObjects/GameObject.h"
 
+#include <atomic>
 #include <stdexcept>
 
 namespace ash
 {
-	GameObject::GameObject()
+	namespace
 	{
+		/**
+		 * Next id handed to a GameObject
+		 */
+		std::atomic<uint64_t> nextId{ 1 };
 	}
-	GameObject::GameObject(std::unique_ptr<Model> model) :
-		m_model{ std::move(model) }
+
+	GameObject::GameObject() :
+		m_id{ nextId++ }
+	{
+	}
+	GameObject::GameObject(std::shared_ptr<Model> model) :
+		m_id{ nextId++ }, m_model{ std::move(model) }
 	{
 	}
 
@@ -19,8 +29,8 @@ namespace ash
 	{
 	}
 
-	void GameObject::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, size_t index)
+	void GameObject::enqueue(RenderQueue& queue)
 	{
-		m_model->draw(commandBuffer, pipelineLayout, index, &m_transformComponent);
+		m_model->enqueue(queue, m_transformComponent.mat4());
 	}
 }
\ No newline at end of file
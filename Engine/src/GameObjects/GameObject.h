@@ -16,13 +16,13 @@ namespace ash
 	{
 	public:
 		GameObject();
-		GameObject(std::unique_ptr<Model> model);
+		GameObject(std::shared_ptr<Model> model);
 		~GameObject();
 
 		/**
-		 * Pass through function to Model draw command
+		 * Pass through function to Model enqueue command
 		 */
-		void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, size_t index);
+		void enqueue(RenderQueue& queue);
 
 		/**
 		 * Returns reference to TransformComponent
@@ -36,17 +36,27 @@ namespace ash
 		 */
 		Model* getModel() { return m_model.get(); }
 
+		/**
+		 * Unique for the lifetime of the app, unlike the object's address
+		 */
+		uint64_t getId() const { return m_id; }
+
 	private:
 
+		/**
+		 * Unique for the lifetime of the app
+		 */
+		uint64_t m_id{};
+
 		/**
 		 * Manages transform data for the GameObject
 		 */
 		TransformComponent m_transformComponent{};
 
 		/**
-		 * Contains vertex and texture data of 3D model
+		 * Contains vertex and texture data of 3D model, may be shared with other GameObjects
 		 */
-		std::unique_ptr<Model> m_model{};
+		std::shared_ptr<Model> m_model{};
 
 	};
 }
\ No newline at end of file
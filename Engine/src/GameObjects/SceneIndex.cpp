@@ -0,0 +1,148 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "GameObjects/SceneIndex.h"
+
+#include <algorithm>
+
+namespace ash
+{
+	void SceneIndex::update(const std::vector<std::unique_ptr<GameObject>>& gameObjects)
+	{
+		m_stamp++;
+		size_t seen{ 0 };
+
+		for (auto& gameObject : gameObjects)
+		{
+			if (!gameObject->getModel())
+			{
+				continue;
+			}
+
+			auto	found	{ m_entries.find(gameObject->getId()) };
+			Aabb	box		{};
+			seen++;
+
+			if (found != m_entries.end())
+			{
+				found->second.stamp = m_stamp;
+				continue;
+			}
+
+			Entry entry{ gameObject.get(), DynamicBvh::NULL_NODE, m_stamp };
+			if (getBox(*gameObject, box))
+			{
+				entry.proxy = m_bvh.insert(box, gameObject.get());
+			}
+			else
+			{
+				m_unbounded.push_back(gameObject.get());
+			}
+			m_entries.emplace(gameObject->getId(), entry);
+
+			// the leaf follows the transform from now on
+			gameObject->getTransform().setDirtyList(&m_dirtyIds, gameObject->getId());
+		}
+
+		// entries the loop didn't see belong to objects removed from the scene, they may be destroyed
+		// already so their transforms keep reporting, refit skips ids it doesn't know
+		if (m_entries.size() > seen)
+		{
+			for (auto it = m_entries.begin(); it != m_entries.end();)
+			{
+				if (it->second.stamp == m_stamp)
+				{
+					++it;
+					continue;
+				}
+
+				if (it->second.proxy != DynamicBvh::NULL_NODE)
+				{
+					m_bvh.remove(it->second.proxy);
+				}
+				else
+				{
+					m_unbounded.erase(std::find(m_unbounded.begin(), m_unbounded.end(), it->second.object));
+				}
+				it = m_entries.erase(it);
+			}
+		}
+
+		// refit optimizes the tree when anything moved
+		if (!refit())
+		{
+			m_bvh.optimize();
+		}
+	}
+
+	bool SceneIndex::refit()
+	{
+		bool moved{ false };
+		for (uint64_t id : m_dirtyIds)
+		{
+			auto found{ m_entries.find(id) };
+			if (found == m_entries.end())
+			{
+				continue;
+			}
+
+			Aabb box{};
+			moved = true;
+			if (found->second.proxy != DynamicBvh::NULL_NODE && getBox(*found->second.object, box))
+			{
+				m_bvh.move(found->second.proxy, box);
+			}
+		}
+		m_dirtyIds.clear();
+
+		if (moved)
+		{
+			m_bvh.optimize();
+		}
+		return moved;
+	}
+
+	void SceneIndex::queryFrustum(const FrustumPlanes& planes, std::vector<GameObject*>& results) const
+	{
+		m_results.clear();
+		m_bvh.queryFrustum(planes, m_results);
+
+		results.insert(results.end(), m_unbounded.begin(), m_unbounded.end());
+		for (void* object : m_results)
+		{
+			results.push_back(static_cast<GameObject*>(object));
+		}
+	}
+
+	void SceneIndex::querySphere(const glm::vec4& sphere, std::vector<GameObject*>& results) const
+	{
+		m_results.clear();
+		m_bvh.querySphere(sphere, m_results);
+
+		results.insert(results.end(), m_unbounded.begin(), m_unbounded.end());
+		for (void* object : m_results)
+		{
+			results.push_back(static_cast<GameObject*>(object));
+		}
+	}
+
+	void SceneIndex::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<RayHit>& results) const
+	{
+		for (GameObject* object : m_unbounded)
+		{
+			results.push_back(RayHit{ object, 0.0f });
+		}
+		m_bvh.queryRay(origin, direction, maxDistance, results);
+	}
+
+	bool SceneIndex::getBox(GameObject& object, Aabb& box)
+	{
+		glm::vec4 sphere{ transformSphere(object.getTransform().mat4(), object.getModel()->getBounds()) };
+		if (sphere.w < 0.0f)
+		{
+			return false;
+		}
+		box = Aabb::fromSphere(sphere);
+		return true;
+	}
+}
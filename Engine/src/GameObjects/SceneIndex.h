@@ -0,0 +1,111 @@
+/**
+ * Spatial index of the game objects for visibility and gameplay queries
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "GameObjects/GameObject.h"
+#include "Utils/DynamicBvh.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Spatial index of the game objects for visibility and gameplay queries.
+	 * Every game object with a model gets a leaf in a DynamicBvh sized by its model's bounding
+	 * sphere, update adds and removes leaves to follow the objects. The transforms of indexed
+	 * objects report their changes to a dirty list, refit moves only their leaves.
+	 * Objects whose model has no bounds, skinned ones, are kept aside and returned by
+	 * every query. Results point at the objects passed to the last update
+	 */
+	class SceneIndex
+	{
+	public:
+		/**
+		 * Brings the index in line with gameObjects after objects were added or removed, walks
+		 * every object. Objects that moved are refit as well
+		 */
+		void update(const std::vector<std::unique_ptr<GameObject>>& gameObjects);
+
+		/**
+		 * Moves the leaves of the indexed objects whose transform changed since the last update
+		 * or refit, the objects that stayed put cost nothing
+		 * @return true if any indexed object moved
+		 */
+		bool refit();
+
+		/**
+		 * Appends the objects that may intersect the frustum
+		 */
+		void queryFrustum(const FrustumPlanes& planes, std::vector<GameObject*>& results) const;
+
+		/**
+		 * Appends the objects that may intersect sphere, center xyz and radius w
+		 */
+		void querySphere(const glm::vec4& sphere, std::vector<GameObject*>& results) const;
+
+		/**
+		 * Appends the objects whose bounds the ray hits within maxDistance, nearest first.
+		 * RayHit::userData is the GameObject, unbounded objects come first at distance 0
+		 */
+		void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<RayHit>& results) const;
+
+		/**
+		 * Number of indexed game objects
+		 */
+		uint32_t size() const { return static_cast<uint32_t>(m_entries.size()); }
+
+	private:
+
+		/**
+		 * What the index knows of a game object
+		 */
+		struct Entry
+		{
+			GameObject*	object		{};
+			int32_t		proxy		{ DynamicBvh::NULL_NODE };	// null for unbounded objects
+			uint64_t	stamp		{ 0 };							// update that last saw the object
+		};
+
+		/**
+		 * Indexed game objects by id
+		 */
+		std::unordered_map<uint64_t, Entry> m_entries{};
+
+		/**
+		 * Bounding boxes of the bounded objects
+		 */
+		DynamicBvh m_bvh{};
+
+		/**
+		 * Ids of the indexed objects whose transform changed since the last refit, may repeat
+		 * and may name objects removed since
+		 */
+		std::vector<uint64_t> m_dirtyIds{};
+
+		/**
+		 * Objects without bounds, always part of query results
+		 */
+		std::vector<GameObject*> m_unbounded{};
+
+		/**
+		 * Number of updates, marks the entries seen by the current one
+		 */
+		uint64_t m_stamp{ 0 };
+
+		/**
+		 * Scratch space of the queries
+		 */
+		mutable std::vector<void*> m_results{};
+
+		/**
+		 * Returns the world space box of object, false if its model has no bounds
+		 */
+		static bool getBox(GameObject& object, Aabb& box);
+	};
+}
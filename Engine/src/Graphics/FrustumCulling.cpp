@@ -0,0 +1,143 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "FrustumCulling.h"
+#include "Utils/CpuFeatures.h"
+
+#if defined(ASH_X86)
+#include <immintrin.h>	// SSE2, AVX2 and FMA
+#endif
+
+#include <algorithm>
+
+namespace ash
+{
+	namespace
+	{
+		void cullSpheresScalar(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t first, uint8_t* visible)
+		{
+			for (size_t i = first; i < spheres.size(); i++)
+			{
+				bool inside{ true };
+				for (const glm::vec4& plane : planes)
+				{
+					float distance{ plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w };
+					inside = inside && distance >= -spheres.radius[i];
+				}
+				visible[i] = (inside || spheres.radius[i] < 0.0f) ? 1 : 0;
+			}
+		}
+
+#if defined(ASH_X86)
+		/**
+		 * Tests 4 spheres per iteration, a sphere is outside when it is entirely behind any plane.
+		 * Returns the number of spheres tested, the remainder is left to the scalar path
+		 */
+		ASH_TARGET("sse2")
+		size_t cullSpheresSse2(const FrustumPlanes& planes, const BoundingSpheres& spheres, uint8_t* visible)
+		{
+			const size_t count{ spheres.size() / 4 * 4 };
+			const __m128 zero{ _mm_setzero_ps() };
+
+			for (size_t i = 0; i < count; i += 4)
+			{
+				const __m128 x{ _mm_loadu_ps(&spheres.x[i]) };
+				const __m128 y{ _mm_loadu_ps(&spheres.y[i]) };
+				const __m128 z{ _mm_loadu_ps(&spheres.z[i]) };
+				const __m128 radius{ _mm_loadu_ps(&spheres.radius[i]) };
+				const __m128 negativeRadius{ _mm_sub_ps(zero, radius) };
+
+				__m128 outside{ _mm_setzero_ps() };
+				for (const glm::vec4& plane : planes)
+				{
+					__m128 distance{ _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w)) };
+					distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+					distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+				}
+
+				// negative radii are always visible
+				const int insideMask	{ ~_mm_movemask_ps(outside) & 0xF };
+				const int alwaysMask	{ _mm_movemask_ps(_mm_cmplt_ps(radius, zero)) };
+				const int mask			{ insideMask | alwaysMask };
+
+				for (size_t lane = 0; lane < 4; lane++)
+				{
+					visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+				}
+			}
+
+			return count;
+		}
+
+		/**
+		 * Same as the SSE2 kernel with 8 spheres per iteration and fused multiply adds
+		 */
+		ASH_TARGET("avx2,fma")
+		size_t cullSpheresAvx2(const FrustumPlanes& planes, const BoundingSpheres& spheres, uint8_t* visible)
+		{
+			const size_t count{ spheres.size() / 8 * 8 };
+			const __m256 zero{ _mm256_setzero_ps() };
+
+			for (size_t i = 0; i < count; i += 8)
+			{
+				const __m256 x{ _mm256_loadu_ps(&spheres.x[i]) };
+				const __m256 y{ _mm256_loadu_ps(&spheres.y[i]) };
+				const __m256 z{ _mm256_loadu_ps(&spheres.z[i]) };
+				const __m256 radius{ _mm256_loadu_ps(&spheres.radius[i]) };
+				const __m256 negativeRadius{ _mm256_sub_ps(zero, radius) };
+
+				__m256 outside{ _mm256_setzero_ps() };
+				for (const glm::vec4& plane : planes)
+				{
+					__m256 distance{ _mm256_fmadd_ps(x, _mm256_set1_ps(plane.x), _mm256_set1_ps(plane.w)) };
+					distance = _mm256_fmadd_ps(y, _mm256_set1_ps(plane.y), distance);
+					distance = _mm256_fmadd_ps(z, _mm256_set1_ps(plane.z), distance);
+					outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+				}
+
+				// negative radii are always visible
+				const int insideMask	{ ~_mm256_movemask_ps(outside) & 0xFF };
+				const int alwaysMask	{ _mm256_movemask_ps(_mm256_cmp_ps(radius, zero, _CMP_LT_OQ)) };
+				const int mask			{ insideMask | alwaysMask };
+
+				// spread the 8 mask bits over 8 bytes
+				const __m128i bits{ _mm_and_si128(
+					_mm_shuffle_epi8(_mm_cvtsi32_si128(mask), _mm_setzero_si128()),
+					_mm_set_epi8(0, 0, 0, 0, 0, 0, 0, 0, -128, 64, 32, 16, 8, 4, 2, 1)) };
+				const __m128i bytes{ _mm_min_epu8(bits, _mm_set1_epi8(1)) };
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(visible + i), bytes);
+			}
+
+			return count;
+		}
+#endif
+	}
+
+	glm::vec4 transformSphere(const glm::mat4& transform, const glm::vec4& sphere)
+	{
+		glm::vec3 center{ transform * glm::vec4(glm::vec3(sphere), 1.0f) };
+		float scale{ std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])))) };
+		return glm::vec4(center, sphere.w < 0.0f ? sphere.w : sphere.w * scale);
+	}
+
+	void cullSpheres(const FrustumPlanes& planes, const BoundingSpheres& spheres, std::vector<uint8_t>& visible)
+	{
+		visible.resize(spheres.size());
+		size_t tested{ 0 };
+
+#if defined(ASH_X86)
+		const CpuFeatures& features{ getCpuFeatures() };
+		if (features.avx2 && features.fma)
+		{
+			tested = cullSpheresAvx2(planes, spheres, visible.data());
+		}
+		else if (features.sse2)
+		{
+			tested = cullSpheresSse2(planes, spheres, visible.data());
+		}
+#endif
+
+		cullSpheresScalar(planes, spheres, tested, visible.data());
+	}
+}
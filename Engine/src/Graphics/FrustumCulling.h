@@ -0,0 +1,66 @@
+/**
+ * Bounding sphere frustum tests, vectorized over many spheres
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Frustum planes, see Camera::getFrustumPlanes
+	 */
+	using FrustumPlanes = std::array<glm::vec4, 6>;
+
+	/**
+	 * Bounding spheres in structure of arrays layout, so the tests load 8 centers at once.
+	 * A negative radius marks a sphere that is always visible
+	 */
+	struct BoundingSpheres
+	{
+		std::vector<float> x		{};
+		std::vector<float> y		{};
+		std::vector<float> z		{};
+		std::vector<float> radius	{};
+
+		void clear()
+		{
+			x.clear();
+			y.clear();
+			z.clear();
+			radius.clear();
+		}
+
+		void add(const glm::vec4& sphere)
+		{
+			x.push_back(sphere.x);
+			y.push_back(sphere.y);
+			z.push_back(sphere.z);
+			radius.push_back(sphere.w);
+		}
+
+		size_t size() const { return radius.size(); }
+	};
+
+	/**
+	 * Moves sphere, center xyz and radius w, into the space transform maps to.
+	 * The radius grows with the largest scale, negative radii are kept
+	 */
+	glm::vec4 transformSphere(const glm::mat4& transform, const glm::vec4& sphere);
+
+	/**
+	 * Sets visible[i] to 1 if sphere i intersects the frustum, 0 otherwise.
+	 * Tests 8 spheres per iteration with AVX2 and FMA, 4 with SSE2, scalar code otherwise
+	 */
+	void cullSpheres(const FrustumPlanes& planes, const BoundingSpheres& spheres, std::vector<uint8_t>& visible);
+}
@@ -0,0 +1,331 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "GpuCuller.h"
+#include "Vulkan/PushConstantData.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <stdexcept>
+
+namespace ash
+{
+	namespace
+	{
+		/**
+		 * Push constant stages of the graphics pipeline layout
+		 */
+		constexpr VkShaderStageFlags PUSH_STAGES{ VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+
+		/**
+		 * Threads per work group of the culling shader
+		 */
+		constexpr uint32_t WORK_GROUP_SIZE{ 64 };
+
+		/**
+		 * A draw to cull, matches CullDraw in cull.comp
+		 */
+		struct CullDraw
+		{
+			glm::vec4	bounds			{};			// sphere in the space of the instance transform
+			uint32_t	indexCount		{ 0 };
+			uint32_t	firstIndex		{ 0 };
+			int32_t		vertexOffset	{ 0 };
+			uint32_t	instance		{ 0 };		// joint palette index of the transform, the draw's first instance
+			uint32_t	group			{ 0 };		// counter of the group
+			uint32_t	firstCommand	{ 0 };		// first command of the group
+			uint32_t	padding[2]		{};
+		};
+
+		/**
+		 * Push constants of cull.comp
+		 */
+		struct CullPushConstants
+		{
+			glm::mat4	viewProjection	{ 1.0f };
+			uint32_t	drawCount		{ 0 };
+			uint32_t	compact			{ 0 };		// 1 appends visible draws to their group, 0 writes every draw in place
+			uint32_t	pass			{ 0 };		// CullPass
+			uint32_t	region			{ 0 };		// first command and counter of the pass
+			uint32_t	depthSize[2]	{};			// size of the depth attachment the pyramid was built from
+			uint32_t	levelCount		{ 0 };
+			uint32_t	padding			{ 0 };
+		};
+
+		VkDeviceSize alignSize(VkDeviceSize size, VkDeviceSize alignment)
+		{
+			return (size + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	GpuCuller::GpuCuller(
+		const LogicalDevice* logicalDevice,
+		const PhysicalDevice* physicalDevice,
+		DescriptorAllocator& descriptors,
+		const JointPalette& palette,
+		uint32_t drawCapacity,
+		uint32_t frameCount,
+		const HiZPyramid* pyramid,
+		const std::string& shaderPath) :
+		m_logicalDevice{ logicalDevice }, m_pyramid{ pyramid }, m_drawCapacity{ drawCapacity }
+	{
+		// the late pass gets its own region of commands and counters
+		const VkDeviceSize regionCount{ pyramid ? 2u : 1u };
+
+		const VkPhysicalDeviceLimits& limits{ physicalDevice->getProperties().limits };
+
+		m_maxDrawIndirectCount	= physicalDevice->getDeviceFeatures().multiDrawIndirect ? std::max(limits.maxDrawIndirectCount, 1u) : 1u;
+
+		// a compacted group must be drawn by a single call, which has to be able to read all of its commands,
+		// otherwise every command is drawn and the culled ones have no instances
+		m_drawIndirectCount		= physicalDevice->supportsDrawIndirectCount() && m_maxDrawIndirectCount >= drawCapacity;
+
+		m_drawSectionSize		= alignSize(sizeof(CullDraw) * static_cast<VkDeviceSize>(drawCapacity), limits.minStorageBufferOffsetAlignment);
+		m_commandSectionSize	= alignSize(sizeof(VkDrawIndexedIndirectCommand) * regionCount * drawCapacity, limits.minStorageBufferOffsetAlignment);
+		m_countSectionSize		= alignSize(sizeof(uint32_t) * regionCount * drawCapacity, limits.minStorageBufferOffsetAlignment);
+
+		m_drawBuffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			m_drawSectionSize * frameCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			logicalDevice->getHostWriteProperties(),
+			MemoryCategory::Dynamic);
+
+		m_commandBuffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			m_commandSectionSize * frameCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			MemoryCategory::Dynamic);
+
+		m_countBuffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			m_countSectionSize * frameCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			MemoryCategory::Dynamic);
+
+		const std::vector<uint32_t> visible(drawCapacity, 1);
+		m_visibilityBuffer = Buffer::createDeviceLocalBuffer(logicalDevice, physicalDevice,
+			sizeof(uint32_t) * static_cast<VkDeviceSize>(drawCapacity), visible.data(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+		m_frames.resize(frameCount);
+		createDescriptorSets(descriptors, palette);
+
+		std::vector<VkDescriptorSetLayout> setLayouts{ m_setLayout };
+		if (pyramid)
+		{
+			setLayouts.push_back(pyramid->getReadSetLayout());
+		}
+
+		m_pipeline = std::make_unique<ComputePipeline>(logicalDevice, setLayouts,
+			static_cast<uint32_t>(sizeof(CullPushConstants)), shaderPath);
+	}
+
+	GpuCuller::~GpuCuller()
+	{
+		// the sets are freed with their allocator's pools
+		vkDestroyDescriptorSetLayout(*m_logicalDevice, m_setLayout, nullptr);
+	}
+
+	void GpuCuller::update(uint32_t frame, const RenderQueue& queue, uint32_t instanceBase)
+	{
+		Frame& state{ m_frames[frame] };
+		state.drawCount = 0;
+		state.groups.clear();
+
+		CullDraw* draws{ reinterpret_cast<CullDraw*>(static_cast<char*>(m_drawBuffer->getMappedData()) + m_drawSectionSize * frame) };
+
+		for (uint32_t i = 0; i < queue.size(); i++)
+		{
+			const DrawCall		call	{ queue.getDrawCall(i) };
+			const DrawCommand&	command	{ *call.command };
+
+			if (call.instanceCount > m_drawCapacity - state.drawCount)
+			{
+				throw std::runtime_error("failed to update culled draws, draw capacity exceeded!");
+			}
+
+			// the queue is sorted by material, so groups stay few
+			if (state.groups.empty() || state.groups.back().textureSet != command.textureSet ||
+				state.groups.back().materialIndex != command.materialIndex || state.groups.back().jointOffset != command.jointOffset)
+			{
+				state.groups.push_back(Group{ command.textureSet, command.materialIndex, command.jointOffset, state.drawCount, 0 });
+			}
+			Group& group{ state.groups.back() };
+
+			for (uint32_t instance = 0; instance < call.instanceCount; instance++)
+			{
+				CullDraw& draw{ draws[state.drawCount++] };
+				draw.bounds			= command.bounds;
+				draw.indexCount		= command.indexCount;
+				draw.firstIndex		= command.firstIndex;
+				draw.vertexOffset	= command.vertexOffset;
+				draw.instance		= instanceBase + call.firstInstance + instance;
+				draw.group			= static_cast<uint32_t>(state.groups.size() - 1);
+				draw.firstCommand	= group.firstCommand;
+			}
+			group.drawCount += call.instanceCount;
+		}
+	}
+
+	void GpuCuller::dispatch(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& viewProjection, uint32_t paletteOffset,
+		CullPass pass) const
+	{
+		const Frame& state{ m_frames[frame] };
+		if (state.drawCount == 0)
+		{
+			return;
+		}
+		if (pass != CullPass::Single && !m_pyramid)
+		{
+			throw std::runtime_error("failed to dispatch culling pass, no depth pyramid!");
+		}
+
+		const uint32_t region{ getRegion(pass) };
+
+		// counters start at zero, the previous use of the region is complete
+		vkCmdFillBuffer(commandBuffer, *m_countBuffer, m_countSectionSize * frame + sizeof(uint32_t) * region,
+			sizeof(uint32_t) * state.groups.size(), 0);
+
+		// the late pass also waits for the early pass's visibility reads
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask	= VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		CullPushConstants push{};
+		push.viewProjection	= viewProjection;
+		push.drawCount		= state.drawCount;
+		push.compact		= m_drawIndirectCount ? 1 : 0;
+		push.pass			= static_cast<uint32_t>(pass);
+		push.region			= region;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, *m_pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getLayout(), 0, 1, &state.descriptorSet, 1, &paletteOffset);
+		if (m_pyramid)
+		{
+			push.depthSize[0]	= m_pyramid->getDepthExtent().width;
+			push.depthSize[1]	= m_pyramid->getDepthExtent().height;
+			push.levelCount		= m_pyramid->getLevelCount();
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getLayout(), 1, 1, &m_pyramid->getReadSet(), 0, nullptr);
+		}
+		vkCmdPushConstants(commandBuffer, m_pipeline->getLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(commandBuffer, (state.drawCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+
+		// the commands and counts are read by the indirect draws
+		VkMemoryBarrier cullBarrier{};
+		cullBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+			1, &cullBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void GpuCuller::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame, CullPass pass) const
+	{
+		constexpr uint32_t STRIDE{ sizeof(VkDrawIndexedIndirectCommand) };
+
+		const Frame&	state			{ m_frames[frame] };
+		const uint32_t	region			{ getRegion(pass) };
+		VkDescriptorSet	boundSet		{};
+		uint32_t		materialIndex	{ UINT32_MAX };
+		int32_t			jointOffset		{ INT32_MIN };
+
+		for (uint32_t i = 0; i < state.groups.size(); i++)
+		{
+			const Group& group{ state.groups[i] };
+
+			// same state tracking as RenderQueue::record, the transform is read by gl_InstanceIndex
+			if (group.textureSet && group.textureSet != boundSet)
+			{
+				boundSet = group.textureSet;
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &boundSet, 0, nullptr);
+			}
+			if (group.materialIndex != materialIndex)
+			{
+				materialIndex = group.materialIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, PUSH_STAGES,
+					offsetof(PushConstantData, materialIndex), sizeof(uint32_t), &materialIndex);
+			}
+			if (group.jointOffset != jointOffset)
+			{
+				jointOffset = group.jointOffset;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, PUSH_STAGES,
+					offsetof(PushConstantData, jointOffset), sizeof(int32_t), &jointOffset);
+			}
+
+			const VkDeviceSize commandOffset{ m_commandSectionSize * frame + VkDeviceSize{ STRIDE } * (region + group.firstCommand) };
+			if (m_drawIndirectCount)
+			{
+				vkCmdDrawIndexedIndirectCount(commandBuffer, *m_commandBuffer, commandOffset,
+					*m_countBuffer, m_countSectionSize * frame + sizeof(uint32_t) * (region + i), group.drawCount, STRIDE);
+				continue;
+			}
+
+			// culled commands have no instances, draw them all
+			for (uint32_t first = 0; first < group.drawCount; first += m_maxDrawIndirectCount)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, *m_commandBuffer, commandOffset + VkDeviceSize{ STRIDE } * first,
+					std::min(group.drawCount - first, m_maxDrawIndirectCount), STRIDE);
+			}
+		}
+	}
+
+	void GpuCuller::createDescriptorSets(DescriptorAllocator& descriptors, const JointPalette& palette)
+	{
+		// draws, commands, counts, the joint palette holding the instance transforms and the visibility
+		std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding			= i;
+			bindings[i].descriptorType	= i == 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount	= 1;
+			bindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings	= bindings.data();
+
+		if (vkCreateDescriptorSetLayout(*m_logicalDevice, &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create culling descriptor set layout!");
+		}
+
+		for (uint32_t frame = 0; frame < m_frames.size(); frame++)
+		{
+			m_frames[frame].descriptorSet = descriptors.allocate(m_setLayout);
+
+			std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+			bufferInfos[0] = { *m_drawBuffer, m_drawSectionSize * frame, m_drawSectionSize };
+			bufferInfos[1] = { *m_commandBuffer, m_commandSectionSize * frame, m_commandSectionSize };
+			bufferInfos[2] = { *m_countBuffer, m_countSectionSize * frame, m_countSectionSize };
+			bufferInfos[3] = { palette, 0, palette.getFrameSize() };
+			bufferInfos[4] = { *m_visibilityBuffer, 0, VK_WHOLE_SIZE };
+
+			std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+			for (uint32_t i = 0; i < descriptorWrites.size(); i++)
+			{
+				descriptorWrites[i].sType			= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrites[i].dstSet			= m_frames[frame].descriptorSet;
+				descriptorWrites[i].dstBinding		= i;
+				descriptorWrites[i].dstArrayElement	= 0;
+				descriptorWrites[i].descriptorType	= bindings[i].descriptorType;
+				descriptorWrites[i].descriptorCount	= 1;
+				descriptorWrites[i].pBufferInfo		= &bufferInfos[i];
+			}
+
+			vkUpdateDescriptorSets(*m_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+	}
+}
@@ -0,0 +1,215 @@
+/**
+ * Culls the render queue's draws on the GPU and draws the survivors indirectly
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "RenderQueue.h"
+#include "HiZPyramid.h"
+#include "Vulkan/PhysicalDevice.h"
+#include "Vulkan/LogicalDevice.h"
+#include "Vulkan/Buffer.h"
+#include "Vulkan/ComputePipeline.h"
+#include "Vulkan/DescriptorAllocator.h"
+#include "Vulkan/JointPalette.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Which draws a culling dispatch emits
+	 */
+	enum class CullPass
+	{
+		Single,		// every draw in the frustum
+		Early,		// draws in the frustum that were visible last frame
+		Late,		// draws in the frustum the depth pyramid doesn't hide and the early pass didn't draw
+	};
+
+	/**
+	 * Culls the render queue's draws on the GPU and draws the survivors indirectly.
+	 * Every instance of the sorted queue becomes a draw in a per frame storage buffer, written
+	 * only when the queue changes. Each frame a compute shader tests the draws' bounding spheres
+	 * against the frustum and compacts the visible ones into indirect commands, one range and
+	 * counter per group of draws sharing a material. The graphics pass then issues a single
+	 * vkCmdDrawIndexedIndirectCount per group, so the CPU cost no longer depends on the number
+	 * of draws. Without draw indirect count, culled draws are written with no instances instead
+	 * and every group is drawn with vkCmdDrawIndexedIndirect.
+	 * Given a HiZPyramid, the frame is culled twice: the early pass draws what was visible last
+	 * frame, the pyramid is built from its depth and the late pass draws what it doesn't hide and
+	 * wasn't drawn yet, recording every draw's visibility for the next frame. Each pass writes its
+	 * own region of commands and counters
+	 */
+	class GpuCuller
+	{
+	public:
+		/**
+		 * @param descriptors allocates the culling descriptor sets, one per frame
+		 * @param palette holds the instance transforms, read by the compute shader
+		 * @param drawCapacity number of draws each frame can cull
+		 * @param frameCount number of frames in flight, each gets its own section
+		 * @param pyramid enables the early and late passes, must outlive the culler
+		 */
+		GpuCuller(
+			const LogicalDevice* logicalDevice,
+			const PhysicalDevice* physicalDevice,
+			DescriptorAllocator& descriptors,
+			const JointPalette& palette,
+			uint32_t drawCapacity,
+			uint32_t frameCount,
+			const HiZPyramid* pyramid = nullptr,
+			const std::string& shaderPath = "shaders/cull_comp.spv");
+		~GpuCuller();
+
+		GpuCuller(const GpuCuller&) = delete;
+		GpuCuller& operator=(const GpuCuller&) = delete;
+
+		/**
+		 * Writes the draws and groups of frame from the sorted, instanced queue.
+		 * The GPU must be done with the frame's previous use
+		 * @param instanceBase joint palette index the queue's instance transforms are written to
+		 */
+		void update(uint32_t frame, const RenderQueue& queue, uint32_t instanceBase);
+
+		/**
+		 * Records the culling of frame's draws, must be outside a render pass.
+		 * The late pass reads the pyramid, build it after drawing the early pass
+		 * @param viewProjection camera projection times view, the frustum planes are taken from it
+		 * @param paletteOffset dynamic offset of the frame's joint palette section
+		 */
+		void dispatch(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& viewProjection, uint32_t paletteOffset,
+			CullPass pass = CullPass::Single) const;
+
+		/**
+		 * Records the indirect draws of a pass of frame, the pipeline, set 0 and the geometry heap must already be bound
+		 */
+		void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame, CullPass pass = CullPass::Single) const;
+
+		/**
+		 * Whether dispatch takes the early and late passes
+		 */
+		bool hasOcclusion() const { return m_pyramid != nullptr; }
+
+		/**
+		 * Number of draws written by the last update of frame
+		 */
+		uint32_t getDrawCount(uint32_t frame) const { return m_frames[frame].drawCount; }
+
+	private:
+
+		/**
+		 * Draws sharing the state bound between indirect draws, their commands are contiguous
+		 */
+		struct Group
+		{
+			VkDescriptorSet	textureSet		{};
+			uint32_t		materialIndex	{ 0 };
+			int32_t			jointOffset		{ -1 };
+			uint32_t		firstCommand	{ 0 };
+			uint32_t		drawCount		{ 0 };
+		};
+
+		/**
+		 * What update wrote for a frame
+		 */
+		struct Frame
+		{
+			VkDescriptorSet		descriptorSet	{};
+			uint32_t			drawCount		{ 0 };
+			std::vector<Group>	groups			{};
+		};
+
+		/**
+		 * Vulkan Logical Device, used for resource destruction
+		 */
+		const LogicalDevice* m_logicalDevice{};
+
+		/**
+		 * Depth pyramid read by the late pass, null without occlusion culling
+		 */
+		const HiZPyramid* m_pyramid{};
+
+		/**
+		 * Number of draws in a frame's section
+		 */
+		uint32_t m_drawCapacity{ 0 };
+
+		/**
+		 * Whether visible draws are compacted and drawn with vkCmdDrawIndexedIndirectCount,
+		 * needs multiDrawIndirect with a limit covering the draw capacity
+		 */
+		bool m_drawIndirectCount{ false };
+
+		/**
+		 * Most commands a single indirect draw may read, 1 without multiDrawIndirect
+		 */
+		uint32_t m_maxDrawIndirectCount{ 1 };
+
+		/**
+		 * Host visible draws to cull, a section per frame
+		 */
+		std::unique_ptr<Buffer> m_drawBuffer{};
+
+		/**
+		 * Indirect commands written by the compute shader, a section per frame split in a region per pass
+		 */
+		std::unique_ptr<Buffer> m_commandBuffer{};
+
+		/**
+		 * Number of visible draws of every group, a section per frame split in a region per pass
+		 */
+		std::unique_ptr<Buffer> m_countBuffer{};
+
+		/**
+		 * Whether every draw was visible at the end of the last frame, shared by the frames in flight
+		 * since it only decides which pass draws what, starts out visible
+		 */
+		std::unique_ptr<Buffer> m_visibilityBuffer{};
+
+		/**
+		 * Sizes of a frame's section of each buffer, padded to the storage buffer offset alignment
+		 */
+		VkDeviceSize m_drawSectionSize{ 0 };
+
+		VkDeviceSize m_commandSectionSize{ 0 };
+
+		VkDeviceSize m_countSectionSize{ 0 };
+
+		/**
+		 * Layout of the culling descriptor set
+		 */
+		VkDescriptorSetLayout m_setLayout{};
+
+		/**
+		 * Culling compute shader
+		 */
+		std::unique_ptr<ComputePipeline> m_pipeline{};
+
+		/**
+		 * State of every frame in flight
+		 */
+		std::vector<Frame> m_frames{};
+
+		/**
+		 * Creates the descriptor set layout and writes a set per frame pointing at its sections
+		 */
+		void createDescriptorSets(DescriptorAllocator& descriptors, const JointPalette& palette);
+
+		/**
+		 * First command and counter of pass in a frame's section
+		 */
+		uint32_t getRegion(CullPass pass) const { return pass == CullPass::Late ? m_drawCapacity : 0; }
+	};
+}
@@ -4,11 +4,14 @@
 #include "Graphics.h"
 
 #include "Vulkan/UniformBufferObject.hpp"
+#include "Vulkan/UploadBatch.h"
 
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <algorithm>
 #include <array>
+#include <cstring>
 
 namespace ash
 {
@@ -16,8 +19,8 @@ namespace ash
 	 * initializer list is not used for debugger creation which must happen 
 	 * after the instance is created but before all other components
 	 */
-	Graphics::Graphics(Window* window) :
-		m_window{ window }
+	Graphics::Graphics(Window* window, const GraphicsSettings& settings) :
+		m_window{ window }, m_settings{ settings }
 	{
 		m_instance = std::make_unique<Instance>();
 		if (m_instance->isValidationEnabled)
@@ -26,27 +29,119 @@ namespace ash
 		}
 		m_surface			= std::make_unique<Surface>(m_instance.get(), m_window);
 		m_physicalDevice	= std::make_unique<PhysicalDevice>(m_instance.get(), m_surface.get());
-		m_logicalDevice		= std::make_unique<LogicalDevice>(m_instance.get(), m_physicalDevice.get());
+
+		// uploads write device local buffers directly when the GPU's memory allows it
+		bool directWrite{ (m_settings.uploadPath == UploadPath::Auto && m_physicalDevice->prefersDirectWrite())
+			|| (m_settings.uploadPath == UploadPath::DirectWrite && m_physicalDevice->supportsDirectWrite()) };
+		m_logicalDevice		= std::make_unique<LogicalDevice>(m_instance.get(), m_physicalDevice.get(), m_settings.stagingRingSize, directWrite);
 		m_swapChain			= std::make_unique<SwapChain>(m_window, m_surface.get(), m_physicalDevice.get(), m_logicalDevice.get());
-		m_descriptorPool	= std::make_unique<DescriptorPool>(m_logicalDevice.get(), m_swapChain->getImageCount());
-		createDescriptorSetLayout();
+		m_staticDescriptors	= std::make_unique<DescriptorAllocator>(m_logicalDevice.get(), m_settings.descriptorSetsPerPool);
+		m_geometryHeap		= std::make_unique<GeometryHeap>(m_logicalDevice.get(), m_physicalDevice.get(),
+			m_settings.geometryVertexCapacity, m_settings.geometryIndexCapacity);
+		m_frameAllocator	= std::make_unique<FrameAllocator>(m_logicalDevice.get(), m_physicalDevice.get(),
+			m_settings.frameDataSize, static_cast<uint32_t>(m_maxFramesInFlight));
+		m_jointPalette		= std::make_unique<JointPalette>(m_logicalDevice.get(), m_physicalDevice.get(),
+			m_settings.jointPaletteCapacity, static_cast<uint32_t>(m_maxFramesInFlight));
 		createTextureSampler();
 
-		m_renderPass		= std::make_unique<RenderPass>(m_logicalDevice.get(), m_swapChain.get(), m_physicalDevice.get());
-		m_graphicsPipeline	= std::make_unique<GraphicsPipeline>(m_logicalDevice.get(), m_swapChain.get(), m_renderPass.get(), m_layouts);
+		if (m_settings.bindless && !m_physicalDevice->supportsBindless())
+		{
+			std::cout << "Descriptor indexing not supported, using per texture descriptor sets" << '\n';
+			m_settings.bindless = false;
+		}
+		if (m_settings.bindless)
+		{
+			m_bindlessSet = std::make_unique<BindlessSet>(m_logicalDevice.get(), m_physicalDevice.get(), m_textureSampler);
+		}
+		if (m_settings.gpuCulling && !m_physicalDevice->supportsGpuCulling())
+		{
+			std::cout << "Indirect draws with a first instance not supported, culling on the CPU" << '\n';
+			m_settings.gpuCulling = false;
+		}
+		if (m_settings.occlusionCulling && (!m_settings.gpuCulling ||
+			!HiZPyramid::supportsDepthFormat(m_physicalDevice.get(), m_physicalDevice->findDepthFormat())))
+		{
+			std::cout << "Occlusion culling needs GPU culling and a sampled depth format, culling the frustum only" << '\n';
+			m_settings.occlusionCulling = false;
+		}
+		if (m_settings.softwareOcclusion && (!m_settings.frustumCulling || m_settings.gpuCulling))
+		{
+			std::cout << "Software occlusion needs frustum culling on the CPU, disabled" << '\n';
+			m_settings.softwareOcclusion = false;
+		}
+		if (m_settings.softwareOcclusion)
+		{
+			m_occlusionBuffer = std::make_unique<OcclusionBuffer>(m_settings.occlusionBufferWidth, m_settings.occlusionBufferHeight);
+		}
+		if (m_settings.occlusionCulling)
+		{
+			m_hiZPyramid = std::make_unique<HiZPyramid>(m_logicalDevice.get(), m_physicalDevice.get());
+		}
+		if (m_settings.gpuCulling)
+		{
+			// the culled draws select their transform with the first instance
+			m_settings.instancing	= true;
+			m_gpuCuller				= std::make_unique<GpuCuller>(m_logicalDevice.get(), m_physicalDevice.get(), *m_staticDescriptors,
+				*m_jointPalette, m_settings.gpuCullingCapacity, static_cast<uint32_t>(m_maxFramesInFlight), m_hiZPyramid.get(),
+				m_hiZPyramid ? "shaders/cull_occlusion_comp.spv" : "shaders/cull_comp.spv");
+		}
+		// must be called after the bindless set is created
+		createDescriptorSetLayout();
+		createFrameDescriptorSet();
+		if (!m_bindlessSet)
+		{
+			createDefaultTexture();
+		}
+
+		if (m_settings.dynamicRendering && !m_physicalDevice->supportsDynamicRendering())
+		{
+			std::cout << "Dynamic rendering not supported, using render pass objects" << '\n';
+			m_settings.dynamicRendering = false;
+		}
+
+		m_renderPass		= std::make_unique<RenderPass>(m_logicalDevice.get(), m_swapChain.get(), m_physicalDevice.get(),
+			m_settings.dynamicRendering);
+		m_graphicsPipeline	= std::make_unique<GraphicsPipeline>(m_logicalDevice.get(), m_renderPass.get(), m_layouts,
+			getVertexShader(false),
+			m_settings.bindless ? "shaders/bindless_frag.spv" : "shaders/frag.spv");
+
+		if (m_settings.depthPrepass)
+		{
+			m_settings.depthPrepass = false;
+			setDepthPrepass(true);
+		}
 
 		createDepthResources();
 		// must be called after render pass creation
-		m_swapChain->createFramebuffers(*m_renderPass, *m_depthImage);
+		if (!m_renderPass->isDynamic())
+		{
+			m_swapChain->createFramebuffers(*m_renderPass, *m_depthImage);
+		}
 
 
 		createCommandBuffers();
 		createSyncObjects();
-		createUniformBuffers();
+
+		// a single recording thread without reuse records inline, without secondary command buffers,
+		// GPU culling records a few indirect draws inline
+		m_workerPool = std::make_unique<WorkerPool>(m_settings.recordThreads);
+		if (!m_gpuCuller && (m_workerPool->getThreadCount() > 1 || m_settings.reuseCommandBuffers))
+		{
+			m_secondaryCommandBuffers = std::make_unique<SecondaryCommandBuffers>(m_logicalDevice.get(),
+				static_cast<uint32_t>(m_maxFramesInFlight), m_workerPool->getThreadCount());
+		}
+		m_recordedDraws.resize(m_maxFramesInFlight);
+
+		// textures of models outside the scene are the first to give up memory
+		m_logicalDevice->getAllocator().addEvictionHandler([this](uint32_t heapIndex, VkDeviceSize bytesNeeded)
+			{
+				return downgradeIdleTextures(heapIndex, bytesNeeded);
+			});
 	}
 
 	Graphics::~Graphics()
 	{
+		m_deletionQueue.flush();
 		cleanupSyncObjects();
 		cleanupCommandBuffers();
 		cleanupDescriptorSetLayout();
@@ -56,6 +151,7 @@ namespace ash
 	void Graphics::renderGameObjects(std::vector<std::unique_ptr<GameObject>>& gameObjects,Camera* camera)
 	{
 		vkWaitForFences(*m_logicalDevice, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+		m_deletionQueue.collect(getCompletedFrames());
 
 		uint32_t imageIndex;
 		
@@ -63,7 +159,7 @@ namespace ash
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
-			recreateSwapChain(gameObjects);
+			recreateSwapChain();
 			return;
 		}
 		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
@@ -78,6 +174,40 @@ namespace ash
 
 		m_imagesInFlight[imageIndex] = m_inFlightFences[m_currentFrame];
 
+		// texture sets of destroyed models are reused once the frames that may draw with them are done
+		if (m_staticDescriptors->hasReleasedSets())
+		{
+			DescriptorAllocator* allocator{ m_staticDescriptors.get() };
+			m_deletionQueue.retire(m_submittedFrames, [allocator, sets = allocator->takeReleasedSets()]()
+				{
+					allocator->recycle(sets);
+				});
+		}
+
+		// the in flight fence guarantees the GPU is done with this frame's section
+		m_frameAllocator->beginFrame(static_cast<uint32_t>(m_currentFrame));
+		m_jointPalette->beginFrame(static_cast<uint32_t>(m_currentFrame));
+
+		// a shared model is posed once, however many game objects use it
+		m_frameModels.clear();
+		for (auto& gameObject : gameObjects)
+		{
+			m_frameModels.push_back(gameObject->getModel());
+		}
+		std::sort(m_frameModels.begin(), m_frameModels.end());
+		m_frameModels.erase(std::unique(m_frameModels.begin(), m_frameModels.end()), m_frameModels.end());
+		for (Model* model : m_frameModels)
+		{
+			model->updateJoints(*m_jointPalette);
+			model->setLastUsedFrame(m_submittedFrames + 1);
+		}
+
+		// instance transforms follow the joints, recorded draws stay valid while the joint count does
+		const uint32_t instanceBase{ m_jointPalette->getCount() };
+
+		// dynamic offsets in binding order, the uniform buffer object then the joint palette
+		std::array<uint32_t, 2> dynamicOffsets{ updateUniformBuffer(camera), m_jointPalette->getDynamicOffset() };
+
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -86,22 +216,120 @@ namespace ash
 			throw std::runtime_error("failed to begin recording command buffer!");
 		}
 
-		startRenderPass(m_swapChain->getFramebuffers()[imageIndex], m_commandBuffers[imageIndex]);
-		vkCmdBindDescriptorSets(m_commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline->getLayout(), 0, 1, &m_descriptorSets[imageIndex], 0, nullptr);
-		for (size_t i = 0; i < gameObjects.size(); i++)
+		updateSceneRevision(gameObjects);
+
+		const RenderTarget	target		{ getRenderTarget(imageIndex) };
+		RenderPassPart		lastPart	{ RenderPassPart::Whole };
+		bool				parallel	{ m_workerPool->getThreadCount() > 1 && gameObjects.size() >= m_settings.parallelRecordThreshold };
+
+		if (m_gpuCuller)
+		{
+			RecordedDraws& recorded{ m_recordedDraws[m_currentFrame] };
+
+			// the draws to cull only change with the scene, the culling itself runs every frame
+			if (recorded.sceneRevision != m_sceneRevision || recorded.instanceBase != instanceBase)
+			{
+				buildRenderQueue(gameObjects, camera);
+				writeInstances();
+				m_gpuCuller->update(static_cast<uint32_t>(m_currentFrame), m_renderQueue, instanceBase);
+				recorded = RecordedDraws{ m_sceneRevision, 0, dynamicOffsets, instanceBase };
+			}
+			else
+			{
+				// only the joints were written to the section since the update, the transforms are still there
+				m_jointPalette->allocate(static_cast<uint32_t>(m_renderQueue.getInstances().size()));
+			}
+
+			const glm::mat4 viewProjection{ camera->getProjection() * camera->getView() };
+			const uint32_t	frame			{ static_cast<uint32_t>(m_currentFrame) };
+
+			if (m_hiZPyramid)
+			{
+				// last frame's visible draws fill the depth the pyramid is built from, then the rest is tested against it
+				m_gpuCuller->dispatch(m_commandBuffers[imageIndex], frame, viewProjection, m_jointPalette->getDynamicOffset(), CullPass::Early);
+				startRenderPass(target, m_commandBuffers[imageIndex], VK_SUBPASS_CONTENTS_INLINE, RenderPassPart::Begin);
+				bindFrameState(m_commandBuffers[imageIndex], dynamicOffsets);
+				m_gpuCuller->draw(m_commandBuffers[imageIndex], m_graphicsPipeline->getLayout(), frame, CullPass::Early);
+				endRenderPass(target, m_commandBuffers[imageIndex], RenderPassPart::Begin);
+
+				m_hiZPyramid->build(m_commandBuffers[imageIndex]);
+
+				m_gpuCuller->dispatch(m_commandBuffers[imageIndex], frame, viewProjection, m_jointPalette->getDynamicOffset(), CullPass::Late);
+				startRenderPass(target, m_commandBuffers[imageIndex], VK_SUBPASS_CONTENTS_INLINE, RenderPassPart::End);
+				lastPart = RenderPassPart::End;
+				bindFrameState(m_commandBuffers[imageIndex], dynamicOffsets);
+				m_gpuCuller->draw(m_commandBuffers[imageIndex], m_graphicsPipeline->getLayout(), frame, CullPass::Late);
+			}
+			else
+			{
+				m_gpuCuller->dispatch(m_commandBuffers[imageIndex], frame, viewProjection, m_jointPalette->getDynamicOffset());
+				startRenderPass(target, m_commandBuffers[imageIndex], VK_SUBPASS_CONTENTS_INLINE);
+				bindFrameState(m_commandBuffers[imageIndex], dynamicOffsets);
+				m_gpuCuller->draw(m_commandBuffers[imageIndex], m_graphicsPipeline->getLayout(), frame);
+			}
+		}
+		else if (m_secondaryCommandBuffers && (parallel || m_settings.reuseCommandBuffers) && !m_settings.depthPrepass)
+		{
+			RecordedDraws&	recorded	{ m_recordedDraws[m_currentFrame] };
+			uint32_t		bufferCount	{ parallel ? m_secondaryCommandBuffers->getBufferCount() : 1u };
+
+			// the frame's secondaries bake in the transforms and the dynamic offsets they were recorded with,
+			// the in flight fence guarantees the GPU is done with them
+			// the depth order is kept while only the camera moves, it affects speed but not the image,
+			// the culled draws are not
+			const FrustumPlanes planes{ camera->getFrustumPlanes() };
+			if (!m_settings.reuseCommandBuffers || recorded.sceneRevision != m_sceneRevision || recorded.dynamicOffsets != dynamicOffsets
+				|| recorded.instanceBase != instanceBase || (m_settings.frustumCulling && recorded.planes != planes))
+			{
+				buildRenderQueue(gameObjects, camera);
+				m_secondaryCommandBuffers->reset(static_cast<uint32_t>(m_currentFrame));
+				recordDraws(bufferCount, dynamicOffsets, instanceBase, m_settings.reuseCommandBuffers ? VK_NULL_HANDLE : target.framebuffer);
+				recorded = RecordedDraws{ m_sceneRevision, bufferCount, dynamicOffsets, instanceBase, planes };
+			}
+
+			// the queue still holds the transforms the draws were recorded with, this frame's section needs them
+			writeInstances();
+
+			startRenderPass(target, m_commandBuffers[imageIndex], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			vkCmdExecuteCommands(m_commandBuffers[imageIndex], recorded.bufferCount,
+				m_secondaryCommandBuffers->getCommandBuffers(static_cast<uint32_t>(m_currentFrame)));
+		}
+		else if (m_settings.depthPrepass)
+		{
+			buildRenderQueue(gameObjects, camera);
+			writeInstances();
+
+			// depth front to back, so later draws fail the test early, then the nearest fragments are shaded
+			m_renderQueue.sortFrontToBack();
+			startRenderPass(target, m_commandBuffers[imageIndex], VK_SUBPASS_CONTENTS_INLINE, RenderPassPart::Begin);
+			bindFrameState(m_commandBuffers[imageIndex], dynamicOffsets, m_depthPipeline.get());
+			m_renderQueue.recordDepth(m_commandBuffers[imageIndex], m_depthPipeline->getLayout(), 0, m_renderQueue.size(), instanceBase);
+			endRenderPass(target, m_commandBuffers[imageIndex], RenderPassPart::Begin);
+
+			startRenderPass(target, m_commandBuffers[imageIndex], VK_SUBPASS_CONTENTS_INLINE, RenderPassPart::End);
+			lastPart = RenderPassPart::End;
+			bindFrameState(m_commandBuffers[imageIndex], dynamicOffsets, m_equalPipeline.get());
+			m_renderQueue.record(m_commandBuffers[imageIndex], m_equalPipeline->getLayout(), 0, m_renderQueue.size(), instanceBase);
+		}
+		else
 		{
-			gameObjects[i]->draw(m_commandBuffers[imageIndex], m_graphicsPipeline->getLayout(), imageIndex);
+			buildRenderQueue(gameObjects, camera);
+			writeInstances();
+			startRenderPass(target, m_commandBuffers[imageIndex], VK_SUBPASS_CONTENTS_INLINE);
+			bindFrameState(m_commandBuffers[imageIndex], dynamicOffsets);
+			m_renderQueue.record(m_commandBuffers[imageIndex], m_graphicsPipeline->getLayout(), 0, m_renderQueue.size(), instanceBase);
 		}
-		endRenderPass(m_commandBuffers[imageIndex]);
+		endRenderPass(target, m_commandBuffers[imageIndex], lastPart);
 
-		//
+		if (vkEndCommandBuffer(m_commandBuffers[imageIndex]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record command buffer!");
+		}
 	
 		VkSemaphore waitSemaphores[]		= { m_imageAvailableSemaphores[m_currentFrame] };
 		VkPipelineStageFlags waitStages[]	= { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		VkSemaphore signalSemaphores[]		= { m_renderFinishedSemaphores[m_currentFrame] };
 
-		updateUniformBuffer(imageIndex, m_swapChain->getSwapExtent(), camera);
-
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		submitInfo.waitSemaphoreCount	= 1;
@@ -118,6 +346,7 @@ namespace ash
 		{
 			throw std::runtime_error("failed to submit draw command to buffer!");
 		}
+		m_submittedFrames++;
 
 		VkSwapchainKHR swapChains[] = { *m_swapChain };
 		
@@ -135,7 +364,7 @@ namespace ash
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_window->getWasWindowResized())
 		{
 			m_window->resetWasWindowResized();
-			recreateSwapChain(gameObjects);
+			recreateSwapChain();
 		}
 		else if (result != VK_SUCCESS)
 		{
@@ -150,25 +379,92 @@ namespace ash
 		vkDeviceWaitIdle(*m_logicalDevice);
 	}
 
-	std::unique_ptr<Model> Graphics::generateModel(std::string modelPath)
+	std::shared_ptr<Model> Graphics::generateModel(std::string modelPath)
 	{
-		std::unique_ptr<Model> model = std::make_unique<Model>
+		// a shared model has a single pose and animation, game objects only share it when drawn instanced
+		if (m_settings.instancing)
+		{
+			if (std::shared_ptr<Model> shared = m_models[modelPath].lock())
+			{
+				return shared;
+			}
+		}
+
+		// the model's geometry, bindless slots and images may be read by frames still in flight when the
+		// last game object drops it, so it is destroyed once they are complete
+		std::shared_ptr<Model> model
 			(
-			m_logicalDevice.get(), 
-			m_physicalDevice.get(),
-			m_swapChain->getImageCount(), 
-			m_descriptorSetLayout, 
-			m_descriptorPool->getPool(), 
-			m_textureSampler,
-			m_uniformBuffers,
-			modelPath
+			new Model
+				(
+				m_logicalDevice.get(), 
+				m_physicalDevice.get(),
+				m_geometryHeap.get(),
+				m_swapChain->getImageCount(), 
+				m_descriptorSetLayout, 
+				m_textureSampler,
+				modelPath
+				),
+			[this](Model* released)
+				{
+					m_deletionQueue.retire(m_submittedFrames, [released]()
+						{
+							delete released;
+						});
+				}
 			);
-		return std::move(model);
+		if (m_settings.instancing)
+		{
+			m_models[modelPath] = model;
+		}
+		m_loadedModels.push_back(model);
+		return model;
+	}
+
+	VkDeviceSize Graphics::downgradeIdleTextures(uint32_t heapIndex, VkDeviceSize bytesNeeded)
+	{
+		// models no frame in flight or being recorded uses, least recently used first
+		const uint64_t framesInFlight{ static_cast<uint64_t>(m_maxFramesInFlight) };
+		std::vector<std::shared_ptr<Model>> idleModels{};
+		m_loadedModels.erase(std::remove_if(m_loadedModels.begin(), m_loadedModels.end(),
+			[](const std::weak_ptr<Model>& model) { return model.expired(); }), m_loadedModels.end());
+		for (auto& loaded : m_loadedModels)
+		{
+			std::shared_ptr<Model> model{ loaded.lock() };
+			if (model && model->getLastUsedFrame() + framesInFlight <= m_submittedFrames)
+			{
+				idleModels.push_back(std::move(model));
+			}
+		}
+		std::sort(idleModels.begin(), idleModels.end(), [](const std::shared_ptr<Model>& a, const std::shared_ptr<Model>& b)
+			{
+				return a->getLastUsedFrame() < b->getLastUsedFrame();
+			});
+
+		VkDeviceSize released{ 0 };
+		for (auto& model : idleModels)
+		{
+			if (released >= bytesNeeded)
+			{
+				break;
+			}
+			released += model->downgradeTextures(heapIndex, bytesNeeded - released);
+		}
+		return released;
+	}
+
+	void Graphics::printMemoryStats() const
+	{
+		m_logicalDevice->getAllocator().printStats();
+	}
+
+	MemoryStats Graphics::getMemoryStats() const
+	{
+		return m_logicalDevice->getAllocator().getStats();
 	}
 
 	void Graphics::createCommandBuffers()
 	{
-		m_commandBuffers.resize(m_swapChain->getFramebuffers().size());
+		m_commandBuffers.resize(m_swapChain->getImageCount());
 
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -208,38 +504,227 @@ namespace ash
 
 	}
 
-	void Graphics::startRenderPass(VkFramebuffer framebuffer, VkCommandBuffer commandBuffer)
+	void Graphics::startRenderPass(const RenderTarget& target, VkCommandBuffer commandBuffer, VkSubpassContents contents,
+		RenderPassPart part)
 	{
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-		clearValues[1].color = { 1.0f, 0 };
-		
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass			= *m_renderPass;
-		renderPassInfo.framebuffer			= framebuffer;
-		renderPassInfo.renderArea.offset	= { 0,0 };
-		renderPassInfo.renderArea.extent	= m_swapChain->getSwapExtent();
-		renderPassInfo.clearValueCount		= static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues			= clearValues.data();
-
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *m_graphicsPipeline);
-		
+		m_renderPass->begin(commandBuffer, target, contents, part);
 	}
 
-	void Graphics::endRenderPass(VkCommandBuffer commandBuffer)
+	void Graphics::endRenderPass(const RenderTarget& target, VkCommandBuffer commandBuffer, RenderPassPart part)
 	{
-		vkCmdEndRenderPass(commandBuffer);
+		m_renderPass->end(commandBuffer, target, part);
+	}
 
-		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	RenderTarget Graphics::getRenderTarget(uint32_t imageIndex) const
+	{
+		RenderTarget target{};
+		target.colorImage	= m_swapChain->getImages()[imageIndex];
+		target.colorView	= m_swapChain->getImageViews()[imageIndex];
+		target.depthImage	= m_depthImage->getImage();
+		target.depthView	= *m_depthImage;
+		target.extent		= m_swapChain->getSwapExtent();
+
+		// only render pass objects draw through framebuffers
+		if (!m_renderPass->isDynamic())
 		{
-			throw std::runtime_error("failed to record command buffer!");
+			target.framebuffer = m_swapChain->getFramebuffers()[imageIndex];
+		}
+		return target;
+	}
+
+	void Graphics::bindFrameState(VkCommandBuffer commandBuffer, const std::array<uint32_t, 2>& dynamicOffsets,
+		const GraphicsPipeline* pipeline)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline ? *pipeline : *m_graphicsPipeline);
+
+		// dynamic state of every graphics pipeline, it follows the swap chain without recreating them
+		const VkExtent2D& extent{ m_swapChain->getSwapExtent() };
+
+		VkViewport viewport{};
+		viewport.width		= static_cast<float>(extent.width);
+		viewport.height		= static_cast<float>(extent.height);
+		viewport.maxDepth	= 1.0f;
+
+		const VkRect2D scissor{ { 0, 0 }, extent };
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline->getLayout(), 0, 1, &m_frameDescriptorSet,
+			static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+		if (m_bindlessSet)
+		{
+			// every texture and material, models only push their material index
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline->getLayout(), 1, 1, &m_bindlessSet->getSet(), 0, nullptr);
+		}
+		m_geometryHeap->bind(commandBuffer);
+	}
+
+	void Graphics::buildRenderQueue(std::vector<std::unique_ptr<GameObject>>& gameObjects, Camera* camera)
+	{
+		m_renderQueue.begin(camera->getView(), m_settings.instancing);
+
+		// the GPU culler keeps every draw and culls them itself each frame
+		if (!m_settings.frustumCulling || m_gpuCuller)
+		{
+			for (auto& gameObject : gameObjects)
+			{
+				gameObject->enqueue(m_renderQueue);
+			}
+			m_renderQueue.sort();
+			return;
+		}
+
+		// the scene index finds the visible game objects, so hidden ones never walk their nodes,
+		// then the draws of the rest are tested one by one
+		const FrustumPlanes planes{ camera->getFrustumPlanes() };
+		m_visibleObjects.clear();
+		m_sceneIndex.queryFrustum(planes, m_visibleObjects);
+		if (m_occlusionBuffer)
+		{
+			cullOccludedObjects(camera);
+		}
+
+		for (GameObject* gameObject : m_visibleObjects)
+		{
+			gameObject->enqueue(m_renderQueue);
+		}
+		m_renderQueue.cull(planes);
+		m_renderQueue.sort();
+	}
+
+	void Graphics::setDepthPrepass(bool enabled)
+	{
+		if (enabled && m_gpuCuller)
+		{
+			std::cout << "Depth prepass not used by GPU culling" << '\n';
+			return;
+		}
+		if (enabled && !m_depthPipeline)
+		{
+			// both variants bind the same sets as the main pipeline
+			m_depthPipeline = std::make_unique<GraphicsPipeline>(m_logicalDevice.get(), m_renderPass.get(), m_layouts,
+				getVertexShader(true), "", DepthMode::DepthOnly);
+			m_equalPipeline = std::make_unique<GraphicsPipeline>(m_logicalDevice.get(), m_renderPass.get(), m_layouts,
+				getVertexShader(false), m_settings.bindless ? "shaders/bindless_frag.spv" : "shaders/frag.spv", DepthMode::Equal);
+		}
+
+		m_settings.depthPrepass = enabled;
+		invalidateRecordedDraws();
+	}
+
+	std::string Graphics::getVertexShader(bool depthOnly) const
+	{
+		// instanced variants read the transform by gl_InstanceIndex instead of the push constant
+		std::string name{ m_settings.skinning ? "skinned_" : "" };
+		name += depthOnly ? "depth_" : "";
+		name += m_settings.instancing ? "instanced_" : "";
+		return "shaders/" + name + "vert.spv";
+	}
+
+	void Graphics::cullOccludedObjects(Camera* camera)
+	{
+		// the objects covering the most of the screen hide the most, ties go to the oldest for a stable pick
+		m_occluders.clear();
+		for (GameObject* gameObject : m_visibleObjects)
+		{
+			Model* model{ gameObject->getModel() };
+			if (model->getOccluder().empty())
+			{
+				continue;
+			}
+
+			const glm::vec4	sphere		{ transformSphere(gameObject->getTransform().mat4(), model->getBounds()) };
+			const float		distance	{ glm::length(glm::vec3(camera->getView() * glm::vec4(glm::vec3(sphere), 1.0f))) };
+			m_occluders.emplace_back(sphere.w / std::max(distance, sphere.w), gameObject);
+		}
+
+		const size_t occluderCount{ std::min(m_occluders.size(), static_cast<size_t>(m_settings.maxOccluders)) };
+		std::partial_sort(m_occluders.begin(), m_occluders.begin() + occluderCount, m_occluders.end(),
+			[](const std::pair<float, GameObject*>& a, const std::pair<float, GameObject*>& b)
+			{
+				return a.first != b.first ? a.first > b.first : a.second->getId() < b.second->getId();
+			});
+
+		m_occlusionBuffer->begin(camera->getProjection() * camera->getView());
+		for (size_t i = 0; i < occluderCount; i++)
+		{
+			GameObject* gameObject{ m_occluders[i].second };
+			m_occlusionBuffer->addOccluder(gameObject->getModel()->getOccluder(), gameObject->getTransform().mat4());
+		}
+		m_occlusionBuffer->rasterize(m_workerPool.get());
+
+		// an occluder's own box is never behind its surface, so occluders stay visible
+		m_visibleObjects.erase(std::remove_if(m_visibleObjects.begin(), m_visibleObjects.end(), [this](GameObject* gameObject)
+			{
+				const glm::vec4 sphere{ transformSphere(gameObject->getTransform().mat4(), gameObject->getModel()->getBounds()) };
+				return sphere.w >= 0.0f && m_occlusionBuffer->isOccluded(sphere);
+			}), m_visibleObjects.end());
+	}
+
+	void Graphics::recordDraws(uint32_t bufferCount, const std::array<uint32_t, 2>& dynamicOffsets, uint32_t instanceBase, VkFramebuffer framebuffer)
+	{
+		const uint32_t	frame		{ static_cast<uint32_t>(m_currentFrame) };
+		const uint32_t	drawCount	{ m_renderQueue.size() };
+		const uint32_t	chunkSize	{ (drawCount + bufferCount - 1) / bufferCount };
+
+		// contiguous chunks keep the draw order the same as inline recording
+		m_workerPool->run(bufferCount, [&](uint32_t index)
+			{
+				VkCommandBuffer commandBuffer{ m_secondaryCommandBuffers->begin(frame, index, *m_renderPass, framebuffer) };
+
+				// state is not inherited from the primary, every secondary binds its own
+				bindFrameState(commandBuffer, dynamicOffsets);
+
+				uint32_t first{ std::min(drawCount, index * chunkSize) };
+				uint32_t last{ std::min(drawCount, first + chunkSize) };
+				m_renderQueue.record(commandBuffer, m_graphicsPipeline->getLayout(), first, last, instanceBase);
+
+				if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to record secondary command buffer!");
+				}
+			});
+	}
+
+	void Graphics::writeInstances()
+	{
+		const std::vector<glm::mat4>& instances{ m_renderQueue.getInstances() };
+		if (instances.empty())
+		{
+			return;
+		}
+
+		uint32_t first{ m_jointPalette->allocate(static_cast<uint32_t>(instances.size())) };
+		memcpy(m_jointPalette->getJoints(first), instances.data(), instances.size() * sizeof(glm::mat4));
+	}
+
+	void Graphics::updateSceneRevision(const std::vector<std::unique_ptr<GameObject>>& gameObjects)
+	{
+		// membership is compared by id, moves are reported by the transforms of the indexed objects
+		bool changed{ gameObjects.size() != m_sceneIds.size() };
+		m_sceneIds.resize(gameObjects.size());
+
+		for (size_t i = 0; i < gameObjects.size(); i++)
+		{
+			if (m_sceneIds[i] != gameObjects[i]->getId())
+			{
+				m_sceneIds[i] = gameObjects[i]->getId();
+				changed = true;
+			}
+		}
+
+		if (changed)
+		{
+			m_sceneIndex.update(gameObjects);
+			m_sceneRevision++;
+		}
+		else if (m_sceneIndex.refit())
+		{
+			m_sceneRevision++;
 		}
 	}
 
-	void Graphics::recreateSwapChain(std::vector<std::unique_ptr<GameObject>>& gameObjects)
+	void Graphics::recreateSwapChain()
 	{
 		int width{ 0 };
 		int height{ 0 };
@@ -250,25 +735,98 @@ namespace ash
 			glfwWaitEvents();
 		}
 
-		waitForDeviceIdle();
-		
-		cleanupSwapChain(gameObjects);
+		// the pyramid's descriptor sets are rewritten for the new depth image and the frames in
+		// flight may still read them, so only the pyramid waits for those frames
+		if (m_hiZPyramid)
+		{
+			waitForFramesInFlight();
+		}
 
-		m_swapChain			->createSwapChain(m_window, m_surface.get(), m_physicalDevice.get());
+		const VkFormat				imageFormat	{ m_swapChain->getImageFormat() };
+		SwapChain::RetiredObjects	retired		{ m_swapChain->retire() };
+
+		// presentation of the old swap chain's images can go on while the new one is created
+		m_swapChain			->createSwapChain(m_window, m_surface.get(), m_physicalDevice.get(), retired.swapChain);
 		m_swapChain			->createImageViews();
-		m_renderPass		->createRenderPass(m_swapChain.get(), m_physicalDevice.get());
-		m_graphicsPipeline	->createPipeline(m_swapChain.get(), m_renderPass.get(), m_layouts);
+		retireSwapChain(std::move(retired));
+
+		// the render pass and the pipelines only depend on the formats, the viewport is dynamic
+		if (m_swapChain->getImageFormat() != imageFormat)
+		{
+			waitForFramesInFlight();
+			recreateRenderPass();
+		}
+
 		createDepthResources();
-		m_swapChain			->createFramebuffers(*m_renderPass, *m_depthImage);
+		if (!m_renderPass->isDynamic())
+		{
+			m_swapChain		->createFramebuffers(*m_renderPass, *m_depthImage);
+		}
 
-		m_descriptorPool->createDescriptorPool(m_swapChain->getImageCount());
 		createCommandBuffers();
 
-		createUniformBuffers();
+		// the new images were never rendered to
+		m_imagesInFlight.assign(m_swapChain->getImageCount(), VK_NULL_HANDLE);
 
-		
-		createDescriptorSets(gameObjects);
-		
+		// the framebuffers and the extent the draws were recorded with are gone
+		invalidateRecordedDraws();
+	}
+
+	void Graphics::retireSwapChain(SwapChain::RetiredObjects&& retired)
+	{
+		if (m_hiZPyramid)
+		{
+			m_hiZPyramid->cleanupPyramid();
+		}
+
+		const LogicalDevice*			logicalDevice	{ m_logicalDevice.get() };
+		const SwapChain*				swapChain		{ m_swapChain.get() };
+		std::shared_ptr<Image>			depthImage		{ std::move(m_depthImage) };
+		std::vector<VkCommandBuffer>	commandBuffers	{ std::move(m_commandBuffers) };
+		m_commandBuffers.clear();
+
+		// every frame submitted so far may use them
+		m_deletionQueue.retire(m_submittedFrames,
+			[logicalDevice, swapChain, retired = std::move(retired), depthImage, commandBuffers]() mutable
+			{
+				vkFreeCommandBuffers(*logicalDevice, logicalDevice->getCommandPool(),
+					static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+				depthImage = nullptr;
+				swapChain->destroyRetired(retired);
+			});
+	}
+
+	void Graphics::waitForFramesInFlight()
+	{
+		vkWaitForFences(*m_logicalDevice, static_cast<uint32_t>(m_inFlightFences.size()), m_inFlightFences.data(), VK_TRUE, UINT64_MAX);
+		m_deletionQueue.collect(m_submittedFrames);
+	}
+
+	uint64_t Graphics::getCompletedFrames() const
+	{
+		// the current frame's fence belongs to the frame submitted m_maxFramesInFlight frames ago,
+		// the fences of the frames before it were waited on earlier
+		const uint64_t framesInFlight{ static_cast<uint64_t>(m_maxFramesInFlight) };
+		return m_submittedFrames >= framesInFlight ? m_submittedFrames - framesInFlight + 1 : 0;
+	}
+
+	void Graphics::recreateRenderPass()
+	{
+		m_graphicsPipeline	->cleanupPipeline();
+		if (m_depthPipeline)
+		{
+			m_depthPipeline	->cleanupPipeline();
+			m_equalPipeline	->cleanupPipeline();
+		}
+		m_renderPass		->cleanupRenderPass();
+
+		m_renderPass		->createRenderPass(m_swapChain.get(), m_physicalDevice.get());
+		m_graphicsPipeline	->createPipeline(m_renderPass.get(), m_layouts);
+		if (m_depthPipeline)
+		{
+			m_depthPipeline	->createPipeline(m_renderPass.get(), m_layouts);
+			m_equalPipeline	->createPipeline(m_renderPass.get(), m_layouts);
+		}
 	}
 
 	void Graphics::cleanupCommandBuffers()
@@ -331,57 +889,30 @@ namespace ash
 			extent.height,
 			depthFormat,
 			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (m_hiZPyramid ? VK_IMAGE_USAGE_SAMPLED_BIT : 0),
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			VK_IMAGE_ASPECT_DEPTH_BIT);
-	}
+			VK_IMAGE_ASPECT_DEPTH_BIT,
+			MemoryCategory::RenderTarget);
 
-	void Graphics::cleanupDepthResource()
-	{
-		m_depthImage = nullptr;
-	}
-
-	bool Graphics::hasStencilComponent(VkFormat format)
-	{
-		return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
-	}
-
-	void Graphics::createUniformBuffers()
-	{
-		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-		m_uniformBuffers.resize(m_swapChain->getImageCount());
-
-		for (size_t i = 0; i < m_swapChain->getImageCount(); i++)
+		if (m_hiZPyramid)
 		{
-			m_uniformBuffers[i] = std::make_unique<Buffer>(m_logicalDevice.get(),
-				m_physicalDevice.get(),
-				bufferSize,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			m_hiZPyramid->createPyramid(*m_depthImage, depthFormat, extent);
 		}
 	}
 
-	void Graphics::cleanupUniformBuffers()
+	bool Graphics::hasStencilComponent(VkFormat format)
 	{
-		size_t bufferCount{ m_uniformBuffers.size() };
-		for (size_t i = 0; i < bufferCount; i++)
-		{
-			m_uniformBuffers[i] = nullptr;
-		}
+		return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 	}
 
-	void Graphics::updateUniformBuffer(uint32_t currentImage, VkExtent2D extent, Camera* camera)
+	uint32_t Graphics::updateUniformBuffer(Camera* camera)
 	{
 		UniformBufferObject ubo{};
 
 		ubo.proj = camera->getProjection();
 		ubo.view = camera->getView();
 
-		void* data;
-		vkMapMemory(*m_logicalDevice, m_uniformBuffers[currentImage]->getBufferMemory(), 0, sizeof(ubo), 0, &data);
-		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(*m_logicalDevice, m_uniformBuffers[currentImage]->getBufferMemory());
+		return m_frameAllocator->write(ubo);
 	}
 
 	void Graphics::createDescriptorSetLayout()
@@ -389,15 +920,25 @@ namespace ash
 		// uniform buffer
 		VkDescriptorSetLayoutBinding uboLayoutBinding{};
 		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		uboLayoutBinding.descriptorCount = 1;
 		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 		uboLayoutBinding.pImmutableSamplers = nullptr;
 
+		// joint palette
+		VkDescriptorSetLayoutBinding jointLayoutBinding{};
+		jointLayoutBinding.binding = 1;
+		jointLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		jointLayoutBinding.descriptorCount = 1;
+		jointLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		jointLayoutBinding.pImmutableSamplers = nullptr;
+
+		std::array<VkDescriptorSetLayoutBinding, 2> frameBindings{ uboLayoutBinding, jointLayoutBinding };
+
 		VkDescriptorSetLayoutCreateInfo uboLayoutInfo{};
 		uboLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		uboLayoutInfo.bindingCount = 1;
-		uboLayoutInfo.pBindings = &uboLayoutBinding;
+		uboLayoutInfo.bindingCount = static_cast<uint32_t>(frameBindings.size());
+		uboLayoutInfo.pBindings = frameBindings.data();
 
 		if (vkCreateDescriptorSetLayout(*m_logicalDevice, &uboLayoutInfo, nullptr, &m_uboLayout) != VK_SUCCESS)
 		{
@@ -423,7 +964,7 @@ namespace ash
 		}
 
 		m_layouts.resize(2);
-		m_layouts = { m_uboLayout, m_textureLayout };
+		m_layouts = { m_uboLayout, m_bindlessSet ? m_bindlessSet->getLayout() : m_textureLayout };
 
 		//std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
 
@@ -438,47 +979,100 @@ namespace ash
 		}*/
 	}
 
-	void Graphics::createDescriptorSets(std::vector<std::unique_ptr<GameObject>>& gameObjects)
+	void Graphics::createFrameDescriptorSet()
 	{
-		std::vector<VkDescriptorSetLayout> layouts(m_swapChain->getImageCount(), m_uboLayout);
+		m_frameDescriptorSet = m_staticDescriptors->allocate(m_uboLayout);
 
-		VkDescriptorSetAllocateInfo allociInfo{};
-		allociInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allociInfo.descriptorPool = *m_descriptorPool;
-		allociInfo.descriptorSetCount = m_swapChain->getImageCount();
-		allociInfo.pSetLayouts = layouts.data();
+		// one set for every frame, the dynamic offsets pick the frame's uniform buffer object and joints
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = *m_frameAllocator;
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(UniformBufferObject);
 
-		m_descriptorSets.resize(m_swapChain->getImageCount());
-		if (vkAllocateDescriptorSets(*m_logicalDevice, &allociInfo, m_descriptorSets.data()) != VK_SUCCESS)
-		{
-			throw std::runtime_error("railed to allocate descriptor sets!");
-		}
+		// covers one frame's section of the palette
+		VkDescriptorBufferInfo jointInfo{};
+		jointInfo.buffer = *m_jointPalette;
+		jointInfo.offset = 0;
+		jointInfo.range = m_jointPalette->getFrameSize();
 
-		for (size_t i = 0; i < m_swapChain->getImageCount(); i++)
-		{
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = *m_uniformBuffers[i];
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
 
-			std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+		// uniform buffer
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = m_frameDescriptorSet;
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+		// joint palette
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = m_frameDescriptorSet;
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].dstArrayElement = 0;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pBufferInfo = &jointInfo;
+
+		vkUpdateDescriptorSets(*m_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
 
-			// uniform buffer
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = m_descriptorSets[i];
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &bufferInfo;
+	void Graphics::createDefaultTexture()
+	{
+		m_defaultTexture = std::make_unique<Image>(
+			m_logicalDevice.get(),
+			m_physicalDevice.get(),
+			1,
+			1,
+			VK_FORMAT_R8G8B8A8_UNORM,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			MemoryCategory::Texture);
 
-			vkUpdateDescriptorSets(*m_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-		}
+		UploadBatch batch{ m_logicalDevice.get(), m_physicalDevice.get() };
+		batch.copyToImage(*m_defaultTexture, VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 4, [](void* data, uint32_t, uint32_t)
+			{
+				memset(data, 0xff, 4);
+			});
+		batch.submit();
+		batch.wait();
+
+		m_defaultTextureSet = m_staticDescriptors->allocate(m_textureLayout);
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = *m_defaultTexture;	// * returns image view
+		imageInfo.sampler = m_textureSampler;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = m_defaultTextureSet;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(*m_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	}
 
+	void Graphics::createDescriptorSets(std::vector<std::unique_ptr<GameObject>>& gameObjects)
+	{
 		for (auto& gameObject : gameObjects)
 		{
-			gameObject->getModel()->createDescriptorSets(*m_descriptorPool, m_textureLayout, m_textureSampler);
+			if (m_bindlessSet)
+			{
+				gameObject->getModel()->createBindlessResources(m_bindlessSet.get());
+			}
+			else
+			{
+				gameObject->getModel()->createDescriptorSets(*m_staticDescriptors, m_textureLayout, m_textureSampler, m_defaultTextureSet);
+			}
 		}
+		invalidateRecordedDraws();
 	}
 
 	void Graphics::cleanupDescriptorSetLayout()
@@ -487,30 +1081,4 @@ namespace ash
 		vkDestroyDescriptorSetLayout(*m_logicalDevice, m_uboLayout, nullptr);
 		vkDestroyDescriptorSetLayout(*m_logicalDevice, m_textureLayout, nullptr);
 	}
-
-	void Graphics::cleanupDescriptorSets()
-	{
-		for (size_t i = 0; i < m_descriptorSets.size(); i++)
-		{
-			m_descriptorSets[i] = nullptr;
-		}
-	}
-
-	void Graphics::cleanupSwapChain(std::vector<std::unique_ptr<GameObject>>& gameObjects)
-	{
-		
-		cleanupDescriptorSets();
-
-		cleanupUniformBuffers();
-
-		cleanupCommandBuffers();
-		cleanupDepthResource();
-		m_swapChain			->cleanupFramebuffers();
-		m_graphicsPipeline	->cleanupPipeline();
-		m_renderPass		->cleanupRenderPass();
-		m_swapChain			->cleanupImageViews();
-		m_swapChain			->cleanupSwapChain();
-		m_descriptorPool	->cleanupDescriptorPool();
-
-	}
 }
\ No newline at end of file
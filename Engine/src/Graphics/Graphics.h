@@ -6,6 +6,11 @@
 #pragma once
 
 #include "Window.h"
+#include "GraphicsSettings.hpp"
+#include "RenderQueue.h"
+#include "GpuCuller.h"
+#include "HiZPyramid.h"
+#include "OcclusionBuffer.h"
 #include "Vulkan\Instance.h"
 #include "Vulkan\DebugMessenger.h"
 #include "Vulkan\Surface.h"
@@ -14,24 +19,35 @@
 #include "Vulkan\SwapChain.h"
 #include "Vulkan\RenderPass.h"
 #include "Vulkan\GraphicsPipeline.h"
-#include "Vulkan\DescriptorPool.h"
+#include "Vulkan\DescriptorAllocator.h"
+#include "Vulkan\BindlessSet.h"
+#include "Vulkan\GeometryHeap.h"
+#include "Vulkan\FrameAllocator.h"
+#include "Vulkan\JointPalette.h"
+#include "Vulkan\SecondaryCommandBuffers.h"
+#include "Vulkan\DeletionQueue.h"
 #include "Vulkan\Image.h"
 #include "GameObjects/GameObject.h"
+#include "GameObjects/SceneIndex.h"
 #include "Camera/Camera.h"
+#include "Utils/WorkerPool.h"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <array>
 #include <memory>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 namespace ash
 {
 	class Graphics
 	{
 	public:
-		Graphics(Window* window);
+		Graphics(Window* window, const GraphicsSettings& settings = {});
 		~Graphics();
 
 		/**
@@ -45,9 +61,12 @@ namespace ash
 		void waitForDeviceIdle();
 
 		/**
-		 * Generates a Model, this is here because Model.h requires access to the Vulkan device
+		 * Generates a Model, this is here because Model.h requires access to the Vulkan device.
+		 * With instancing, loading a path that is still in use returns the same model so its game objects
+		 * are drawn instanced, they then share the model's pose and animation. A model dropped by its
+		 * last game object is destroyed once the frames in flight are complete
 		 */
-		std::unique_ptr<Model> generateModel(std::string modelPath);
+		std::shared_ptr<Model> generateModel(std::string modelPath);
 
 		/**
 		 * Gets the current aspect ration of the swap chain images
@@ -55,15 +74,45 @@ namespace ash
 		float getAspectRatio() const { return m_swapChain->getAspectRatio(); }
 
 		/**
-		 * Creates a descriptor set for each swap chain image
+		 * Creates the texture descriptor sets of the provided GameObjects' models,
+		 * models that already have theirs are skipped
 		 */
 		void createDescriptorSets(std::vector<std::unique_ptr<GameObject>>& gameObjects);
 
+		/**
+		 * Forces draws to be recorded again next frame. Adding, removing and moving game objects is
+		 * detected, call this after changing anything else that is recorded, like a model's textures
+		 */
+		void invalidateRecordedDraws() { m_sceneRevision++; }
+
+		/**
+		 * Writes GPU memory allocator totals to the console
+		 */
+		void printMemoryStats() const;
+
+		/**
+		 * Returns GPU memory totals per category and per heap budget, for monitoring
+		 */
+		MemoryStats getMemoryStats() const;
+
+		/**
+		 * Returns the draw count and bind counts of the last recorded frame, before and after sorting
+		 */
+		const RenderQueueStats& getRenderQueueStats() const { return m_renderQueue.getStats(); }
+
+		/**
+		 * Spatial index of the game objects passed to the last renderGameObjects, for frustum,
+		 * sphere and ray queries
+		 */
+		const SceneIndex& getSceneIndex() const { return m_sceneIndex; }
 
 		/**
-		 * Called during swap chain recreation and class destruction
+		 * Turns the depth prepass on or off from the next frame, the pipelines are created the
+		 * first time it is enabled. Stays off with GPU culling
 		 */
-		void cleanupDescriptorSets();
+		void setDepthPrepass(bool enabled);
+
+		bool getDepthPrepass() const { return m_settings.depthPrepass; }
 
 	private:
 
@@ -72,6 +121,11 @@ namespace ash
 		 */
 		Window* m_window{};
 
+		/**
+		 * Renderer options, bindless is cleared when the GPU can't support it
+		 */
+		GraphicsSettings m_settings{};
+
 		/**
 		 * Vulkan Instance Wrapper, used to access Vulkan Library
 		 */
@@ -117,14 +171,143 @@ namespace ash
 		std::unique_ptr<GraphicsPipeline> m_graphicsPipeline{};
 
 		/**
-		 * Vulkan Descriptor Pool Wrapper, manages allocation of descriptor sets
+		 * Depth only pipeline of the depth prepass, null until the prepass is first enabled
+		 */
+		std::unique_ptr<GraphicsPipeline> m_depthPipeline{};
+
+		/**
+		 * Shading pipeline testing depth for equality after the prepass
+		 */
+		std::unique_ptr<GraphicsPipeline> m_equalPipeline{};
+
+		/**
+		 * Allocates long lived descriptor sets, the frame set and texture sets, grows as models are added.
+		 * Texture sets released by destroyed models are recycled through the deletion queue
+		 */
+		std::unique_ptr<DescriptorAllocator> m_staticDescriptors{};
+
+		/**
+		 * Descriptor indexed set holding all textures and materials, null unless bindless rendering is enabled
+		 */
+		std::unique_ptr<BindlessSet> m_bindlessSet{};
+
+		/**
+		 * Vertex and index buffers shared by every model, bound once per frame
+		 */
+		std::unique_ptr<GeometryHeap> m_geometryHeap{};
+
+		/**
+		 * Per frame uniform and storage data, one section per frame in flight
+		 */
+		std::unique_ptr<FrameAllocator> m_frameAllocator{};
+
+		/**
+		 * Joint matrices of every skin, one section per frame in flight
+		 */
+		std::unique_ptr<JointPalette> m_jointPalette{};
+
+		/**
+		 * Threads recording draw calls, a single thread records everything itself
+		 */
+		std::unique_ptr<WorkerPool> m_workerPool{};
+
+		/**
+		 * One secondary command buffer per recording thread and frame in flight,
+		 * null when draws are always recorded inline
+		 */
+		std::unique_ptr<SecondaryCommandBuffers> m_secondaryCommandBuffers{};
+
+		/**
+		 * Draws of the game objects sorted by state, rebuilt whenever draws are recorded
 		 */
-		std::unique_ptr<DescriptorPool> m_descriptorPool{};
+		RenderQueue m_renderQueue{};
+
+		/**
+		 * What a frame's secondary command buffers were recorded with
+		 */
+		struct RecordedDraws
+		{
+			uint64_t				sceneRevision	{ 0 };
+			uint32_t				bufferCount		{ 0 };
+			std::array<uint32_t, 2>	dynamicOffsets	{};
+			uint32_t				instanceBase	{ 0 };
+			FrustumPlanes			planes			{};		// only compared when frustum culling
+		};
+
+		/**
+		 * Bounding volume hierarchy of the game objects, kept in sync while the scene revision changes
+		 */
+		SceneIndex m_sceneIndex{};
+
+		/**
+		 * Game objects the last frustum query returned
+		 */
+		std::vector<GameObject*> m_visibleObjects{};
+
+		/**
+		 * Depth buffer the occluders are drawn into on the CPU, null without software occlusion
+		 */
+		std::unique_ptr<OcclusionBuffer> m_occlusionBuffer{};
+
+		/**
+		 * Occluder candidates of the frame and their size on screen
+		 */
+		std::vector<std::pair<float, GameObject*>> m_occluders{};
+
+		/**
+		 * Loaded models by path, entries expire with the last game object using them. Only filled with instancing
+		 */
+		std::unordered_map<std::string, std::weak_ptr<Model>> m_models{};
+
+		/**
+		 * Every loaded model, searched for idle textures when memory runs low. Expired entries are dropped then
+		 */
+		std::vector<std::weak_ptr<Model>> m_loadedModels{};
+
+		/**
+		 * Models of the frame's game objects, each listed once
+		 */
+		std::vector<Model*> m_frameModels{};
+
+		/**
+		 * Depth pyramid the GPU culler tests occlusion against, null without occlusion culling
+		 */
+		std::unique_ptr<HiZPyramid> m_hiZPyramid{};
+
+		/**
+		 * Culls and draws on the GPU when GPU culling is enabled, null otherwise
+		 */
+		std::unique_ptr<GpuCuller> m_gpuCuller{};
+
+		/**
+		 * Recorded draws of every frame in flight, or what the GPU culler was updated with
+		 */
+		std::vector<RecordedDraws> m_recordedDraws{};
+
+		/**
+		 * Ids of the game objects drawn last frame, compared against to detect added, removed and reordered objects
+		 */
+		std::vector<uint64_t> m_sceneIds{};
+
+		/**
+		 * Incremented whenever recorded draws become stale
+		 */
+		uint64_t m_sceneRevision{ 1 };
 
 		/**
 		 * Used for determining draw order of objects
 		 */
 		std::unique_ptr<Image> m_depthImage{};
+
+		/**
+		 * White texture sampled by primitives without a base color texture, null with bindless rendering
+		 */
+		std::unique_ptr<Image> m_defaultTexture{};
+
+		/**
+		 * Texture set pointing at the default texture
+		 */
+		VkDescriptorSet m_defaultTextureSet{};
 		
 		/**
 		 * Array of Vulkan Command Buffers, used for recording render operations
@@ -165,6 +348,18 @@ namespace ash
 		 */
 		size_t m_currentFrame = 0;
 
+		/**
+		 * Number of frames submitted so far, the frame waited on at the start of a frame tells
+		 * how many of them are complete
+		 */
+		uint64_t m_submittedFrames{ 0 };
+
+		/**
+		 * Swap chain objects replaced during recreation and models no game object uses anymore,
+		 * kept until the frames using them are done
+		 */
+		DeletionQueue m_deletionQueue{};
+
 		/**
 		 * Vulkan Descriptor Set Layout, used to tell shaders what kind of data
 		 * to expect from uniform buffers & push constants
@@ -176,11 +371,6 @@ namespace ash
 		 */
 		VkSampler m_textureSampler{};
 
-		/**
-		 * Array of Uniform buffers, one for each swap chain image
-		 */
-		std::vector<std::unique_ptr<Buffer>> m_uniformBuffers;
-
 		/**
 		 * Creates Vulkan Command buffers, called during swap chain recreation
 		 */
@@ -196,26 +386,100 @@ namespace ash
 		/**
 		 * Initiates the Vulkan Render Pass, start render pass for binding and 
 		 * draw call recording
+		 * @param contents VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS when the draws are recorded on other threads
+		 * @param part of the frame drawn, the whole frame unless work must happen between drawing
+		 */
+		void startRenderPass(const RenderTarget& target, VkCommandBuffer commandBuffer, VkSubpassContents contents,
+			RenderPassPart part = RenderPassPart::Whole);
+
+		/**
+		 * Returns the attachments of the swap chain image
+		 */
+		RenderTarget getRenderTarget(uint32_t imageIndex) const;
+
+		/**
+		 * Binds the pipeline, frame descriptor sets and geometry heap, needed once per command buffer
+		 * @param dynamicOffsets of the uniform buffer object and the joint palette
+		 * @param pipeline the main graphics pipeline when null, any other shares its layout
 		 */
-		void startRenderPass(VkFramebuffer framebuffer, VkCommandBuffer commandBuffer);
+		void bindFrameState(VkCommandBuffer commandBuffer, const std::array<uint32_t, 2>& dynamicOffsets,
+			const GraphicsPipeline* pipeline = nullptr);
 
 		/**
-		 * Ends the Vulkan Render Pass, stops recording of binding and draw calls
-		 * for the current frame
+		 * Fills the render queue with the game objects' draws and sorts it
 		 */
-		void endRenderPass(VkCommandBuffer commandBuffer);
+		void buildRenderQueue(std::vector<std::unique_ptr<GameObject>>& gameObjects, Camera* camera);
 
 		/**
-		 * Cleans up swap chain, gameObjects are needed since descriptor sets are
-		 * linked to the swap chain image count
+		 * Draws the largest visible game objects into the occlusion buffer and removes the visible
+		 * game objects it hides
 		 */
-		void cleanupSwapChain(std::vector<std::unique_ptr<GameObject>>& gameObjects);
+		void cullOccludedObjects(Camera* camera);
 
 		/**
-		 * Recreates Vulkan Swap Chain, gameObjects are needed since descriptor sets are
-		 * linked to the swap chain image count
+		 * Returns the vertex shader matching the settings, the depth only variant for the prepass
 		 */
-		void recreateSwapChain(std::vector<std::unique_ptr<GameObject>>& gameObjects);
+		std::string getVertexShader(bool depthOnly) const;
+
+		/**
+		 * Splits the sorted render queue over bufferCount of the frame's secondary command buffers,
+		 * recorded in parallel on the worker pool
+		 * @param instanceBase joint palette index the instance transforms are written to
+		 * @param framebuffer may be VK_NULL_HANDLE when the buffers are executed with any swap chain image
+		 */
+		void recordDraws(uint32_t bufferCount, const std::array<uint32_t, 2>& dynamicOffsets, uint32_t instanceBase, VkFramebuffer framebuffer);
+
+		/**
+		 * Copies the render queue's instance transforms into this frame's section of the joint palette
+		 */
+		void writeInstances();
+
+		/**
+		 * Bumps the scene revision when game objects were added, removed, reordered or moved since last frame
+		 * and brings the scene index up to date. Only moved objects are refit while the objects stay the same
+		 */
+		void updateSceneRevision(const std::vector<std::unique_ptr<GameObject>>& gameObjects);
+
+		/**
+		 * Ends the Vulkan Render Pass begun with the same target and part,
+		 * the command buffer is still recording
+		 */
+		void endRenderPass(const RenderTarget& target, VkCommandBuffer commandBuffer, RenderPassPart part = RenderPassPart::Whole);
+
+		/**
+		 * Hands the replaced swap chain objects, the depth image and the command buffers to the
+		 * deletion queue, descriptor sets don't depend on them and are kept, neither do the render
+		 * pass and the pipelines
+		 */
+		void retireSwapChain(SwapChain::RetiredObjects&& retired);
+
+		/**
+		 * Recreates Vulkan Swap Chain and what depends on its extent: depth, framebuffers and command buffers.
+		 * The old swap chain is passed on and the old objects are retired, so frames in flight aren't waited on
+		 */
+		void recreateSwapChain();
+
+		/**
+		 * Waits until every submitted frame is complete and destroys what they retired
+		 */
+		void waitForFramesInFlight();
+
+		/**
+		 * Eviction handler of the memory allocator, halves the textures of loaded models that no
+		 * game object used during the frames in flight, least recently used first
+		 * @return number of bytes released
+		 */
+		VkDeviceSize downgradeIdleTextures(uint32_t heapIndex, VkDeviceSize bytesNeeded);
+
+		/**
+		 * Number of submitted frames known to be complete, once the current frame's fence was waited on
+		 */
+		uint64_t getCompletedFrames() const;
+
+		/**
+		 * Recreates the render pass and every pipeline, needed when the swap chain's format changed
+		 */
+		void recreateRenderPass();
 
 		/**
 		 * Called during swap chain recreation and when class is destroyed
@@ -252,36 +516,31 @@ namespace ash
 		 */
 		void createDepthResources();
 
-		/**
-		 * Called in destructor
-		 */
-		void cleanupDepthResource();
-
 		/**
 		 * True if provided format is compatible with a stencil component
 		 */
 		bool hasStencilComponent(VkFormat format);
 
 		/**
-		 * Creates a uniform buffer for each swap chain frame to allow for
-		 * matrix transformations during shading
+		 * Allocates and writes the descriptor set pointing at the frame allocator and joint palette
 		 */
-		void createUniformBuffers();
+		void createFrameDescriptorSet();
 
 		/**
-		 * Deletes all uniform buffers, called during swap chain recreation
+		 * Uploads the white default texture and writes its texture set, only used without bindless rendering
 		 */
-		void cleanupUniformBuffers();
+		void createDefaultTexture();
 
 		/**
-		 * Updates uniform buffers with new transform data
+		 * Writes the camera matrices into the current frame's section of the frame allocator
+		 * @return dynamic offset of the uniform buffer object
 		 */
-		void updateUniformBuffer(uint32_t currentImage, VkExtent2D extent,Camera* camera);
+		uint32_t updateUniformBuffer(Camera* camera);
 
 		/**
-		 * Array of Descriptor Sets, one for each Uniform Buffer
+		 * Descriptor Set pointing at the frame allocator and joint palette, the frame's data is selected with dynamic offsets
 		 */
-		std::vector<VkDescriptorSet> m_descriptorSets{};
+		VkDescriptorSet m_frameDescriptorSet{};
 
 		VkDescriptorSetLayout m_uboLayout{};
 
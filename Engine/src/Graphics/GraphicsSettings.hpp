@@ -0,0 +1,163 @@
+/**
+ * Renderer options chosen when the Graphics class is created
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace ash
+{
+	/**
+	 * How buffer data reaches device local memory
+	 */
+	enum class UploadPath
+	{
+		Auto,			// write directly on integrated GPUs and resizable BAR, stage otherwise
+		Staging,		// always copy through the staging ring
+		DirectWrite		// write directly whenever the GPU has host visible device local memory
+	};
+
+	/**
+	 * Renderer options chosen when the Graphics class is created
+	 */
+	struct GraphicsSettings
+	{
+		/**
+		 * Bind every texture and material once per frame through a descriptor indexed set
+		 * instead of binding a descriptor set per primitive. Falls back to per primitive
+		 * sets when the GPU lacks descriptor indexing. Requires shaders/bindless_frag.spv
+		 */
+		bool bindless{ false };
+
+		/**
+		 * Size in bytes of the persistently mapped ring all uploads are staged in.
+		 * Larger uploads are split into chunks, so this only limits how much is in flight
+		 */
+		VkDeviceSize stagingRingSize{ 32ull * 1024 * 1024 };
+
+		/**
+		 * Number of vertices and indices the geometry heap shared by all models can hold
+		 */
+		uint32_t geometryVertexCapacity{ 1u << 20 };
+
+		uint32_t geometryIndexCapacity{ 1u << 22 };
+
+		/**
+		 * Size in bytes of the per frame uniform and storage data, one section is kept per frame in flight
+		 */
+		VkDeviceSize frameDataSize{ 4ull * 1024 * 1024 };
+
+		/**
+		 * Number of joint matrices all skins together can use each frame,
+		 * the transforms of instanced draws are stored here as well
+		 */
+		uint32_t jointPaletteCapacity{ 1u << 15 };
+
+		/**
+		 * Deform skinned meshes with their joints in the vertex shader.
+		 * Requires shaders/skinned_vert.spv
+		 */
+		bool skinning{ false };
+
+		/**
+		 * Draw every game object sharing a model primitive with a single instanced draw, the
+		 * transforms are read by gl_InstanceIndex instead of pushed per draw. Game objects loading the
+		 * same path share one model, and with it its pose and animation.
+		 * Requires shaders/instanced_vert.spv, or shaders/skinned_instanced_vert.spv with skinning
+		 */
+		bool instancing{ false };
+
+		/**
+		 * Cull draws against the view frustum in a compute shader and draw the visible ones with
+		 * one indirect draw per material, so the per frame CPU cost doesn't grow with the scene.
+		 * Implies instancing. Falls back to CPU recorded draws when the GPU lacks indirect
+		 * draws with a first instance. Requires shaders/cull_comp.spv
+		 */
+		bool gpuCulling{ false };
+
+		/**
+		 * Number of draws, every instance of every primitive, the GPU culling path can handle each frame
+		 */
+		uint32_t gpuCullingCapacity{ 1u << 16 };
+
+		/**
+		 * Skip draws hidden behind others with a depth pyramid, GPU culling draws what was visible
+		 * last frame, builds the pyramid from its depth and then draws what the pyramid doesn't hide.
+		 * Requires gpuCulling and a depth format that can be sampled, shaders/hiz_comp.spv and
+		 * shaders/cull_occlusion_comp.spv
+		 */
+		bool occlusionCulling{ false };
+
+		/**
+		 * Number of descriptor sets in each pool, more pools are chained on as they fill
+		 */
+		uint32_t descriptorSetsPerPool{ 256 };
+
+		/**
+		 * Whether static and per frame buffers live in host visible device local memory and are
+		 * written with memcpy, skipping the staging copy. Images are always staged
+		 */
+		UploadPath uploadPath{ UploadPath::Auto };
+
+		/**
+		 * Threads recording draw calls into secondary command buffers, including the render thread.
+		 * 0 uses one per core, 1 always records inline on the render thread
+		 */
+		uint32_t recordThreads{ 0 };
+
+		/**
+		 * Fewest game objects for recording to be split over threads, smaller scenes record inline
+		 */
+		uint32_t parallelRecordThreshold{ 512 };
+
+		/**
+		 * Test bounds against the camera frustum on the CPU, whole game objects through the scene
+		 * index and then their primitives, and leave the ones outside out of the render queue. Skinned models are
+		 * never culled. Not used by GPU culling, which does its own
+		 */
+		bool frustumCulling{ true };
+
+		/**
+		 * After frustum culling, draw the nearest large game objects' simplified geometry into a
+		 * small depth buffer on the CPU and leave the game objects it hides out of the render queue.
+		 * Needs frustumCulling, not used by GPU culling
+		 */
+		bool softwareOcclusion{ false };
+
+		/**
+		 * Draw the depth of the opaque draws front to back first, then shade only the fragments
+		 * that are left with an EQUAL depth test, so hidden fragments are never shaded. Can be
+		 * toggled with Graphics::setDepthPrepass. Draws are recorded on the render thread while
+		 * enabled, not used by GPU culling. Requires the DEPTH_ONLY vertex shader variants, shaders/depth_vert.spv and the like
+		 */
+		bool depthPrepass{ false };
+
+		/**
+		 * Give the attachments when recording through VK_KHR_dynamic_rendering instead of creating
+		 * render pass and framebuffer objects, so recreating the swap chain creates no framebuffers.
+		 * Falls back to render pass objects when the GPU lacks the extension
+		 */
+		bool dynamicRendering{ false };
+
+		/**
+		 * Size of the software occlusion depth buffer in pixels
+		 */
+		uint32_t occlusionBufferWidth{ 256 };
+
+		uint32_t occlusionBufferHeight{ 128 };
+
+		/**
+		 * Most game objects drawn as occluders each frame, picked by their size on screen
+		 */
+		uint32_t maxOccluders{ 16 };
+
+		/**
+		 * Record draws into secondary command buffers that are kept and executed again while
+		 * no game object was added, removed or moved, so static scenes skip recording entirely.
+		 * With frustum culling the camera moving records them again as well
+		 */
+		bool reuseCommandBuffers{ true };
+	};
+}
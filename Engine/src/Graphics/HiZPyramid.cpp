@@ -0,0 +1,333 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "HiZPyramid.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ash
+{
+	namespace
+	{
+		/**
+		 * Threads per work group of the downsampling shader in each dimension
+		 */
+		constexpr uint32_t WORK_GROUP_SIZE{ 8 };
+
+		/**
+		 * Push constants of hiz.comp
+		 */
+		struct HiZPushConstants
+		{
+			uint32_t sourceWidth	{ 0 };
+			uint32_t sourceHeight	{ 0 };
+			uint32_t width			{ 0 };
+			uint32_t height			{ 0 };
+		};
+	}
+
+	HiZPyramid::HiZPyramid(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, const std::string& shaderPath) :
+		m_logicalDevice{ logicalDevice }
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType			= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter		= VK_FILTER_NEAREST;
+		samplerInfo.minFilter		= VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode		= VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod			= 0.0f;
+		samplerInfo.maxLod			= static_cast<float>(MAX_LEVELS);
+
+		if (vkCreateSampler(*m_logicalDevice, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid sampler!");
+		}
+
+		createDescriptorSets();
+
+		m_pipeline = std::make_unique<ComputePipeline>(logicalDevice, std::vector<VkDescriptorSetLayout>{ m_buildSetLayout },
+			static_cast<uint32_t>(sizeof(HiZPushConstants)), shaderPath);
+	}
+
+	HiZPyramid::~HiZPyramid()
+	{
+		cleanupPyramid();
+		vkDestroyDescriptorPool(*m_logicalDevice, m_descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(*m_logicalDevice, m_buildSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(*m_logicalDevice, m_readSetLayout, nullptr);
+		vkDestroySampler(*m_logicalDevice, m_sampler, nullptr);
+	}
+
+	bool HiZPyramid::supportsDepthFormat(const PhysicalDevice* physicalDevice, VkFormat depthFormat)
+	{
+		VkFormatProperties properties{};
+		vkGetPhysicalDeviceFormatProperties(*physicalDevice, depthFormat, &properties);
+		return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+	}
+
+	void HiZPyramid::createPyramid(const Image& depthImage, VkFormat depthFormat, VkExtent2D extent)
+	{
+		cleanupPyramid();
+
+		m_depthImage	= depthImage.getImage();
+		m_depthExtent	= extent;
+		m_depthAspects	= VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+		{
+			// layout transitions of combined formats cover both aspects
+			m_depthAspects |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+
+		// half the depth rounded up, then mip levels down to a single texel
+		const uint32_t width		{ std::max((extent.width + 1) / 2, 1u) };
+		const uint32_t height		{ std::max((extent.height + 1) / 2, 1u) };
+		uint32_t levelCount			{ 1 };
+		while ((std::max(width, height) >> levelCount) > 0 && levelCount < MAX_LEVELS)
+		{
+			levelCount++;
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width	= width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth	= 1;
+		imageInfo.mipLevels		= levelCount;
+		imageInfo.arrayLayers	= 1;
+		imageInfo.format		= VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage			= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.samples		= VK_SAMPLE_COUNT_1_BIT;
+
+		if (vkCreateImage(*m_logicalDevice, &imageInfo, nullptr, &m_image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid image!");
+		}
+		m_allocation		= m_logicalDevice->getAllocator().allocateImage(m_image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, MemoryCategory::RenderTarget);
+		m_undefinedLayout	= true;
+
+		m_view = createView(0, levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			m_levelViews.push_back(createView(level, 1));
+		}
+
+		// level 0 reads the depth attachment, every other level the one below it
+		std::vector<VkDescriptorImageInfo> sourceInfos(levelCount);
+		std::vector<VkDescriptorImageInfo> targetInfos(levelCount);
+		std::vector<VkWriteDescriptorSet> descriptorWrites{};
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			sourceInfos[level] = level == 0
+				? VkDescriptorImageInfo{ m_sampler, depthImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }
+				: VkDescriptorImageInfo{ m_sampler, m_levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+			targetInfos[level] = VkDescriptorImageInfo{ VK_NULL_HANDLE, m_levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+
+			for (uint32_t binding = 0; binding < 2; binding++)
+			{
+				VkWriteDescriptorSet write{};
+				write.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.dstSet			= m_buildSets[level];
+				write.dstBinding		= binding;
+				write.descriptorCount	= 1;
+				write.descriptorType	= binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+				write.pImageInfo		= binding == 0 ? &sourceInfos[level] : &targetInfos[level];
+				descriptorWrites.push_back(write);
+			}
+		}
+
+		VkDescriptorImageInfo readInfo{ m_sampler, m_view, VK_IMAGE_LAYOUT_GENERAL };
+
+		VkWriteDescriptorSet readWrite{};
+		readWrite.sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		readWrite.dstSet			= m_readSet;
+		readWrite.dstBinding		= 0;
+		readWrite.descriptorCount	= 1;
+		readWrite.descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		readWrite.pImageInfo		= &readInfo;
+		descriptorWrites.push_back(readWrite);
+
+		vkUpdateDescriptorSets(*m_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	void HiZPyramid::cleanupPyramid()
+	{
+		for (VkImageView view : m_levelViews)
+		{
+			vkDestroyImageView(*m_logicalDevice, view, nullptr);
+		}
+		m_levelViews.clear();
+
+		if (m_image)
+		{
+			vkDestroyImageView(*m_logicalDevice, m_view, nullptr);
+			vkDestroyImage(*m_logicalDevice, m_image, nullptr);
+			m_logicalDevice->getAllocator().free(m_allocation);
+			m_view	= VK_NULL_HANDLE;
+			m_image	= VK_NULL_HANDLE;
+		}
+	}
+
+	void HiZPyramid::build(VkCommandBuffer commandBuffer)
+	{
+		// the depth is sampled once the last fragment tests wrote it, the pyramid is written once
+		// last frame's culling read it
+		std::array<VkImageMemoryBarrier, 2> barriers{};
+		barriers[0].sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[0].srcAccessMask					= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barriers[0].dstAccessMask					= VK_ACCESS_SHADER_READ_BIT;
+		barriers[0].oldLayout						= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		barriers[0].newLayout						= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].image							= m_depthImage;
+		barriers[0].subresourceRange.aspectMask		= m_depthAspects;
+		barriers[0].subresourceRange.levelCount		= 1;
+		barriers[0].subresourceRange.layerCount		= 1;
+
+		barriers[1].sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[1].srcAccessMask					= 0;
+		barriers[1].dstAccessMask					= VK_ACCESS_SHADER_WRITE_BIT;
+		barriers[1].oldLayout						= m_undefinedLayout ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL;
+		barriers[1].newLayout						= VK_IMAGE_LAYOUT_GENERAL;
+		barriers[1].srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barriers[1].dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barriers[1].image							= m_image;
+		barriers[1].subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		barriers[1].subresourceRange.levelCount		= getLevelCount();
+		barriers[1].subresourceRange.layerCount		= 1;
+		m_undefinedLayout = false;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, *m_pipeline);
+
+		VkMemoryBarrier levelBarrier{};
+		levelBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		levelBarrier.srcAccessMask	= VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+
+		HiZPushConstants push{ m_depthExtent.width, m_depthExtent.height, 0, 0 };
+		for (uint32_t level = 0; level < getLevelCount(); level++)
+		{
+			// level 0 rounds up so it covers the depth, further levels have Vulkan's mip sizes
+			push.width	= std::max(level == 0 ? (push.sourceWidth + 1) / 2 : push.sourceWidth / 2, 1u);
+			push.height	= std::max(level == 0 ? (push.sourceHeight + 1) / 2 : push.sourceHeight / 2, 1u);
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getLayout(), 0, 1, &m_buildSets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, m_pipeline->getLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+			vkCmdDispatch(commandBuffer, (push.width + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, (push.height + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1);
+
+			// the next level reads this one, the last barrier publishes the pyramid to the culling
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+			push.sourceWidth	= push.width;
+			push.sourceHeight	= push.height;
+		}
+
+		// drawing continues into the same depth
+		VkImageMemoryBarrier depthBarrier{ barriers[0] };
+		depthBarrier.srcAccessMask	= VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.dstAccessMask	= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.oldLayout		= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+	}
+
+	void HiZPyramid::createDescriptorSets()
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding			= 0;
+		bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount	= 1;
+		bindings[0].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding			= 1;
+		bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount	= 1;
+		bindings[1].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings	= bindings.data();
+
+		if (vkCreateDescriptorSetLayout(*m_logicalDevice, &layoutInfo, nullptr, &m_buildSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+		}
+
+		// the read set only has the sampled pyramid
+		layoutInfo.bindingCount = 1;
+		if (vkCreateDescriptorSetLayout(*m_logicalDevice, &layoutInfo, nullptr, &m_readSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+		}
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount	= MAX_LEVELS + 1;
+		poolSizes[1].type				= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		poolSizes[1].descriptorCount	= MAX_LEVELS;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount	= static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes		= poolSizes.data();
+		poolInfo.maxSets		= MAX_LEVELS + 1;
+
+		if (vkCreateDescriptorPool(*m_logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+
+		std::array<VkDescriptorSetLayout, MAX_LEVELS + 1> layouts{};
+		layouts.fill(m_buildSetLayout);
+		layouts[MAX_LEVELS] = m_readSetLayout;
+
+		std::array<VkDescriptorSet, MAX_LEVELS + 1> sets{};
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool		= m_descriptorPool;
+		allocInfo.descriptorSetCount	= static_cast<uint32_t>(layouts.size());
+		allocInfo.pSetLayouts			= layouts.data();
+
+		if (vkAllocateDescriptorSets(*m_logicalDevice, &allocInfo, sets.data()) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+		}
+		std::copy(sets.begin(), sets.begin() + MAX_LEVELS, m_buildSets.begin());
+		m_readSet = sets[MAX_LEVELS];
+	}
+
+	VkImageView HiZPyramid::createView(uint32_t level, uint32_t levelCount) const
+	{
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType								= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image								= m_image;
+		viewInfo.viewType							= VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format								= VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel		= level;
+		viewInfo.subresourceRange.levelCount		= levelCount;
+		viewInfo.subresourceRange.baseArrayLayer	= 0;
+		viewInfo.subresourceRange.layerCount		= 1;
+
+		VkImageView view{};
+		if (vkCreateImageView(*m_logicalDevice, &viewInfo, nullptr, &view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid image view!");
+		}
+		return view;
+	}
+}
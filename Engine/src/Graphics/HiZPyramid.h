@@ -0,0 +1,157 @@
+/**
+ * Hierarchical depth pyramid built from the depth attachment, for occlusion culling
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/PhysicalDevice.h"
+#include "Vulkan/LogicalDevice.h"
+#include "Vulkan/ComputePipeline.h"
+#include "Vulkan/Image.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Hierarchical depth pyramid built from the depth attachment, for occlusion culling.
+	 * Level 0 is half the depth attachment's size rounded up and every texel holds the farthest
+	 * depth of the 2x2 texels below it, 3 wide along the last row or column of an odd sized level,
+	 * so a single texel of a coarse level tells whether anything under a screen rectangle is
+	 * nearer than a given depth. The image stays in VK_IMAGE_LAYOUT_GENERAL and is read through getReadSet
+	 */
+	class HiZPyramid
+	{
+	public:
+		/**
+		 * Most levels a pyramid can have, enough for a 65536 texel wide depth attachment
+		 */
+		static constexpr uint32_t MAX_LEVELS{ 16 };
+
+		HiZPyramid(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, const std::string& shaderPath = "shaders/hiz_comp.spv");
+		~HiZPyramid();
+
+		HiZPyramid(const HiZPyramid&) = delete;
+		HiZPyramid& operator=(const HiZPyramid&) = delete;
+
+		/**
+		 * Whether the depth format can be sampled, which building the pyramid requires
+		 */
+		static bool supportsDepthFormat(const PhysicalDevice* physicalDevice, VkFormat depthFormat);
+
+		/**
+		 * Creates the pyramid for a depth attachment, called with the depth resources.
+		 * The depth image needs VK_IMAGE_USAGE_SAMPLED_BIT
+		 */
+		void createPyramid(const Image& depthImage, VkFormat depthFormat, VkExtent2D extent);
+
+		/**
+		 * Destroys the pyramid, called during swap chain recreation
+		 */
+		void cleanupPyramid();
+
+		/**
+		 * Records the build from the depth attachment, must be outside a render pass.
+		 * Expects the depth in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL and leaves it there,
+		 * later compute shaders can read the pyramid
+		 */
+		void build(VkCommandBuffer commandBuffer);
+
+		/**
+		 * Layout of the set reading the pyramid, a combined image sampler at binding 0
+		 */
+		VkDescriptorSetLayout getReadSetLayout() const { return m_readSetLayout; }
+
+		const VkDescriptorSet& getReadSet() const { return m_readSet; }
+
+		/**
+		 * Size of the depth attachment the pyramid is built from
+		 */
+		VkExtent2D getDepthExtent() const { return m_depthExtent; }
+
+		uint32_t getLevelCount() const { return static_cast<uint32_t>(m_levelViews.size()); }
+
+	private:
+
+		/**
+		 * Vulkan Logical Device, used for resource destruction
+		 */
+		const LogicalDevice* m_logicalDevice{};
+
+		/**
+		 * Reads mip levels without filtering, clamped to the edge
+		 */
+		VkSampler m_sampler{};
+
+		/**
+		 * Holds the build sets and the read set, only ever allocated from once
+		 */
+		VkDescriptorPool m_descriptorPool{};
+
+		/**
+		 * Layout of the build sets, the source level at binding 0 and the level written at binding 1
+		 */
+		VkDescriptorSetLayout m_buildSetLayout{};
+
+		VkDescriptorSetLayout m_readSetLayout{};
+
+		/**
+		 * Build set of every level, level 0 reads the depth attachment
+		 */
+		std::array<VkDescriptorSet, MAX_LEVELS> m_buildSets{};
+
+		VkDescriptorSet m_readSet{};
+
+		/**
+		 * Downsampling shader
+		 */
+		std::unique_ptr<ComputePipeline> m_pipeline{};
+
+		/**
+		 * Pyramid image holding every level
+		 */
+		VkImage m_image{};
+
+		MemoryAllocation m_allocation{};
+
+		/**
+		 * View of all levels, read by the culling
+		 */
+		VkImageView m_view{};
+
+		/**
+		 * View of each level, written by the build
+		 */
+		std::vector<VkImageView> m_levelViews{};
+
+		/**
+		 * Depth attachment the pyramid is built from
+		 */
+		VkImage m_depthImage{};
+
+		VkImageAspectFlags m_depthAspects{ VK_IMAGE_ASPECT_DEPTH_BIT };
+
+		VkExtent2D m_depthExtent{};
+
+		/**
+		 * Whether the image still has to be moved out of VK_IMAGE_LAYOUT_UNDEFINED
+		 */
+		bool m_undefinedLayout{ true };
+
+		/**
+		 * Creates the layouts, the pool and its sets
+		 */
+		void createDescriptorSets();
+
+		/**
+		 * Returns a view of levelCount levels of the pyramid starting at level
+		 */
+		VkImageView createView(uint32_t level, uint32_t levelCount) const;
+	};
+}
@@ -0,0 +1,407 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "OcclusionBuffer.h"
+#include "Utils/CpuFeatures.h"
+
+#if defined(ASH_X86)
+#include <immintrin.h>	// SSE2
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace ash
+{
+	namespace
+	{
+		/**
+		 * Vertices closer to the camera plane than this are treated as behind it
+		 */
+		constexpr float MIN_CLIP_W{ 1e-5f };
+
+		/**
+		 * A triangle evaluated along one row of pixels, a * x + row is each function at pixel center x
+		 */
+		struct Span
+		{
+			float edgeA[3]		{};
+			float edgeRow[3]	{};
+			float depthA		{ 0.0f };
+			float depthRow		{ 0.0f };
+			float minDepth		{ 0.0f };
+			float maxDepth		{ 0.0f };
+		};
+
+		/**
+		 * Keeps the nearer depth of the pixels in [first, last] the triangle covers, see Triangle
+		 */
+		void rasterizeSpanScalar(const Span& span, float* row, uint32_t first, uint32_t last)
+		{
+			for (uint32_t x = first; x <= last; x++)
+			{
+				const float center{ static_cast<float>(x) + 0.5f };
+
+				bool inside{ true };
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					inside = inside && span.edgeA[i] * center + span.edgeRow[i] >= 0.0f;
+				}
+				if (!inside)
+				{
+					continue;
+				}
+
+				float depth{ span.depthA * center + span.depthRow };
+				depth = std::min(std::max(depth, span.minDepth), span.maxDepth);
+				row[x] = std::min(row[x], depth);
+			}
+		}
+
+#if defined(ASH_X86)
+		/**
+		 * Same as the scalar path 4 pixels at a time, the row must be readable in whole groups of 4
+		 */
+		ASH_TARGET("sse2")
+		void rasterizeSpanSse2(const Span& span, float* row, uint32_t first, uint32_t last)
+		{
+			const __m128 offsets	{ _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f) };
+			const __m128 zero		{ _mm_setzero_ps() };
+			const __m128 minDepth	{ _mm_set1_ps(span.minDepth) };
+			const __m128 maxDepth	{ _mm_set1_ps(span.maxDepth) };
+			const __m128i firstLane	{ _mm_set1_epi32(static_cast<int32_t>(first)) };
+			const __m128i lastLane	{ _mm_set1_epi32(static_cast<int32_t>(last)) };
+
+			for (uint32_t x = first & ~3u; x <= last; x += 4)
+			{
+				const __m128	center	{ _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets) };
+				const __m128i	lanes	{ _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(x)), _mm_set_epi32(3, 2, 1, 0)) };
+
+				// lanes outside [first, last] belong to pixels of the neighbouring tile or outside the triangle's bounds
+				__m128 inside{ _mm_castsi128_ps(_mm_andnot_si128(
+					_mm_or_si128(_mm_cmplt_epi32(lanes, firstLane), _mm_cmpgt_epi32(lanes, lastLane)), _mm_set1_epi32(-1))) };
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					const __m128 edge{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(span.edgeA[i]), center), _mm_set1_ps(span.edgeRow[i])) };
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+				}
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				__m128 depth{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(span.depthA), center), _mm_set1_ps(span.depthRow)) };
+				depth = _mm_min_ps(_mm_max_ps(depth, minDepth), maxDepth);
+
+				const __m128 stored{ _mm_loadu_ps(row + x) };
+				const __m128 nearer{ _mm_min_ps(stored, depth) };
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+			}
+		}
+#endif
+	}
+
+	OccluderMesh simplifyOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t maxTriangles)
+	{
+		// area of every triangle that has one, paired with its index
+		std::vector<std::pair<float, uint32_t>> triangles{};
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const glm::vec3&	a		{ positions[indices[i]] };
+			const glm::vec3&	b		{ positions[indices[i + 1]] };
+			const glm::vec3&	c		{ positions[indices[i + 2]] };
+			const float			area	{ glm::length(glm::cross(b - a, c - a)) };
+			if (area > 0.0f)
+			{
+				triangles.emplace_back(area, static_cast<uint32_t>(i / 3));
+			}
+		}
+
+		// the largest triangles, ties go to the first so every run picks the same ones
+		if (triangles.size() > maxTriangles)
+		{
+			std::partial_sort(triangles.begin(), triangles.begin() + maxTriangles, triangles.end(),
+				[](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b)
+				{
+					return a.first > b.first || (a.first == b.first && a.second < b.second);
+				});
+			triangles.resize(maxTriangles);
+			std::sort(triangles.begin(), triangles.end(),
+				[](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.second < b.second; });
+		}
+
+		OccluderMesh			mesh	{};
+		std::vector<uint32_t>	remap	(positions.size(), UINT32_MAX);
+		for (const auto& triangle : triangles)
+		{
+			for (uint32_t v = 0; v < 3; v++)
+			{
+				const uint32_t index{ indices[static_cast<size_t>(triangle.second) * 3 + v] };
+				if (remap[index] == UINT32_MAX)
+				{
+					remap[index] = static_cast<uint32_t>(mesh.positions.size());
+					mesh.positions.push_back(positions[index]);
+				}
+				mesh.indices.push_back(remap[index]);
+			}
+		}
+		return mesh;
+	}
+
+	OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+	{
+		m_tilesX	= std::max((width + TILE_WIDTH - 1) / TILE_WIDTH, 1u);
+		m_tilesY	= std::max((height + TILE_HEIGHT - 1) / TILE_HEIGHT, 1u);
+		m_width		= m_tilesX * TILE_WIDTH;
+		m_height	= m_tilesY * TILE_HEIGHT;
+
+		m_depth.resize(static_cast<size_t>(m_width) * m_height, 1.0f);
+		m_tileMaxDepth.resize(static_cast<size_t>(m_tilesX) * m_tilesY, 1.0f);
+		m_bins.resize(m_tileMaxDepth.size());
+	}
+
+	void OcclusionBuffer::begin(const glm::mat4& viewProjection)
+	{
+		m_viewProjection = viewProjection;
+		std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+		std::fill(m_tileMaxDepth.begin(), m_tileMaxDepth.end(), 1.0f);
+
+		m_triangles.clear();
+		for (std::vector<uint32_t>& bin : m_bins)
+		{
+			bin.clear();
+		}
+	}
+
+	void OcclusionBuffer::addOccluder(const OccluderMesh& mesh, const glm::mat4& transform)
+	{
+		const glm::mat4 modelViewProjection{ m_viewProjection * transform };
+		const float		width				{ static_cast<float>(m_width) };
+		const float		height				{ static_cast<float>(m_height) };
+
+		m_clipPositions.resize(mesh.positions.size());
+		for (size_t i = 0; i < mesh.positions.size(); i++)
+		{
+			m_clipPositions[i] = modelViewProjection * glm::vec4(mesh.positions[i], 1.0f);
+		}
+
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			glm::vec3 screen[3]{};
+			bool clipped{ false };
+			for (uint32_t v = 0; v < 3; v++)
+			{
+				const glm::vec4& clip{ m_clipPositions[mesh.indices[i + v]] };
+				clipped = clipped || clip.w <= MIN_CLIP_W || clip.z < 0.0f;
+				screen[v] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * width, (clip.y / clip.w * 0.5f + 0.5f) * height, clip.z / clip.w);
+			}
+			if (clipped)
+			{
+				continue;
+			}
+
+			// both faces are drawn, the winding is made positive so the edges are non negative inside
+			float area{ (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y) };
+			if (area == 0.0f)
+			{
+				continue;
+			}
+			if (area < 0.0f)
+			{
+				std::swap(screen[1], screen[2]);
+				area = -area;
+			}
+
+			// pixels whose centers fall within the triangle's bounds, a superset of the covered ones
+			const float minX{ std::ceil(std::min({ screen[0].x, screen[1].x, screen[2].x }) - 0.5f) };
+			const float minY{ std::ceil(std::min({ screen[0].y, screen[1].y, screen[2].y }) - 0.5f) };
+			const float maxX{ std::floor(std::max({ screen[0].x, screen[1].x, screen[2].x }) - 0.5f) };
+			const float maxY{ std::floor(std::max({ screen[0].y, screen[1].y, screen[2].y }) - 0.5f) };
+			const float minDepth{ std::min({ screen[0].z, screen[1].z, screen[2].z }) };
+			if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height || minX > maxX || minY > maxY || minDepth >= 1.0f)
+			{
+				continue;
+			}
+
+			Triangle triangle{};
+			for (uint32_t edge = 0; edge < 3; edge++)
+			{
+				const glm::vec3& from	{ screen[edge] };
+				const glm::vec3& to		{ screen[(edge + 1) % 3] };
+				triangle.edgeA[edge]	= from.y - to.y;
+				triangle.edgeB[edge]	= to.x - from.x;
+				triangle.edgeC[edge]	= -(triangle.edgeA[edge] * from.x + triangle.edgeB[edge] * from.y);
+
+				// tested at the pixel's corner farthest outside the edge, half a pixel from the center on
+				// both axes, so only pixels the triangle covers entirely pass
+				triangle.edgeC[edge]	-= 0.5f * (std::abs(triangle.edgeA[edge]) + std::abs(triangle.edgeB[edge]));
+			}
+
+			// likewise the depth is the farthest of the plane over the pixel
+			const glm::vec3 side1{ screen[1] - screen[0] };
+			const glm::vec3 side2{ screen[2] - screen[0] };
+			triangle.depthA		= (side1.z * side2.y - side2.z * side1.y) / area;
+			triangle.depthB		= (side2.z * side1.x - side1.z * side2.x) / area;
+			triangle.depthC		= screen[0].z - triangle.depthA * screen[0].x - triangle.depthB * screen[0].y
+				+ 0.5f * (std::abs(triangle.depthA) + std::abs(triangle.depthB));
+			triangle.minDepth	= minDepth;
+			triangle.maxDepth	= std::max({ screen[0].z, screen[1].z, screen[2].z });
+			triangle.minX		= static_cast<uint32_t>(std::max(minX, 0.0f));
+			triangle.minY		= static_cast<uint32_t>(std::max(minY, 0.0f));
+			triangle.maxX		= static_cast<uint32_t>(std::min(maxX, width - 1.0f));
+			triangle.maxY		= static_cast<uint32_t>(std::min(maxY, height - 1.0f));
+
+			const uint32_t index{ static_cast<uint32_t>(m_triangles.size()) };
+			m_triangles.push_back(triangle);
+
+			for (uint32_t tileY = triangle.minY / TILE_HEIGHT; tileY <= triangle.maxY / TILE_HEIGHT; tileY++)
+			{
+				for (uint32_t tileX = triangle.minX / TILE_WIDTH; tileX <= triangle.maxX / TILE_WIDTH; tileX++)
+				{
+					m_bins[static_cast<size_t>(tileY) * m_tilesX + tileX].push_back(index);
+				}
+			}
+		}
+	}
+
+	void OcclusionBuffer::rasterize(WorkerPool* workerPool)
+	{
+		const uint32_t tileCount{ static_cast<uint32_t>(m_bins.size()) };
+		if (workerPool && workerPool->getThreadCount() > 1)
+		{
+			workerPool->run(tileCount, [this](uint32_t tile) { rasterizeTile(tile); });
+			return;
+		}
+
+		for (uint32_t tile = 0; tile < tileCount; tile++)
+		{
+			rasterizeTile(tile);
+		}
+	}
+
+	bool OcclusionBuffer::isOccluded(const glm::vec4& sphere) const
+	{
+		glm::vec2	minimum	{ std::numeric_limits<float>::max() };
+		glm::vec2	maximum	{ std::numeric_limits<float>::lowest() };
+		float		nearest	{ std::numeric_limits<float>::max() };
+
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			const glm::vec3 corner{
+				sphere.x + ((i & 1) ? sphere.w : -sphere.w),
+				sphere.y + ((i & 2) ? sphere.w : -sphere.w),
+				sphere.z + ((i & 4) ? sphere.w : -sphere.w) };
+			const glm::vec4 clip{ m_viewProjection * glm::vec4(corner, 1.0f) };
+
+			// crossing the camera plane projects nowhere sensible, keep it
+			if (clip.w <= MIN_CLIP_W)
+			{
+				return false;
+			}
+			minimum = glm::min(minimum, glm::vec2(clip.x, clip.y) / clip.w);
+			maximum = glm::max(maximum, glm::vec2(clip.x, clip.y) / clip.w);
+			nearest = std::min(nearest, clip.z / clip.w);
+		}
+
+		// the rectangle in pixels, anything off screen is left to frustum culling
+		const glm::vec2 size	{ static_cast<float>(m_width), static_cast<float>(m_height) };
+		const glm::vec2 first	{ (minimum * 0.5f + 0.5f) * size };
+		const glm::vec2 last	{ (maximum * 0.5f + 0.5f) * size };
+		if (last.x < 0.0f || last.y < 0.0f || first.x >= size.x || first.y >= size.y)
+		{
+			return false;
+		}
+
+		const uint32_t minX{ static_cast<uint32_t>(std::max(first.x, 0.0f)) };
+		const uint32_t minY{ static_cast<uint32_t>(std::max(first.y, 0.0f)) };
+		const uint32_t maxX{ static_cast<uint32_t>(std::min(last.x, size.x - 1.0f)) };
+		const uint32_t maxY{ static_cast<uint32_t>(std::min(last.y, size.y - 1.0f)) };
+
+		for (uint32_t tileY = minY / TILE_HEIGHT; tileY <= maxY / TILE_HEIGHT; tileY++)
+		{
+			for (uint32_t tileX = minX / TILE_WIDTH; tileX <= maxX / TILE_WIDTH; tileX++)
+			{
+				// everything drawn in the tile is nearer
+				if (nearest > m_tileMaxDepth[static_cast<size_t>(tileY) * m_tilesX + tileX])
+				{
+					continue;
+				}
+
+				const uint32_t x0{ std::max(minX, tileX * TILE_WIDTH) };
+				const uint32_t x1{ std::min(maxX, tileX * TILE_WIDTH + TILE_WIDTH - 1) };
+				const uint32_t y0{ std::max(minY, tileY * TILE_HEIGHT) };
+				const uint32_t y1{ std::min(maxY, tileY * TILE_HEIGHT + TILE_HEIGHT - 1) };
+				for (uint32_t y = y0; y <= y1; y++)
+				{
+					for (uint32_t x = x0; x <= x1; x++)
+					{
+						if (getDepth(x, y) >= nearest)
+						{
+							return false;
+						}
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void OcclusionBuffer::rasterizeTile(uint32_t tile)
+	{
+		const uint32_t x0{ tile % m_tilesX * TILE_WIDTH };
+		const uint32_t y0{ tile / m_tilesX * TILE_HEIGHT };
+		const uint32_t x1{ x0 + TILE_WIDTH - 1 };
+		const uint32_t y1{ y0 + TILE_HEIGHT - 1 };
+
+#if defined(ASH_X86)
+		const bool sse2{ getCpuFeatures().sse2 };
+#endif
+
+		for (uint32_t index : m_bins[tile])
+		{
+			const Triangle& triangle{ m_triangles[index] };
+			const uint32_t	first	{ std::max(triangle.minX, x0) };
+			const uint32_t	last	{ std::min(triangle.maxX, x1) };
+
+			Span span{};
+			std::copy(std::begin(triangle.edgeA), std::end(triangle.edgeA), span.edgeA);
+			span.depthA		= triangle.depthA;
+			span.minDepth	= triangle.minDepth;
+			span.maxDepth	= triangle.maxDepth;
+
+			for (uint32_t y = std::max(triangle.minY, y0); y <= std::min(triangle.maxY, y1); y++)
+			{
+				// the row terms are shared by both paths, so they agree on every pixel
+				const float center{ static_cast<float>(y) + 0.5f };
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					span.edgeRow[i] = triangle.edgeB[i] * center + triangle.edgeC[i];
+				}
+				span.depthRow = triangle.depthB * center + triangle.depthC;
+
+				float* row{ &m_depth[static_cast<size_t>(y) * m_width] };
+#if defined(ASH_X86)
+				if (sse2)
+				{
+					rasterizeSpanSse2(span, row, first, last);
+					continue;
+				}
+#endif
+				rasterizeSpanScalar(span, row, first, last);
+			}
+		}
+
+		float farthest{ 0.0f };
+		for (uint32_t y = y0; y <= y1; y++)
+		{
+			for (uint32_t x = x0; x <= x1; x++)
+			{
+				farthest = std::max(farthest, getDepth(x, y));
+			}
+		}
+		m_tileMaxDepth[tile] = farthest;
+	}
+}
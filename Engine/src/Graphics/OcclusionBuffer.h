@@ -0,0 +1,164 @@
+/**
+ * Software rasterized depth buffer for occlusion culling on the CPU
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Utils/WorkerPool.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Triangles drawn into the occlusion buffer in place of a model's geometry
+	 */
+	struct OccluderMesh
+	{
+		std::vector<glm::vec3>	positions	{};
+		std::vector<uint32_t>	indices		{};
+
+		uint32_t getTriangleCount() const { return static_cast<uint32_t>(indices.size() / 3); }
+
+		bool empty() const { return indices.empty(); }
+	};
+
+	/**
+	 * Returns the largest maxTriangles of the triangles with only the vertices they use. The result
+	 * is part of the original surface, so it never hides anything the full mesh wouldn't. Degenerate
+	 * triangles are dropped, ties are broken by order so the result only depends on the input
+	 */
+	OccluderMesh simplifyOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t maxTriangles);
+
+	/**
+	 * Software rasterized depth buffer for occlusion culling on the CPU.
+	 * Each frame a few occluders are drawn into a small depth buffer, keeping the nearest depth
+	 * of every pixel, and bounding spheres are tested against it before any command is recorded.
+	 * addOccluder transforms and bins the triangles into tiles in submission order, rasterize then
+	 * fills the tiles in parallel, each tile on a single thread, 4 pixels at a time with SSE2.
+	 * The SSE2 and scalar paths compute every pixel with the same operations, without fused multiply
+	 * adds, so the buffer is the same whatever the CPU and the number of threads.
+	 * Rasterization is conservative: a pixel is only written when a triangle covers all of it, with
+	 * the farthest depth of the triangle over the pixel. Triangles crossing the near plane are
+	 * dropped. So the buffer never hides more than the occluders do
+	 */
+	class OcclusionBuffer
+	{
+	public:
+		/**
+		 * Pixels of a tile, the width is a multiple of the 4 pixels rasterized at once
+		 */
+		static constexpr uint32_t TILE_WIDTH{ 32 };
+
+		static constexpr uint32_t TILE_HEIGHT{ 16 };
+
+		/**
+		 * @param width and height of the buffer in pixels, rounded up to whole tiles
+		 */
+		OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+		/**
+		 * Clears the buffer to the far plane and drops the binned triangles
+		 * @param viewProjection camera projection times view, depth is zero to one
+		 */
+		void begin(const glm::mat4& viewProjection);
+
+		/**
+		 * Transforms the occluder's triangles to the screen and bins them into the tiles they touch
+		 * @param transform places the occluder in the world
+		 */
+		void addOccluder(const OccluderMesh& mesh, const glm::mat4& transform);
+
+		/**
+		 * Draws the binned triangles, spreading the tiles over the pool's threads when given one
+		 */
+		void rasterize(WorkerPool* workerPool = nullptr);
+
+		/**
+		 * Whether the box around the world space sphere, center xyz and radius w, is behind the
+		 * occluders over all the pixels it covers. Spheres reaching behind the camera never are
+		 */
+		bool isOccluded(const glm::vec4& sphere) const;
+
+		/**
+		 * Nearest depth drawn at a pixel, 1 where nothing was
+		 */
+		float getDepth(uint32_t x, uint32_t y) const { return m_depth[static_cast<size_t>(y) * m_width + x]; }
+
+		uint32_t getWidth() const { return m_width; }
+
+		uint32_t getHeight() const { return m_height; }
+
+		/**
+		 * Number of triangles binned since begin
+		 */
+		uint32_t getTriangleCount() const { return static_cast<uint32_t>(m_triangles.size()); }
+
+	private:
+
+		/**
+		 * Edge functions and depth plane of a screen triangle, each evaluates to a * x + b * y + c at a
+		 * pixel center. The edges are offset to be non negative only when the whole pixel is inside,
+		 * and the depth to be the farthest of the triangle's plane over the pixel
+		 */
+		struct Triangle
+		{
+			float		edgeA[3]	{};
+			float		edgeB[3]	{};
+			float		edgeC[3]	{};
+			float		depthA		{ 0.0f };
+			float		depthB		{ 0.0f };
+			float		depthC		{ 0.0f };
+			float		minDepth	{ 0.0f };		// depth is clamped to the vertices' range
+			float		maxDepth	{ 0.0f };
+			uint32_t	minX		{ 0 };			// pixels whose centers may be covered, inclusive
+			uint32_t	minY		{ 0 };
+			uint32_t	maxX		{ 0 };
+			uint32_t	maxY		{ 0 };
+		};
+
+		uint32_t m_width{ 0 };
+
+		uint32_t m_height{ 0 };
+
+		uint32_t m_tilesX{ 0 };
+
+		uint32_t m_tilesY{ 0 };
+
+		glm::mat4 m_viewProjection{ 1.0f };
+
+		/**
+		 * Nearest depth of every pixel, row by row
+		 */
+		std::vector<float> m_depth{};
+
+		/**
+		 * Farthest depth of every tile, lets isOccluded skip the pixels of tiles entirely in front
+		 */
+		std::vector<float> m_tileMaxDepth{};
+
+		std::vector<Triangle> m_triangles{};
+
+		/**
+		 * Triangles touching every tile, in submission order
+		 */
+		std::vector<std::vector<uint32_t>> m_bins{};
+
+		/**
+		 * Scratch space of addOccluder
+		 */
+		std::vector<glm::vec4> m_clipPositions{};
+
+		/**
+		 * Draws the tile's triangles and updates its farthest depth
+		 */
+		void rasterizeTile(uint32_t tile);
+	};
+}
@@ -0,0 +1,328 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "RenderQueue.h"
+#include "Vulkan/PushConstantData.hpp"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+
+namespace ash
+{
+	namespace
+	{
+		/**
+		 * Push constant stages of the pipeline layout
+		 */
+		constexpr VkShaderStageFlags PUSH_STAGES{ VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+
+		constexpr uint64_t mask(uint32_t bits)
+		{
+			return (uint64_t{ 1 } << bits) - 1;
+		}
+
+		/**
+		 * Positive floats compare like their bit patterns, keep the exponent and the top of the mantissa
+		 */
+		uint64_t quantizeDepth(float depth)
+		{
+			uint32_t bits{};
+			depth = depth > 0.0f ? depth : 0.0f;
+			memcpy(&bits, &depth, sizeof(bits));
+			return (bits >> (31 - RenderQueue::DEPTH_BITS)) & mask(RenderQueue::DEPTH_BITS);
+		}
+
+		/**
+		 * Whether two draws only differ in their transform
+		 */
+		bool isSameDraw(const DrawCommand& a, const DrawCommand& b)
+		{
+			return a.textureSet == b.textureSet && a.materialIndex == b.materialIndex && a.jointOffset == b.jointOffset &&
+				a.indexCount == b.indexCount && a.firstIndex == b.firstIndex && a.vertexOffset == b.vertexOffset;
+		}
+	}
+
+	void RenderQueue::begin(const glm::mat4& view, bool instancing)
+	{
+		m_view			= view;
+		m_instancing	= instancing;
+		m_transforms.clear();
+		m_commands.clear();
+		m_entries.clear();
+		m_batches.clear();
+		m_depthOrder.clear();
+		m_instances.clear();
+		m_stats.culledDraws = 0;
+	}
+
+	uint32_t RenderQueue::addTransform(const glm::mat4& transform)
+	{
+		m_transforms.push_back(transform);
+		return static_cast<uint32_t>(m_transforms.size() - 1);
+	}
+
+	void RenderQueue::add(const DrawCommand& command, const glm::vec3& position, uint32_t pipeline)
+	{
+		// without bindless the texture set is the material state, 0 is left for draws that bind none
+		uint64_t material{ command.materialIndex };
+		if (command.textureSet)
+		{
+			auto found{ m_textureSetIds.find(command.textureSet) };
+			if (found == m_textureSetIds.end())
+			{
+				found = m_textureSetIds.emplace(command.textureSet, static_cast<uint32_t>(m_textureSetIds.size() + 1)).first;
+			}
+			material = found->second;
+		}
+
+		glm::vec3 viewPosition{ m_view * glm::vec4{ position, 1.0f } };
+
+		uint64_t key{ (uint64_t{ pipeline } & mask(PIPELINE_BITS)) << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS) };
+		key |= (material & mask(MATERIAL_BITS)) << (MESH_BITS + DEPTH_BITS);
+		key |= (uint64_t{ command.firstIndex } & mask(MESH_BITS)) << DEPTH_BITS;
+		key |= quantizeDepth(glm::length(viewPosition));
+
+		m_entries.push_back(SortEntry{ key, static_cast<uint32_t>(m_commands.size()) });
+		m_commands.push_back(command);
+	}
+
+	void RenderQueue::cull(const FrustumPlanes& planes)
+	{
+		m_spheres.clear();
+		for (const SortEntry& entry : m_entries)
+		{
+			const DrawCommand& command{ m_commands[entry.index] };
+			m_spheres.add(transformSphere(m_transforms[command.transformIndex], command.bounds));
+		}
+		cullSpheres(planes, m_spheres, m_visible);
+
+		// commands stay where they are, only their entries are dropped
+		size_t kept{ 0 };
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			if (m_visible[i])
+			{
+				m_entries[kept++] = m_entries[i];
+			}
+		}
+		m_stats.culledDraws += static_cast<uint32_t>(m_entries.size() - kept);
+		m_entries.resize(kept);
+	}
+
+	void RenderQueue::sort()
+	{
+		m_stats.drawCount	= static_cast<uint32_t>(m_entries.size());
+		m_stats.unsorted	= countBinds();
+
+		radixSort();
+		buildBatches();
+
+		m_stats.sorted		= countBinds();
+		m_stats.drawCalls	= size();
+	}
+
+	void RenderQueue::radixSort()
+	{
+		if (m_entries.size() < 2)
+		{
+			return;
+		}
+
+		// least significant digit first, 8 bits per pass, all histograms are built in one sweep
+		constexpr uint32_t PASSES{ 8 };
+		std::array<std::array<uint32_t, 256>, PASSES> histograms{};
+		for (const SortEntry& entry : m_entries)
+		{
+			for (uint32_t pass = 0; pass < PASSES; pass++)
+			{
+				histograms[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+			}
+		}
+
+		m_scratch.resize(m_entries.size());
+		for (uint32_t pass = 0; pass < PASSES; pass++)
+		{
+			std::array<uint32_t, 256>& histogram{ histograms[pass] };
+
+			// every key has the same digit, the pass wouldn't move anything
+			if (histogram[(m_entries[0].key >> (pass * 8)) & 0xFF] == m_entries.size())
+			{
+				continue;
+			}
+
+			uint32_t offset{ 0 };
+			for (uint32_t& count : histogram)
+			{
+				uint32_t bucketSize{ count };
+				count	= offset;
+				offset	+= bucketSize;
+			}
+
+			for (const SortEntry& entry : m_entries)
+			{
+				m_scratch[histogram[(entry.key >> (pass * 8)) & 0xFF]++] = entry;
+			}
+			m_entries.swap(m_scratch);
+		}
+	}
+
+	void RenderQueue::buildBatches()
+	{
+		constexpr uint32_t PIPELINE_SHIFT{ MATERIAL_BITS + MESH_BITS + DEPTH_BITS };
+
+		for (uint32_t i = 0; i < m_entries.size(); i++)
+		{
+			const DrawCommand& command{ m_commands[m_entries[i].index] };
+
+			if (!m_instancing)
+			{
+				m_batches.push_back(Batch{ i, 1, 0 });
+				continue;
+			}
+
+			// the key puts draws of the same primitive next to each other, front to back
+			if (!m_batches.empty())
+			{
+				Batch&				batch	{ m_batches.back() };
+				const SortEntry&	entry	{ m_entries[batch.entry] };
+				if ((entry.key >> PIPELINE_SHIFT) == (m_entries[i].key >> PIPELINE_SHIFT) && isSameDraw(m_commands[entry.index], command))
+				{
+					batch.instanceCount++;
+					m_instances.push_back(m_transforms[command.transformIndex]);
+					continue;
+				}
+			}
+			m_batches.push_back(Batch{ i, 1, static_cast<uint32_t>(m_instances.size()) });
+			m_instances.push_back(m_transforms[command.transformIndex]);
+		}
+	}
+
+	DrawCall RenderQueue::getDrawCall(uint32_t index) const
+	{
+		const Batch& batch{ m_batches[index] };
+		return DrawCall{ &m_commands[m_entries[batch.entry].index], batch.instanceCount, batch.firstInstance };
+	}
+
+	void RenderQueue::record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t first, uint32_t last, uint32_t instanceBase) const
+	{
+		VkDescriptorSet	boundSet		{};
+		uint32_t		transformIndex	{ UINT32_MAX };
+		uint32_t		materialIndex	{ UINT32_MAX };
+		int32_t			jointOffset		{ INT32_MIN };
+
+		for (uint32_t i = first; i < last; i++)
+		{
+			const Batch&		batch	{ m_batches[i] };
+			const DrawCommand&	command	{ m_commands[m_entries[batch.entry].index] };
+
+			if (command.textureSet && command.textureSet != boundSet)
+			{
+				boundSet = command.textureSet;
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &boundSet, 0, nullptr);
+			}
+			if (!m_instancing && command.transformIndex != transformIndex)
+			{
+				transformIndex = command.transformIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, PUSH_STAGES,
+					offsetof(PushConstantData, transform), sizeof(glm::mat4), &m_transforms[transformIndex]);
+			}
+			if (command.materialIndex != materialIndex)
+			{
+				materialIndex = command.materialIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, PUSH_STAGES,
+					offsetof(PushConstantData, materialIndex), sizeof(uint32_t), &materialIndex);
+			}
+			if (command.jointOffset != jointOffset)
+			{
+				jointOffset = command.jointOffset;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, PUSH_STAGES,
+					offsetof(PushConstantData, jointOffset), sizeof(int32_t), &jointOffset);
+			}
+
+			vkCmdDrawIndexed(commandBuffer, command.indexCount, batch.instanceCount, command.firstIndex, command.vertexOffset,
+				instanceBase + batch.firstInstance);
+		}
+	}
+
+	void RenderQueue::sortFrontToBack()
+	{
+		// a batch's first entry is its nearest, the keys of a group run front to back
+		m_depthOrder.resize(m_batches.size());
+		for (uint32_t i = 0; i < m_depthOrder.size(); i++)
+		{
+			m_depthOrder[i] = i;
+		}
+		std::stable_sort(m_depthOrder.begin(), m_depthOrder.end(), [this](uint32_t a, uint32_t b)
+			{
+				return (m_entries[m_batches[a].entry].key & mask(DEPTH_BITS)) < (m_entries[m_batches[b].entry].key & mask(DEPTH_BITS));
+			});
+	}
+
+	void RenderQueue::recordDepth(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t first, uint32_t last, uint32_t instanceBase) const
+	{
+		uint32_t	transformIndex	{ UINT32_MAX };
+		int32_t		jointOffset		{ INT32_MIN };
+
+		for (uint32_t i = first; i < last; i++)
+		{
+			const Batch&		batch	{ m_batches[m_depthOrder[i]] };
+			const DrawCommand&	command	{ m_commands[m_entries[batch.entry].index] };
+
+			if (!m_instancing && command.transformIndex != transformIndex)
+			{
+				transformIndex = command.transformIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, PUSH_STAGES,
+					offsetof(PushConstantData, transform), sizeof(glm::mat4), &m_transforms[transformIndex]);
+			}
+			if (command.jointOffset != jointOffset)
+			{
+				jointOffset = command.jointOffset;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, PUSH_STAGES,
+					offsetof(PushConstantData, jointOffset), sizeof(int32_t), &jointOffset);
+			}
+
+			vkCmdDrawIndexed(commandBuffer, command.indexCount, batch.instanceCount, command.firstIndex, command.vertexOffset,
+				instanceBase + batch.firstInstance);
+		}
+	}
+
+	BindCounts RenderQueue::countBinds() const
+	{
+		// mirrors the state tracking of record
+		BindCounts		counts			{};
+		VkDescriptorSet	boundSet		{};
+		uint32_t		transformIndex	{ UINT32_MAX };
+		uint32_t		materialIndex	{ UINT32_MAX };
+		int32_t			jointOffset		{ INT32_MIN };
+
+		for (const SortEntry& entry : m_entries)
+		{
+			const DrawCommand& command{ m_commands[entry.index] };
+
+			if (command.textureSet && command.textureSet != boundSet)
+			{
+				boundSet = command.textureSet;
+				counts.descriptorSets++;
+			}
+			if (!m_instancing && command.transformIndex != transformIndex)
+			{
+				transformIndex = command.transformIndex;
+				counts.pushConstants++;
+			}
+			if (command.materialIndex != materialIndex)
+			{
+				materialIndex = command.materialIndex;
+				counts.pushConstants++;
+			}
+			if (command.jointOffset != jointOffset)
+			{
+				jointOffset = command.jointOffset;
+				counts.pushConstants++;
+			}
+		}
+		return counts;
+	}
+}
@@ -0,0 +1,252 @@
+/**
+ * Collects the frame's draws and sorts them to minimize state changes
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "FrustumCulling.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Everything needed to record a single indexed draw
+	 */
+	struct DrawCommand
+	{
+		uint32_t		transformIndex	{ 0 };		// returned by RenderQueue::addTransform
+		VkDescriptorSet	textureSet		{};			// set 1 without bindless, null with bindless
+		uint32_t		materialIndex	{ 0 };		// bindless material, unused otherwise
+		int32_t			jointOffset		{ -1 };
+		uint32_t		indexCount		{ 0 };
+		uint32_t		firstIndex		{ 0 };		// absolute in the geometry heap
+		int32_t			vertexOffset	{ 0 };
+		glm::vec4		bounds			{ 0.0f, 0.0f, 0.0f, -1.0f };	// sphere in the space of the transform, never culled with a negative radius
+	};
+
+	/**
+	 * A draw call of the sorted queue, draws of the same primitive when instancing
+	 */
+	struct DrawCall
+	{
+		const DrawCommand*	command			{};
+		uint32_t			instanceCount	{ 1 };
+		uint32_t			firstInstance	{ 0 };		// index into RenderQueue::getInstances
+	};
+
+	/**
+	 * Descriptor set binds and push constant updates needed to record a queue
+	 */
+	struct BindCounts
+	{
+		uint32_t descriptorSets	{ 0 };
+		uint32_t pushConstants	{ 0 };
+	};
+
+	/**
+	 * Reported by RenderQueue::getStats for the last sorted queue
+	 */
+	struct RenderQueueStats
+	{
+		uint32_t	drawCount	{ 0 };
+		uint32_t	drawCalls	{ 0 };		// after draws of the same primitive were merged into instanced draws
+		uint32_t	culledDraws	{ 0 };		// removed by cull since begin, not counted in drawCount
+		BindCounts	unsorted	{};		// in the order the draws were added
+		BindCounts	sorted		{};
+	};
+
+	/**
+	 * Collects the frame's draws and sorts them to minimize state changes.
+	 * Every draw gets a 64 bit key, from the most significant bits down: pipeline, material
+	 * or texture, mesh and view depth, so a radix sort groups draws sharing state and orders
+	 * each group front to back. Recording only binds and pushes what changed between draws.
+	 * With instancing, neighbouring draws of the same primitive become a single instanced draw
+	 * whose transforms are read from getInstances by gl_InstanceIndex instead of pushed
+	 */
+	class RenderQueue
+	{
+	public:
+		static constexpr uint32_t PIPELINE_BITS	{ 4 };
+		static constexpr uint32_t MATERIAL_BITS	{ 16 };
+		static constexpr uint32_t MESH_BITS		{ 22 };
+		static constexpr uint32_t DEPTH_BITS	{ 22 };
+
+		/**
+		 * Clears the queue, depth is measured in view space of the view matrix
+		 * @param instancing merge draws of the same primitive into instanced draws
+		 */
+		void begin(const glm::mat4& view, bool instancing = false);
+
+		/**
+		 * Stores a model matrix draws can refer to
+		 * @return index for DrawCommand::transformIndex
+		 */
+		uint32_t addTransform(const glm::mat4& transform);
+
+		/**
+		 * Adds a draw, position in world space is used for depth sorting
+		 */
+		void add(const DrawCommand& command, const glm::vec3& position, uint32_t pipeline = 0);
+
+		/**
+		 * Removes the draws whose bounding sphere is outside the frustum, call before sort
+		 * @param planes world space frustum planes, see Camera::getFrustumPlanes
+		 */
+		void cull(const FrustumPlanes& planes);
+
+		/**
+		 * Radix sorts the draws by key, builds the draw calls and updates the stats
+		 */
+		void sort();
+
+		/**
+		 * Number of draw calls after sort
+		 */
+		uint32_t size() const { return static_cast<uint32_t>(m_batches.size()); }
+
+		/**
+		 * Records the draw calls [first, last), the pipeline, set 0 and the geometry heap must
+		 * already be bound. Safe to call from several threads on disjoint ranges
+		 * @param instanceBase where getInstances was copied to, added to every draw's first instance
+		 */
+		void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t first, uint32_t last, uint32_t instanceBase = 0) const;
+
+		/**
+		 * Orders the sorted draw calls front to back by their nearest draw for recordDepth, call after sort
+		 */
+		void sortFrontToBack();
+
+		/**
+		 * Records the draw calls [first, last) of the front to back order for a depth prepass, only
+		 * the transforms and joints are pushed. Same requirements as record
+		 */
+		void recordDepth(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t first, uint32_t last, uint32_t instanceBase = 0) const;
+
+		/**
+		 * Returns the draw call at index of the sorted queue, for recording it elsewhere
+		 */
+		DrawCall getDrawCall(uint32_t index) const;
+
+		/**
+		 * Transforms of every instance in draw order, empty without instancing
+		 */
+		const std::vector<glm::mat4>& getInstances() const { return m_instances; }
+
+		/**
+		 * Bind counts of the last sort, before and after sorting
+		 */
+		const RenderQueueStats& getStats() const { return m_stats; }
+
+	private:
+
+		/**
+		 * Key of a draw and its index in m_commands
+		 */
+		struct SortEntry
+		{
+			uint64_t key	{ 0 };
+			uint32_t index	{ 0 };
+		};
+
+		/**
+		 * Sorted draws recorded with a single draw call
+		 */
+		struct Batch
+		{
+			uint32_t entry			{ 0 };		// first entry, the others only differ in transform
+			uint32_t instanceCount	{ 1 };
+			uint32_t firstInstance	{ 0 };		// index into m_instances
+		};
+
+		/**
+		 * View matrix of the current queue
+		 */
+		glm::mat4 m_view{ 1.f };
+
+		/**
+		 * Whether draws of the same primitive are merged
+		 */
+		bool m_instancing{ false };
+
+		/**
+		 * Model matrices referenced by the draws
+		 */
+		std::vector<glm::mat4> m_transforms{};
+
+		/**
+		 * Draws in the order they were added
+		 */
+		std::vector<DrawCommand> m_commands{};
+
+		/**
+		 * Sort keys, in draw order after sort
+		 */
+		std::vector<SortEntry> m_entries{};
+
+		/**
+		 * Ping pong buffer of the radix sort
+		 */
+		std::vector<SortEntry> m_scratch{};
+
+		/**
+		 * Draw calls in draw order after sort
+		 */
+		std::vector<Batch> m_batches{};
+
+		/**
+		 * Indices into m_batches front to back, built by sortFrontToBack
+		 */
+		std::vector<uint32_t> m_depthOrder{};
+
+		/**
+		 * Transforms of the batches' instances
+		 */
+		std::vector<glm::mat4> m_instances{};
+
+		/**
+		 * World space bounding spheres of the entries being culled
+		 */
+		BoundingSpheres m_spheres{};
+
+		/**
+		 * Result of the last cull, one per entry
+		 */
+		std::vector<uint8_t> m_visible{};
+
+		/**
+		 * Small ids for texture descriptor sets, kept across frames so keys stay stable
+		 */
+		std::unordered_map<VkDescriptorSet, uint32_t> m_textureSetIds{};
+
+		/**
+		 * Stats of the last sort
+		 */
+		RenderQueueStats m_stats{};
+
+		/**
+		 * Counts the binds and pushes recording the entries in their current order takes
+		 */
+		BindCounts countBinds() const;
+
+		/**
+		 * Least significant digit radix sort of m_entries by key
+		 */
+		void radixSort();
+
+		/**
+		 * Groups the sorted entries into draw calls
+		 */
+		void buildBatches();
+	};
+}
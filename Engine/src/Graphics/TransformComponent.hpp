@@ -12,7 +12,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/euler_angles.hpp>
 
+#include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 namespace ash
 {
@@ -23,11 +25,17 @@ namespace ash
 	{
 	public:
 
-		void setTranslation(glm::vec3 translation) { m_translation = translation; }
+		void setTranslation(glm::vec3 translation) { m_translation = translation; changed(); }
 
-		void setScale(glm::vec3 scale) { m_scale = scale; }
+		void setScale(glm::vec3 scale) { m_scale = scale; changed(); }
 
-		void setRotation(glm::vec3 rotation) { m_rotation = rotation; }
+		void setRotation(glm::vec3 rotation) { m_rotation = rotation; changed(); }
+
+		/**
+		 * Every setter appends ownerId to dirtyList, so whoever drains the list only visits
+		 * transforms that changed. Null stops the reports
+		 */
+		void setDirtyList(std::vector<uint64_t>* dirtyList, uint64_t ownerId) { m_dirtyList = dirtyList; m_ownerId = ownerId; }
 
 		glm::vec3 getTranslation() { return m_translation; }
 
@@ -81,5 +89,23 @@ namespace ash
 		 * Rotation of object in 3D space
 		 */
 		glm::vec3 m_rotation{};
+
+		/**
+		 * List the changes are reported to and the id they are reported with, see setDirtyList
+		 */
+		std::vector<uint64_t>* m_dirtyList{};
+
+		uint64_t m_ownerId{ 0 };
+
+		/**
+		 * Called by every setter
+		 */
+		void changed()
+		{
+			if (m_dirtyList)
+			{
+				m_dirtyList->push_back(m_ownerId);
+			}
+		}
 	};
 }
\ No newline at end of file
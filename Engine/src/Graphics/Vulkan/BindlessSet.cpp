@@ -0,0 +1,198 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/BindlessSet.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace ash
+{
+	BindlessSet::BindlessSet(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, VkSampler sampler) :
+		m_logicalDevice{ logicalDevice }, m_sampler{ sampler }
+	{
+		const VkPhysicalDeviceDescriptorIndexingProperties& limits{ physicalDevice->getDescriptorIndexingProperties() };
+		m_maxTextures = std::min({ 4096u,
+			limits.maxDescriptorSetUpdateAfterBindSampledImages,
+			limits.maxPerStageDescriptorUpdateAfterBindSampledImages });
+
+		m_materialBuffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			sizeof(MaterialData) * m_maxMaterials,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			logicalDevice->getHostWriteProperties(),
+			MemoryCategory::Dynamic);
+
+		createDescriptorSet();
+
+		// occupies DEFAULT_MATERIAL
+		addMaterial(MaterialData{});
+	}
+
+	BindlessSet::~BindlessSet()
+	{
+		// frees the set along with the pool
+		vkDestroyDescriptorPool(*m_logicalDevice, m_pool, nullptr);
+		vkDestroyDescriptorSetLayout(*m_logicalDevice, m_layout, nullptr);
+	}
+
+	uint32_t BindlessSet::addTexture(VkImageView imageView)
+	{
+		uint32_t index{ m_textureCount };
+		if (!m_freeTextures.empty())
+		{
+			index = m_freeTextures.back();
+			m_freeTextures.pop_back();
+		}
+		else if (m_textureCount < m_maxTextures)
+		{
+			m_textureCount++;
+		}
+		else
+		{
+			throw std::runtime_error("bindless texture array is full!");
+		}
+
+		updateTexture(index, imageView);
+
+		return index;
+	}
+
+	void BindlessSet::updateTexture(uint32_t index, VkImageView imageView)
+	{
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout	= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView		= imageView;
+		imageInfo.sampler		= m_sampler;
+
+		// update after bind, the set may be in use by frames in flight
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType			= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet			= m_descriptorSet;
+		descriptorWrite.dstBinding		= 0;
+		descriptorWrite.dstArrayElement	= index;
+		descriptorWrite.descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount	= 1;
+		descriptorWrite.pImageInfo		= &imageInfo;
+
+		vkUpdateDescriptorSets(*m_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	void BindlessSet::removeTexture(uint32_t index)
+	{
+		// the descriptor is left as is, partially bound allows stale entries that are never sampled
+		m_freeTextures.push_back(index);
+	}
+
+	uint32_t BindlessSet::addMaterial(const MaterialData& material)
+	{
+		uint32_t index{ m_materialCount };
+		if (!m_freeMaterials.empty())
+		{
+			index = m_freeMaterials.back();
+			m_freeMaterials.pop_back();
+		}
+		else if (m_materialCount < m_maxMaterials)
+		{
+			m_materialCount++;
+		}
+		else
+		{
+			throw std::runtime_error("bindless material buffer is full!");
+		}
+
+		m_materialBuffer->copyTo(&material, sizeof(MaterialData), sizeof(MaterialData) * index);
+
+		return index;
+	}
+
+	void BindlessSet::removeMaterial(uint32_t index)
+	{
+		m_freeMaterials.push_back(index);
+	}
+
+	void BindlessSet::createDescriptorSet()
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding			= 0;
+		bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount	= m_maxTextures;
+		bindings[0].stageFlags		= VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[1].binding			= 1;
+		bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount	= 1;
+		bindings[1].stageFlags		= VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		// textures can be written while frames using the set are in flight, unused slots stay unwritten
+		std::array<VkDescriptorBindingFlags, 2> bindingFlags{};
+		bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+			| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+			| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		bindingFlags[1] = 0;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount	= static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags	= bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext		= &bindingFlagsInfo;
+		layoutInfo.flags		= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount	= static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings	= bindings.data();
+
+		if (vkCreateDescriptorSetLayout(*m_logicalDevice, &layoutInfo, nullptr, &m_layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create bindless descriptor set layout!");
+		}
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount	= m_maxTextures;
+		poolSizes[1].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[1].descriptorCount	= 1;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags			= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.poolSizeCount	= static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes		= poolSizes.data();
+		poolInfo.maxSets		= 1;
+
+		if (vkCreateDescriptorPool(*m_logicalDevice, &poolInfo, nullptr, &m_pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create bindless descriptor pool!");
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool		= m_pool;
+		allocInfo.descriptorSetCount	= 1;
+		allocInfo.pSetLayouts			= &m_layout;
+
+		if (vkAllocateDescriptorSets(*m_logicalDevice, &allocInfo, &m_descriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate bindless descriptor set!");
+		}
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer	= *m_materialBuffer;
+		bufferInfo.offset	= 0;
+		bufferInfo.range	= VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType			= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet			= m_descriptorSet;
+		descriptorWrite.dstBinding		= 1;
+		descriptorWrite.dstArrayElement	= 0;
+		descriptorWrite.descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.descriptorCount	= 1;
+		descriptorWrite.pBufferInfo		= &bufferInfo;
+
+		vkUpdateDescriptorSets(*m_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	}
+}
@@ -0,0 +1,146 @@
+/**
+ * Descriptor set holding every texture and material, indexed from shaders
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/PhysicalDevice.h"
+#include "Vulkan/LogicalDevice.h"
+#include "Vulkan/Buffer.h"
+#include "Vulkan/MaterialData.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Descriptor set holding every texture and material, indexed from shaders.
+	 * Binding 0 is an array of combined image samplers, binding 1 a storage buffer of MaterialData.
+	 * The set is bound once per frame, draws select their material with a push constant index.
+	 * Requires the descriptor indexing features, see PhysicalDevice::supportsBindless
+	 */
+	class BindlessSet
+	{
+	public:
+		BindlessSet(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, VkSampler sampler);
+		~BindlessSet();
+
+		/**
+		 * overide * operator for more intuitive access
+		 */
+		operator const VkDescriptorSet& () const { return m_descriptorSet; }
+
+		/**
+		 * Returns reference to the descriptor set
+		 */
+		const VkDescriptorSet& getSet() const { return m_descriptorSet; }
+
+		/**
+		 * Returns reference to the set layout, used when creating the pipeline layout
+		 */
+		const VkDescriptorSetLayout& getLayout() const { return m_layout; }
+
+		/**
+		 * Writes the image view into a free slot of the texture array
+		 * @return index of the slot, referenced by MaterialData
+		 */
+		uint32_t addTexture(VkImageView imageView);
+
+		/**
+		 * Points the slot at another image view, no frame in flight may use the slot
+		 */
+		void updateTexture(uint32_t index, VkImageView imageView);
+
+		/**
+		 * Returns the slot to the free list, the image view must outlive any frame still using it
+		 */
+		void removeTexture(uint32_t index);
+
+		/**
+		 * Copies the material into a free slot of the material buffer
+		 * @return index of the slot, passed to shaders via PushConstantData
+		 */
+		uint32_t addMaterial(const MaterialData& material);
+
+		/**
+		 * Returns the slot to the free list
+		 */
+		void removeMaterial(uint32_t index);
+
+		/**
+		 * Material slot holding a plain white material, used by primitives without a material
+		 */
+		static constexpr uint32_t DEFAULT_MATERIAL{ 0 };
+
+	private:
+
+		/**
+		 * Vulkan Logical Device, used for resource destruction
+		 */
+		const LogicalDevice* m_logicalDevice{};
+
+		/**
+		 * Sampler combined with every texture in the array
+		 */
+		VkSampler m_sampler{};
+
+		/**
+		 * Update after bind pool owning only the bindless set
+		 */
+		VkDescriptorPool m_pool{};
+
+		/**
+		 * Layout of the bindless set
+		 */
+		VkDescriptorSetLayout m_layout{};
+
+		/**
+		 * The bindless set, retrieved using *
+		 */
+		VkDescriptorSet m_descriptorSet{};
+
+		/**
+		 * Host visible storage buffer holding MaterialData for every material slot
+		 */
+		std::unique_ptr<Buffer> m_materialBuffer{};
+
+		/**
+		 * Size of the texture array, clamped to the device's update after bind limits
+		 */
+		uint32_t m_maxTextures{ 0 };
+
+		/**
+		 * Number of MaterialData slots in the material buffer
+		 */
+		uint32_t m_maxMaterials{ 4096 };
+
+		/**
+		 * Texture slots handed out so far, freed slots are reused first
+		 */
+		uint32_t m_textureCount{ 0 };
+
+		/**
+		 * Material slots handed out so far, freed slots are reused first
+		 */
+		uint32_t m_materialCount{ 0 };
+
+		/**
+		 * Texture slots returned by removeTexture
+		 */
+		std::vector<uint32_t> m_freeTextures{};
+
+		/**
+		 * Material slots returned by removeMaterial
+		 */
+		std::vector<uint32_t> m_freeMaterials{};
+
+		/**
+		 * Creates the layout, pool and set, and points binding 1 at the material buffer
+		 */
+		void createDescriptorSet();
+	};
+}
@@ -2,13 +2,15 @@
  * Copyright (C) 2021, Jesse Springborn
  */
 #include "Vulkan/Buffer.h"
+#include "Vulkan/UploadBatch.h"
 
 #include <stdexcept>
 #include <memory>
 
 namespace ash
 {
-	Buffer::Buffer(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) :
+	Buffer::Buffer(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+		MemoryCategory category) :
 		m_logicalDevice{ logicalDevice }
 	{
 		VkBufferCreateInfo bufferInfo{};
@@ -22,40 +24,23 @@ namespace ash
 			throw std::runtime_error("failed to create buffer!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(*m_logicalDevice, m_buffer, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = physicalDevice->findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(*m_logicalDevice, &allocInfo, nullptr, &m_bufferMemory) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to allocate buffer memory!");
-		}
-
-		vkBindBufferMemory(*m_logicalDevice, m_buffer, m_bufferMemory, 0);
+		m_allocation = m_logicalDevice->getAllocator().allocateBuffer(m_buffer, properties, category);
 	}
 
 	Buffer::~Buffer()
 	{
 		vkDestroyBuffer(*m_logicalDevice, m_buffer, nullptr);
-		vkFreeMemory(*m_logicalDevice, m_bufferMemory, nullptr);
+		m_logicalDevice->getAllocator().free(m_allocation);
 	}
 
-	void Buffer::copyBuffer(const Buffer* srcBuffer, VkDeviceSize size)
+	void Buffer::copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset)
 	{
-		VkCommandBuffer commandBuffer = m_logicalDevice->beginSingleTimeCommand();
-
 		VkBufferCopy copyRegion{};
-		copyRegion.srcOffset = 0;
-		copyRegion.dstOffset = 0;
+		copyRegion.srcOffset = srcOffset;
+		copyRegion.dstOffset = dstOffset;
 		copyRegion.size = size;
 
-		vkCmdCopyBuffer(commandBuffer, *srcBuffer, m_buffer, 1, &copyRegion);
-		
-		m_logicalDevice->endSingleTimeCommand(commandBuffer);
+		vkCmdCopyBuffer(commandBuffer, srcBuffer, m_buffer, 1, &copyRegion);
 	}
 
 	std::unique_ptr<Buffer> Buffer::createDeviceLocalBuffer(
@@ -65,37 +50,42 @@ namespace ash
 		const void* inData, 
 		VkBufferUsageFlagBits usage)
 	{
-		// create staging buffer for transfer operation
-		std::unique_ptr<Buffer> stagingBuffer{ std::make_unique<Buffer>(
-		logicalDevice,
-		physicalDevice,
-		bufferSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) };
+		UploadBatch batch{ logicalDevice, physicalDevice };
+		std::unique_ptr<Buffer> localBuffer{ createDeviceLocalBuffer(logicalDevice, physicalDevice, bufferSize, inData, usage, batch) };
+		batch.submit();
+		batch.wait();
 
-		// directly copy the data into device coherent memory
-		stagingBuffer->copyTo(inData, bufferSize);
+		return localBuffer;
+	}
 
-		// create the buffer that will you device local memory
+	std::unique_ptr<Buffer> Buffer::createDeviceLocalBuffer(
+		const LogicalDevice* logicalDevice,
+		const PhysicalDevice* physicalDevice,
+		VkDeviceSize bufferSize,
+		const void* inData,
+		VkBufferUsageFlags usage,
+		UploadBatch& batch)
+	{
+		// create the buffer that will use device local memory
 		std::unique_ptr<Buffer> localBuffer = std::make_unique<Buffer>(
 			logicalDevice,
 			physicalDevice,
 			bufferSize,
 			VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			logicalDevice->getDeviceLocalProperties());
 
-		// copy the data from the host coherent buffer to the device local buffer
-		localBuffer->copyBuffer(stagingBuffer.get(), bufferSize);
+		// the batch stages the data and records the copy
+		batch.copyToBuffer(*localBuffer, inData, bufferSize);
 
-		// return the smart ptr for the local buffer
-		return std::move(localBuffer);
+		return localBuffer;
 	}
 
-	void Buffer::copyTo(const void* inData, size_t size)
+	void Buffer::copyTo(const void* inData, size_t size, VkDeviceSize offset)
 	{
-		void* data;
-		vkMapMemory(*m_logicalDevice, m_bufferMemory, 0, size, 0, &data);	// 
-		memcpy(data, inData, size);
-		vkUnmapMemory(*m_logicalDevice, m_bufferMemory);
+		if (!m_allocation.mappedData)
+		{
+			throw std::runtime_error("failed to copy to buffer, memory is not host visible!");
+		}
+		memcpy(static_cast<char*>(m_allocation.mappedData) + offset, inData, size);
 	}
 }
\ No newline at end of file
@@ -14,6 +14,8 @@
 
 namespace ash
 {
+	class UploadBatch;
+
 	/**
 	 * Wrapper class for Vulkan Buffer
 	 */
@@ -21,7 +23,8 @@ namespace ash
 	{
 	public:
 		Buffer(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, 
-			VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+			VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+			MemoryCategory category = MemoryCategory::Other);
 		~Buffer();
 
 		/**
@@ -29,18 +32,25 @@ namespace ash
 		 */
 		operator const VkBuffer& () const { return m_buffer; }
 
-		const VkDeviceMemory& getBufferMemory() const { return m_bufferMemory; }
+		/**
+		 * Returns pointer to the buffer's persistently mapped memory, null unless host visible
+		 */
+		void* getMappedData() const { return m_allocation.mappedData; }
 
 		/**
-		 * Copies the data from the provided buffer into self
+		 * Records a copy of the data from the provided buffer into self
+		 * @param commandBuffer the copy is recorded into
 		 * @param buffer to copy from
 		 * @param size of the source buffer
+		 * @param offsets in bytes into the source buffer and self
 		 */
-		void copyBuffer(const Buffer* srcBuffer, VkDeviceSize size);
+		void copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize size,
+			VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
 
 		/**
 		 * Creates a buffer in device local memory for high speed access
 		 * inData is passed as a void* in order to handle all possible data types
+		 * Submits its own upload and waits for it, prefer the UploadBatch overload when creating several
 		 */
 		static std::unique_ptr<Buffer> createDeviceLocalBuffer(
 			const LogicalDevice* logicalDevice,
@@ -51,10 +61,23 @@ namespace ash
 			);
 
 		/**
-		 * Copies data into the buffer by mapping a void* to the buffer
-		 * memory, copying data to the void*, and then unmapping the memory
+		 * Creates a buffer in device local memory, the copy of inData is recorded into batch
+		 * and the buffer can't be used before the batch completes
+		 */
+		static std::unique_ptr<Buffer> createDeviceLocalBuffer(
+			const LogicalDevice* logicalDevice,
+			const PhysicalDevice* phyiscalDevice,
+			VkDeviceSize bufferSize,
+			const void* inData,
+			VkBufferUsageFlags usage,
+			UploadBatch& batch
+			);
+
+		/**
+		 * Copies data into the buffer's mapped memory, the buffer must be host visible and coherent
+		 * @param offset in bytes from the start of the buffer
 		 */
-		void copyTo(const void* inData, size_t size);
+		void copyTo(const void* inData, size_t size, VkDeviceSize offset = 0);
 
 	private:
 
@@ -69,8 +92,8 @@ namespace ash
 		VkBuffer m_buffer{};
 
 		/**
-		 * Memory used by Vulkan Buffer
+		 * Memory used by Vulkan Buffer, sub-allocated from the logical device's allocator
 		 */
-		VkDeviceMemory m_bufferMemory{};
+		MemoryAllocation m_allocation{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/ComputePipeline.h"
+#include "Vulkan/GraphicsPipeline.h"
+
+#include <stdexcept>
+
+namespace ash
+{
+	ComputePipeline::ComputePipeline(const LogicalDevice* logicalDevice, const std::vector<VkDescriptorSetLayout>& layouts,
+		uint32_t pushConstantSize, const std::string& shaderPath) :
+		m_logicalDevice{ logicalDevice }
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset		= 0;
+		pushConstantRange.size			= pushConstantSize;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount			= static_cast<uint32_t>(layouts.size());
+		pipelineLayoutInfo.pSetLayouts				= layouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount	= pushConstantSize > 0 ? 1 : 0;
+		pipelineLayoutInfo.pPushConstantRanges		= &pushConstantRange;
+
+		if (vkCreatePipelineLayout(*m_logicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create compute pipeline layout!");
+		}
+
+		std::vector<char> code{ GraphicsPipeline::readFile(shaderPath) };
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType	= VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = code.size();
+		moduleInfo.pCode	= reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(*m_logicalDevice, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create shader module!");
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType			= VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module	= shaderModule;
+		pipelineInfo.stage.pName	= "main";
+		pipelineInfo.layout			= m_pipelineLayout;
+
+		VkResult result{ vkCreateComputePipelines(*m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline) };
+
+		// the module is only needed during pipeline creation
+		vkDestroyShaderModule(*m_logicalDevice, shaderModule, nullptr);
+
+		if (result != VK_SUCCESS)
+		{
+			vkDestroyPipelineLayout(*m_logicalDevice, m_pipelineLayout, nullptr);
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+	}
+
+	ComputePipeline::~ComputePipeline()
+	{
+		vkDestroyPipeline(*m_logicalDevice, m_pipeline, nullptr);
+		vkDestroyPipelineLayout(*m_logicalDevice, m_pipelineLayout, nullptr);
+	}
+}
@@ -0,0 +1,60 @@
+/**
+ * Wrapper for Vulkan Compute Pipeline
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/LogicalDevice.h"
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Wrapper for Vulkan Compute Pipeline, a single shader and its layout
+	 */
+	class ComputePipeline
+	{
+	public:
+		/**
+		 * @param pushConstantSize size in bytes of the push constants, 0 for none
+		 */
+		ComputePipeline(const LogicalDevice* logicalDevice, const std::vector<VkDescriptorSetLayout>& layouts,
+			uint32_t pushConstantSize, const std::string& shaderPath);
+		~ComputePipeline();
+
+		ComputePipeline(const ComputePipeline&) = delete;
+		ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+		/**
+		 * overide * operator for more intuitive access
+		 */
+		operator const VkPipeline& () const { return m_pipeline; }
+
+		/**
+		 * Returns reference to the pipeline layout
+		 */
+		const VkPipelineLayout& getLayout() const { return m_pipelineLayout; }
+
+	private:
+
+		/**
+		 * Vulkan Logical Device, used for resource destruction
+		 */
+		const LogicalDevice* m_logicalDevice{};
+
+		/**
+		 * Vulkan Pipeline Layout, used during pipeline creation and when binding descriptor sets
+		 */
+		VkPipelineLayout m_pipelineLayout{};
+
+		/**
+		 * Vulkan Compute Pipeline, retrieved using *
+		 */
+		VkPipeline m_pipeline{};
+	};
+}
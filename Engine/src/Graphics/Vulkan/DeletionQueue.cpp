@@ -0,0 +1,40 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/DeletionQueue.h"
+
+#include <utility>
+
+namespace ash
+{
+	DeletionQueue::~DeletionQueue()
+	{
+		flush();
+	}
+
+	void DeletionQueue::retire(uint64_t submittedFrames, std::function<void()> destroy)
+	{
+		m_entries.push_back({ submittedFrames, std::move(destroy) });
+	}
+
+	void DeletionQueue::collect(uint64_t completedFrames)
+	{
+		// entries are retired with non decreasing counts, the first one still in use ends the walk
+		while (!m_entries.empty() && m_entries.front().submittedFrames <= completedFrames)
+		{
+			std::function<void()> destroy{ std::move(m_entries.front().destroy) };
+			m_entries.pop_front();
+			destroy();
+		}
+	}
+
+	void DeletionQueue::flush()
+	{
+		while (!m_entries.empty())
+		{
+			std::function<void()> destroy{ std::move(m_entries.front().destroy) };
+			m_entries.pop_front();
+			destroy();
+		}
+	}
+}
@@ -0,0 +1,60 @@
+/**
+ * Defers the destruction of Vulkan objects until the frames using them are done
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace ash
+{
+	/**
+	 * Defers the destruction of Vulkan objects until the frames using them are done.
+	 * Objects are retired with the number of frames submitted so far, every frame that may still
+	 * use them was submitted before, and are destroyed once that many frames are known to be complete,
+	 * which the renderer learns from the fence it waits on at the start of every frame
+	 */
+	class DeletionQueue
+	{
+	public:
+		DeletionQueue() = default;
+		~DeletionQueue();
+
+		DeletionQueue(const DeletionQueue&) = delete;
+		DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+		/**
+		 * Queues the destruction of objects that frames before submittedFrames may still use
+		 * @param destroy destroys the objects, objects captured by value are released along with it
+		 */
+		void retire(uint64_t submittedFrames, std::function<void()> destroy);
+
+		/**
+		 * Destroys what the first completedFrames frames were the last to use, in retirement order
+		 */
+		void collect(uint64_t completedFrames);
+
+		/**
+		 * Destroys everything still queued, the device must be idle
+		 */
+		void flush();
+
+		bool empty() const { return m_entries.empty(); }
+
+	private:
+
+		struct Entry
+		{
+			uint64_t				submittedFrames	{ 0 };
+			std::function<void()>	destroy			{};
+		};
+
+		/**
+		 * Retired objects, oldest first
+		 */
+		std::deque<Entry> m_entries{};
+	};
+}
@@ -0,0 +1,144 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/DescriptorAllocator.h"
+
+#include <stdexcept>
+#include <array>
+
+namespace ash
+{
+	DescriptorAllocator::DescriptorAllocator(const LogicalDevice* logicalDevice, uint32_t setsPerPool) :
+		m_logicalDevice{ logicalDevice }, m_setsPerPool{ setsPerPool }
+	{
+	}
+
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		for (VkDescriptorPool pool : m_usedPools)
+		{
+			vkDestroyDescriptorPool(*m_logicalDevice, pool, nullptr);
+		}
+		for (VkDescriptorPool pool : m_freePools)
+		{
+			vkDestroyDescriptorPool(*m_logicalDevice, pool, nullptr);
+		}
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+	{
+		auto freeSets{ m_freeSets.find(layout) };
+		if (freeSets != m_freeSets.end() && !freeSets->second.empty())
+		{
+			VkDescriptorSet set{ freeSets->second.back() };
+			freeSets->second.pop_back();
+			return set;
+		}
+
+		if (!m_currentPool)
+		{
+			nextPool();
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool		= m_currentPool;
+		allocInfo.descriptorSetCount	= 1;
+		allocInfo.pSetLayouts			= &layout;
+
+		VkDescriptorSet set{};
+		VkResult result{ vkAllocateDescriptorSets(*m_logicalDevice, &allocInfo, &set) };
+
+		// a full pool is not an error, chain the next one and try once more
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			nextPool();
+			allocInfo.descriptorPool = m_currentPool;
+			result = vkAllocateDescriptorSets(*m_logicalDevice, &allocInfo, &set);
+		}
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+		return set;
+	}
+
+	void DescriptorAllocator::release(VkDescriptorSetLayout layout, VkDescriptorSet set)
+	{
+		m_releasedSets.push_back({ layout, set });
+	}
+
+	std::vector<DescriptorAllocator::ReleasedSet> DescriptorAllocator::takeReleasedSets()
+	{
+		std::vector<ReleasedSet> sets{};
+		sets.swap(m_releasedSets);
+		return sets;
+	}
+
+	void DescriptorAllocator::recycle(const std::vector<ReleasedSet>& sets)
+	{
+		for (const ReleasedSet& released : sets)
+		{
+			m_freeSets[released.layout].push_back(released.set);
+		}
+	}
+
+	void DescriptorAllocator::reset()
+	{
+		for (VkDescriptorPool pool : m_usedPools)
+		{
+			vkResetDescriptorPool(*m_logicalDevice, pool, 0);
+			m_freePools.push_back(pool);
+		}
+		m_usedPools.clear();
+		m_currentPool = VK_NULL_HANDLE;
+
+		// the pools' sets are gone, recycled or not
+		m_releasedSets.clear();
+		m_freeSets.clear();
+	}
+
+	void DescriptorAllocator::nextPool()
+	{
+		if (m_freePools.empty())
+		{
+			m_currentPool = createPool();
+		}
+		else
+		{
+			m_currentPool = m_freePools.back();
+			m_freePools.pop_back();
+		}
+		m_usedPools.push_back(m_currentPool);
+	}
+
+	VkDescriptorPool DescriptorAllocator::createPool()
+	{
+		// every descriptor type used by the shaders, scaled from the number of sets
+		std::array<VkDescriptorPoolSize, 5> poolSizes{};
+		poolSizes[0].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[0].descriptorCount	= m_setsPerPool;
+		poolSizes[1].type				= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		poolSizes[1].descriptorCount	= m_setsPerPool;
+		poolSizes[2].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[2].descriptorCount	= m_setsPerPool;
+		poolSizes[3].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		poolSizes[3].descriptorCount	= m_setsPerPool;
+		poolSizes[4].type				= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[4].descriptorCount	= m_setsPerPool * 2;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount	= static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes		= poolSizes.data();
+		poolInfo.maxSets		= m_setsPerPool;
+
+		VkDescriptorPool pool{};
+		if (vkCreateDescriptorPool(*m_logicalDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+		return pool;
+	}
+}
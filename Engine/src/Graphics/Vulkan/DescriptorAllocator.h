@@ -0,0 +1,126 @@
+/**
+ * Allocates descriptor sets from a growing chain of descriptor pools
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/LogicalDevice.h"
+
+#include <vulkan/vulkan.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Allocates descriptor sets from a growing chain of descriptor pools.
+	 * When the current pool runs out a recycled or new pool is chained on, so there is
+	 * no fixed limit on sets. Pools are never freed from, reset returns all sets at once and
+	 * keeps the pools for reuse. Single sets can be released and are handed out again by
+	 * allocate for the same layout once recycled
+	 */
+	class DescriptorAllocator
+	{
+	public:
+		/**
+		 * Set given back with release, its layout picks which allocations may reuse it
+		 */
+		struct ReleasedSet
+		{
+			VkDescriptorSetLayout	layout	{};
+			VkDescriptorSet			set		{};
+		};
+
+		/**
+		 * @param setsPerPool number of sets each pool holds, descriptor counts are scaled from it
+		 */
+		DescriptorAllocator(const LogicalDevice* logicalDevice, uint32_t setsPerPool);
+		~DescriptorAllocator();
+
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+		/**
+		 * Allocates a set with layout, reusing a recycled set of the layout first and chaining
+		 * another pool when the current one is full. A reused set holds its old descriptors
+		 */
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+		/**
+		 * Gives a set back, the GPU may still use it so it is only reused after recycle
+		 */
+		void release(VkDescriptorSetLayout layout, VkDescriptorSet set);
+
+		bool hasReleasedSets() const { return !m_releasedSets.empty(); }
+
+		/**
+		 * Returns the sets released since the last call, to be recycled once the GPU is done with them
+		 */
+		std::vector<ReleasedSet> takeReleasedSets();
+
+		/**
+		 * Makes the sets available to allocate, the GPU must be done with them
+		 */
+		void recycle(const std::vector<ReleasedSet>& sets);
+
+		/**
+		 * Resets every pool, all sets allocated so far become invalid.
+		 * The GPU must be done with them
+		 */
+		void reset();
+
+		/**
+		 * Number of pools created so far
+		 */
+		size_t getPoolCount() const { return m_usedPools.size() + m_freePools.size(); }
+
+	private:
+
+		/**
+		 * Vulkan Logical Device, used for resource destruction
+		 */
+		const LogicalDevice* m_logicalDevice{};
+
+		/**
+		 * Number of sets each pool holds
+		 */
+		uint32_t m_setsPerPool{ 0 };
+
+		/**
+		 * Pool sets are currently allocated from, null until the first allocation
+		 */
+		VkDescriptorPool m_currentPool{};
+
+		/**
+		 * Pools holding allocated sets, including the current pool
+		 */
+		std::vector<VkDescriptorPool> m_usedPools{};
+
+		/**
+		 * Empty pools left over from a reset, used before creating new ones
+		 */
+		std::vector<VkDescriptorPool> m_freePools{};
+
+		/**
+		 * Sets released since the last takeReleasedSets
+		 */
+		std::vector<ReleasedSet> m_releasedSets{};
+
+		/**
+		 * Recycled sets of every layout, allocated before the pools
+		 */
+		std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> m_freeSets{};
+
+		/**
+		 * Makes a recycled or new pool current
+		 */
+		void nextPool();
+
+		/**
+		 * Creates a Vulkan Descriptor Pool sized for m_setsPerPool sets
+		 */
+		VkDescriptorPool createPool();
+	};
+}
@@ -0,0 +1,48 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/FrameAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ash
+{
+	FrameAllocator::FrameAllocator(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, VkDeviceSize frameSize, uint32_t frameCount) :
+		m_frameCount{ frameCount }
+	{
+		const VkPhysicalDeviceLimits& limits{ physicalDevice->getProperties().limits };
+		m_alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+		m_frameSize = (frameSize + m_alignment - 1) / m_alignment * m_alignment;
+
+		m_buffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			m_frameSize * frameCount,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			logicalDevice->getHostWriteProperties(),
+			MemoryCategory::Dynamic);
+	}
+
+	void FrameAllocator::beginFrame(uint32_t frame)
+	{
+		m_frameStart	= m_frameSize * (frame % m_frameCount);
+		m_head			= m_frameStart;
+	}
+
+	FrameAllocator::Allocation FrameAllocator::allocate(VkDeviceSize size)
+	{
+		VkDeviceSize end{ m_head + size };
+		if (end > m_frameStart + m_frameSize)
+		{
+			throw std::runtime_error("failed to allocate frame data, frame allocator is full!");
+		}
+
+		Allocation allocation{};
+		allocation.data		= static_cast<char*>(m_buffer->getMappedData()) + m_head;
+		allocation.offset	= static_cast<uint32_t>(m_head);
+
+		m_head = (end + m_alignment - 1) / m_alignment * m_alignment;
+		return allocation;
+	}
+}
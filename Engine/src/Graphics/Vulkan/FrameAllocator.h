@@ -0,0 +1,104 @@
+/**
+ * Linear allocator for data written once per frame
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/PhysicalDevice.h"
+#include "Vulkan/LogicalDevice.h"
+#include "Vulkan/Buffer.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <memory>
+
+namespace ash
+{
+	/**
+	 * Linear allocator for data written once per frame, e.g. camera matrices or per object data.
+	 * One persistently mapped buffer is split into a section per frame in flight, a frame's
+	 * section is reset when the frame starts. Allocations return offsets meant to be passed
+	 * as dynamic offsets of uniform or storage buffer descriptors pointing at the buffer
+	 */
+	class FrameAllocator
+	{
+	public:
+		/**
+		 * Memory handed out by allocate
+		 */
+		struct Allocation
+		{
+			void*		data	{};
+			uint32_t	offset	{ 0 };
+		};
+
+		/**
+		 * @param frameSize in bytes available to each frame
+		 * @param frameCount number of frames in flight, each gets its own section
+		 */
+		FrameAllocator(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, VkDeviceSize frameSize, uint32_t frameCount);
+
+		/**
+		 * overide * operator for more intuitive access
+		 */
+		operator const VkBuffer& () const { return *m_buffer; }
+
+		/**
+		 * Resets the section of frame, the GPU must be done with the frame's previous use
+		 */
+		void beginFrame(uint32_t frame);
+
+		/**
+		 * Returns size bytes of the current frame's section, aligned for dynamic uniform and storage offsets
+		 */
+		Allocation allocate(VkDeviceSize size);
+
+		/**
+		 * Copies data into the current frame's section
+		 * @return dynamic offset of the copy
+		 */
+		template<typename T>
+		uint32_t write(const T& data)
+		{
+			Allocation allocation{ allocate(sizeof(T)) };
+			memcpy(allocation.data, &data, sizeof(T));
+			return allocation.offset;
+		}
+
+		/**
+		 * Bytes available to each frame
+		 */
+		VkDeviceSize getFrameSize() const { return m_frameSize; }
+
+	private:
+
+		/**
+		 * Host visible, persistently mapped buffer holding every frame's section
+		 */
+		std::unique_ptr<Buffer> m_buffer{};
+
+		/**
+		 * Size of a frame's section, a multiple of m_alignment
+		 */
+		VkDeviceSize m_frameSize{ 0 };
+
+		/**
+		 * Alignment of every allocation, meets both dynamic uniform and storage offset limits
+		 */
+		VkDeviceSize m_alignment{ 0 };
+
+		/**
+		 * Number of sections in the buffer
+		 */
+		uint32_t m_frameCount{ 0 };
+
+		/**
+		 * Start of the current frame's section and the next free byte in it
+		 */
+		VkDeviceSize m_frameStart{ 0 };
+
+		VkDeviceSize m_head{ 0 };
+	};
+}
@@ -0,0 +1,96 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/GeometryHeap.h"
+
+#include <stdexcept>
+
+namespace ash
+{
+	GeometryHeap::GeometryHeap(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, uint32_t vertexCapacity, uint32_t indexCapacity) :
+		m_vertexAllocator{ vertexCapacity }, m_indexAllocator{ indexCapacity }
+	{
+		m_vertexBuffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			sizeof(Vertex) * static_cast<VkDeviceSize>(vertexCapacity),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			logicalDevice->getDeviceLocalProperties(),
+			MemoryCategory::Geometry);
+
+		m_indexBuffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCapacity),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			logicalDevice->getDeviceLocalProperties(),
+			MemoryCategory::Geometry);
+	}
+
+	GeometryAllocation GeometryHeap::allocate(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, UploadBatch& batch)
+	{
+		GeometryAllocation allocation{};
+		allocation.vertexCount	= static_cast<uint32_t>(vertices.size());
+		allocation.indexCount	= static_cast<uint32_t>(indices.size());
+
+		if (allocation.vertexCount > 0)
+		{
+			TlsfAllocator::Allocation range{ m_vertexAllocator.allocate(allocation.vertexCount, 1) };
+			if (range.node == TlsfAllocator::INVALID_NODE)
+			{
+				throw std::runtime_error("failed to allocate vertices, geometry heap is full!");
+			}
+			allocation.vertexOffset	= static_cast<uint32_t>(range.offset);
+			allocation.vertexNode	= range.node;
+		}
+
+		if (allocation.indexCount > 0)
+		{
+			TlsfAllocator::Allocation range{ m_indexAllocator.allocate(allocation.indexCount, 1) };
+			if (range.node == TlsfAllocator::INVALID_NODE)
+			{
+				free(allocation);
+				throw std::runtime_error("failed to allocate indices, geometry heap is full!");
+			}
+			allocation.firstIndex	= static_cast<uint32_t>(range.offset);
+			allocation.indexNode	= range.node;
+		}
+
+		if (allocation.vertexCount > 0)
+		{
+			batch.copyToBuffer(*m_vertexBuffer, vertices.data(),
+				sizeof(Vertex) * static_cast<VkDeviceSize>(allocation.vertexCount),
+				sizeof(Vertex) * static_cast<VkDeviceSize>(allocation.vertexOffset));
+		}
+		if (allocation.indexCount > 0)
+		{
+			batch.copyToBuffer(*m_indexBuffer, indices.data(),
+				sizeof(uint32_t) * static_cast<VkDeviceSize>(allocation.indexCount),
+				sizeof(uint32_t) * static_cast<VkDeviceSize>(allocation.firstIndex));
+		}
+
+		return allocation;
+	}
+
+	void GeometryHeap::free(GeometryAllocation& allocation)
+	{
+		if (allocation.vertexNode != TlsfAllocator::INVALID_NODE)
+		{
+			m_vertexAllocator.free(allocation.vertexNode);
+		}
+		if (allocation.indexNode != TlsfAllocator::INVALID_NODE)
+		{
+			m_indexAllocator.free(allocation.indexNode);
+		}
+		allocation = GeometryAllocation{};
+	}
+
+	void GeometryHeap::bind(VkCommandBuffer commandBuffer) const
+	{
+		VkBuffer		vertexBuffers[]	{ *m_vertexBuffer };
+		VkDeviceSize	offsets[]		{ 0 };
+
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, *m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+}
@@ -0,0 +1,103 @@
+/**
+ * Device local vertex and index buffers shared by every model
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/PhysicalDevice.h"
+#include "Vulkan/LogicalDevice.h"
+#include "Vulkan/Buffer.h"
+#include "Vulkan/UploadBatch.h"
+#include "Vulkan/Vertex.hpp"
+#include "Utils/TlsfAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Range of the geometry heap holding one model's vertices and indices
+	 */
+	struct GeometryAllocation
+	{
+		/**
+		 * Index of the first vertex, passed as vertexOffset of indexed draws
+		 */
+		uint32_t vertexOffset	{ 0 };
+
+		uint32_t vertexCount	{ 0 };
+
+		/**
+		 * Index of the first index, added to the firstIndex of indexed draws
+		 */
+		uint32_t firstIndex		{ 0 };
+
+		uint32_t indexCount		{ 0 };
+
+		/**
+		 * Allocator nodes needed to free the ranges
+		 */
+		uint32_t vertexNode		{ TlsfAllocator::INVALID_NODE };
+
+		uint32_t indexNode		{ TlsfAllocator::INVALID_NODE };
+	};
+
+	/**
+	 * Device local vertex and index buffers shared by every model.
+	 * Models sub-allocate ranges, measured in vertices and indices, so both buffers
+	 * are bound once per frame and draws only differ in vertexOffset and firstIndex
+	 */
+	class GeometryHeap
+	{
+	public:
+		GeometryHeap(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, uint32_t vertexCapacity, uint32_t indexCapacity);
+
+		/**
+		 * Allocates ranges for the vertices and indices and records their upload into batch
+		 */
+		GeometryAllocation allocate(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, UploadBatch& batch);
+
+		/**
+		 * Returns the ranges of an allocation, the GPU must be done drawing from them
+		 */
+		void free(GeometryAllocation& allocation);
+
+		/**
+		 * Binds the vertex and index buffers
+		 */
+		void bind(VkCommandBuffer commandBuffer) const;
+
+		/**
+		 * Returns the buffer holding every vertex
+		 */
+		const Buffer& getVertexBuffer() const { return *m_vertexBuffer; }
+
+		/**
+		 * Returns the buffer holding every index
+		 */
+		const Buffer& getIndexBuffer() const { return *m_indexBuffer; }
+
+	private:
+
+		/**
+		 * Buffer holding the vertices of every model
+		 */
+		std::unique_ptr<Buffer> m_vertexBuffer{};
+
+		/**
+		 * Buffer holding the indices of every model
+		 */
+		std::unique_ptr<Buffer> m_indexBuffer{};
+
+		/**
+		 * Free lists of the vertex and index buffers, in vertices and indices
+		 */
+		TlsfAllocator m_vertexAllocator;
+
+		TlsfAllocator m_indexAllocator;
+	};
+}
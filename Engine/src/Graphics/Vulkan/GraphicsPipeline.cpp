@@ -6,16 +6,24 @@
 #include "Vulkan/Vertex.hpp"
 #include "Vulkan/PushConstantData.hpp"
 
+#include <array>
 #include <fstream>
 #include <stdexcept>
 
 namespace ash
 {
-	GraphicsPipeline::GraphicsPipeline(const LogicalDevice* logicalDevice, const SwapChain* swapChain, const RenderPass* renderPass, 
-		std::vector<VkDescriptorSetLayout>& layouts) :
-		m_logicalDevice{ logicalDevice }
+	GraphicsPipeline::GraphicsPipeline(const LogicalDevice* logicalDevice, const RenderPass* renderPass, 
+		std::vector<VkDescriptorSetLayout>& layouts, const std::string& vertShaderPath, const std::string& fragShaderPath, DepthMode depthMode) :
+		m_logicalDevice{ logicalDevice }, m_vertShaderPath{ vertShaderPath }, m_fragShaderPath{ fragShaderPath }, m_depthMode{ depthMode }
 	{
-		createPipeline(swapChain, renderPass, layouts);
+		// get shader code from files, depth only pipelines have no fragment shader
+		m_vertShaderCode = readFile(m_vertShaderPath);
+		if (m_depthMode != DepthMode::DepthOnly)
+		{
+			m_fragShaderCode = readFile(m_fragShaderPath);
+		}
+
+		createPipeline(renderPass, layouts);
 	}
 
 	GraphicsPipeline::~GraphicsPipeline()
@@ -29,15 +37,13 @@ namespace ash
 		vkDestroyPipelineLayout(*m_logicalDevice, m_pipelineLayout, nullptr);
 	}
 
-	void GraphicsPipeline::createPipeline(const SwapChain* swapChain, const RenderPass* renderPass, std::vector<VkDescriptorSetLayout>& layouts)
+	void GraphicsPipeline::createPipeline(const RenderPass* renderPass, std::vector<VkDescriptorSetLayout>& layouts)
 	{
-		// get shader code from files
-		auto vertShaderCode = readFile("shaders/vert.spv");
-		auto fragShaderCode = readFile("shaders/frag.spv");
+		const bool depthOnly{ m_depthMode == DepthMode::DepthOnly };
 
 		// convert shader code into shader modules
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+		VkShaderModule vertShaderModule = createShaderModule(m_vertShaderCode);
+		VkShaderModule fragShaderModule = depthOnly ? VK_NULL_HANDLE : createShaderModule(m_fragShaderCode);
 
 		// vertex shader info
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
@@ -59,13 +65,20 @@ namespace ash
 		auto bindingDescription		= Vertex::getBindingDescription();
 		auto attributeDescriptions	= Vertex::getAttributeDescriptions();
 
+		// the depth only shaders read the position, and the joints when skinned
+		std::vector<VkVertexInputAttributeDescription> attributes{ attributeDescriptions.begin(), attributeDescriptions.end() };
+		if (depthOnly)
+		{
+			attributes = { attributeDescriptions[0], attributeDescriptions[4], attributeDescriptions[5] };
+		}
+
 		// info for how vertex data is loaded into the vertex shader
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 		vertexInputInfo.sType							= VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexInputInfo.vertexBindingDescriptionCount	= 1;
 		vertexInputInfo.pVertexBindingDescriptions		= &bindingDescription;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexAttributeDescriptions	= attributeDescriptions.data();
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+		vertexInputInfo.pVertexAttributeDescriptions	= attributes.data();
 
 		// info on what kind of geometry will be drawn, IE: triangles, lines, etc...
 		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -73,30 +86,18 @@ namespace ash
 		inputAssembly.topology					= VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		inputAssembly.primitiveRestartEnable	= VK_FALSE;
 
-		// get swap extent from swap chain, needed for viewport
-		const VkExtent2D& swapExtent{ swapChain->getSwapExtent() };
-
-		// info on viewport size, depth, and offset
-		VkViewport viewport{};
-		viewport.x			= 0.0f;
-		viewport.y			= 0.0f;
-		viewport.width		= (float)swapExtent.width;
-		viewport.height		= (float)swapExtent.height;
-		viewport.minDepth	= 0.0f;
-		viewport.maxDepth	= 1.0f;
-
-		// info about clipping
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapExtent;
-
-		// combined info on viewport and scissor
+		// one viewport and scissor, set while recording so resizing keeps the pipeline
 		VkPipelineViewportStateCreateInfo viewportState{};
 		viewportState.sType			= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports	= &viewport;
 		viewportState.scissorCount	= 1;
-		viewportState.pScissors		= &scissor;
+
+		const std::array<VkDynamicState, 2> dynamicStates{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType				= VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount	= static_cast<uint32_t>(dynamicStates.size());
+		dynamicState.pDynamicStates		= dynamicStates.data();
 
 		// rasterization stage info
 		VkPipelineRasterizationStateCreateInfo rasterizer{};
@@ -119,8 +120,8 @@ namespace ash
 		VkPipelineDepthStencilStateCreateInfo depthStencil{};
 		depthStencil.sType					= VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depthStencil.depthTestEnable		= VK_TRUE;
-		depthStencil.depthWriteEnable		= VK_TRUE;
-		depthStencil.depthCompareOp			= VK_COMPARE_OP_LESS;
+		depthStencil.depthWriteEnable		= m_depthMode == DepthMode::Equal ? VK_FALSE : VK_TRUE;
+		depthStencil.depthCompareOp			= m_depthMode == DepthMode::Equal ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
 		depthStencil.depthBoundsTestEnable	= VK_FALSE;
 		depthStencil.minDepthBounds			= 0.0f; // optional
 		depthStencil.maxDepthBounds			= 1.0f; // optional
@@ -130,7 +131,7 @@ namespace ash
 
 		// color blending info
 		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT
+		colorBlendAttachment.colorWriteMask = depthOnly ? 0 : VK_COLOR_COMPONENT_R_BIT
 											| VK_COLOR_COMPONENT_G_BIT
 											| VK_COLOR_COMPONENT_B_BIT
 											| VK_COLOR_COMPONENT_A_BIT;
@@ -165,10 +166,20 @@ namespace ash
 			throw std::runtime_error("failed to create pipeline layout!");
 		}
 
+		// dynamic rendering takes the attachment formats instead of a render pass
+		const VkFormat colorFormat{ renderPass->getColorFormat() };
+
+		VkPipelineRenderingCreateInfoKHR renderingInfo{};
+		renderingInfo.sType						= VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+		renderingInfo.colorAttachmentCount		= 1;
+		renderingInfo.pColorAttachmentFormats	= &colorFormat;
+		renderingInfo.depthAttachmentFormat		= renderPass->getDepthFormat();
+
 		// Pipeline creation info
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType					= VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount				= 2;
+		pipelineInfo.pNext					= renderPass->isDynamic() ? &renderingInfo : nullptr;
+		pipelineInfo.stageCount				= depthOnly ? 1 : 2;
 		pipelineInfo.pStages				= shaderStages;
 		pipelineInfo.pVertexInputState		= &vertexInputInfo;
 		pipelineInfo.pInputAssemblyState	= &inputAssembly;
@@ -177,7 +188,7 @@ namespace ash
 		pipelineInfo.pMultisampleState		= &multisampling;
 		pipelineInfo.pDepthStencilState		= &depthStencil;
 		pipelineInfo.pColorBlendState		= &colorBlending;
-		pipelineInfo.pDynamicState			= nullptr;
+		pipelineInfo.pDynamicState			= &dynamicState;
 		pipelineInfo.layout					= m_pipelineLayout;
 		pipelineInfo.renderPass				= *renderPass;
 		pipelineInfo.subpass				= 0;
@@ -190,7 +201,10 @@ namespace ash
 		}
 
 		// shaders are loaded and the modules are no longer required
-		vkDestroyShaderModule(*m_logicalDevice, fragShaderModule, nullptr);
+		if (fragShaderModule)
+		{
+			vkDestroyShaderModule(*m_logicalDevice, fragShaderModule, nullptr);
+		}
 		vkDestroyShaderModule(*m_logicalDevice, vertShaderModule, nullptr);
 	}
 
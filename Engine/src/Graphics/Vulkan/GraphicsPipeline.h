@@ -6,7 +6,6 @@
 #pragma once
 
 #include "Vulkan/LogicalDevice.h"
-#include "Vulkan/SwapChain.h"
 #include "Vulkan/RenderPass.h"
 
 #include <vulkan/vulkan.h>
@@ -16,13 +15,28 @@
 namespace ash
 {
 	/**
-	 * Wrapper for Vulkan Graphics Pipeline
+	 * How a pipeline uses the depth attachment
+	 */
+	enum class DepthMode
+	{
+		TestAndWrite,	// keeps the nearest fragment
+		DepthOnly,		// depth prepass, no fragment shader, only positions and skinning are fetched
+		Equal,			// shades the fragments the depth prepass left, without writing depth
+	};
+
+	/**
+	 * Wrapper for Vulkan Graphics Pipeline.
+	 * Viewport and scissor are dynamic state, so the pipeline doesn't depend on the swap chain's
+	 * extent and only needs recreating with a render pass of different formats
 	 */
 	class GraphicsPipeline
 	{
 	public:
-		GraphicsPipeline(const LogicalDevice* logicalDevice, const SwapChain* swapChain, 
-			const RenderPass* renderPass, std::vector<VkDescriptorSetLayout>& layouts);
+		GraphicsPipeline(const LogicalDevice* logicalDevice,
+			const RenderPass* renderPass, std::vector<VkDescriptorSetLayout>& layouts,
+			const std::string& vertShaderPath = "shaders/vert.spv",
+			const std::string& fragShaderPath = "shaders/frag.spv",
+			DepthMode depthMode = DepthMode::TestAndWrite);
 		~GraphicsPipeline();
 
 		/**
@@ -31,22 +45,27 @@ namespace ash
 		operator const VkPipeline& () const { return m_graphicsPipeline; }
 
 		/**
-		 * Deletes pipeline and layout, called during swap chain recreation
+		 * Deletes pipeline and layout, called when the render pass is recreated
 		 */
 		void cleanupPipeline();
 
 		/**
-		 * Creates a Vulkan Graphics Pipeline, called during swap chain recreation
+		 * Creates a Vulkan Graphics Pipeline, called when the render pass is recreated.
+		 * The viewport and scissor must be set in every command buffer drawing with it.
+		 * With dynamic rendering the pipeline is created for the render pass' attachment formats
 		 */
-		void createPipeline(const SwapChain* swapChain, 
-			const RenderPass* renderPass, 
-			std::vector<VkDescriptorSetLayout>& layouts);
+		void createPipeline(const RenderPass* renderPass, std::vector<VkDescriptorSetLayout>& layouts);
 
 		/**
 		 * Returns reference to the pipeline layout
 		 */
 		const VkPipelineLayout& getLayout() const { return m_pipelineLayout; }
 
+		/**
+		 * read shader code from provided spirV file
+		 */
+		static std::vector<char> readFile(const std::string& filename);
+
 	private:
 
 		/**
@@ -54,6 +73,28 @@ namespace ash
 		 */
 		const LogicalDevice* m_logicalDevice{};
 
+		/**
+		 * Compiled vertex shader, kept for pipeline recreation
+		 */
+		std::string m_vertShaderPath{};
+
+		/**
+		 * Compiled fragment shader, kept for pipeline recreation
+		 */
+		std::string m_fragShaderPath{};
+
+		/**
+		 * Shader code read once by the constructor, recreation doesn't go back to the disk
+		 */
+		std::vector<char> m_vertShaderCode{};
+
+		std::vector<char> m_fragShaderCode{};
+
+		/**
+		 * Depth state and stages, kept for pipeline recreation
+		 */
+		DepthMode m_depthMode{ DepthMode::TestAndWrite };
+
 		/**
 		 * Vulkan Pipeline Layout, used during pipeline creation and during draw calls
 		 */
@@ -64,11 +105,6 @@ namespace ash
 		 */
 		VkPipeline m_graphicsPipeline{};
 
-		/**
-		 * read shader code from provided spirV file
-		 */
-		static std::vector<char> readFile(const std::string& filename);
-		
 		/**
 		 * convert shader code into shader module
 		 */
@@ -16,18 +16,20 @@ namespace ash
 		VkImageTiling tiling,
 		VkImageUsageFlags usage,
 		VkMemoryPropertyFlags properties,
-		VkImageAspectFlags aspectFlags)
+		VkImageAspectFlags aspectFlags,
+		MemoryCategory category,
+		const VkComponentMapping& components)
 		: m_logicalDevice{ logicalDevice }
 	{
-		createImage(physicalDevice, width, height, format, tiling, usage, properties);
-		createImageView(format, aspectFlags);
+		createImage(physicalDevice, width, height, format, tiling, usage, properties, category);
+		createImageView(format, aspectFlags, components);
 	}
 
 	Image::~Image()
 	{
 		vkDestroyImageView(*m_logicalDevice, m_imageView, nullptr);
 		vkDestroyImage(*m_logicalDevice, m_image, nullptr);
-		vkFreeMemory(*m_logicalDevice, m_imageMemory, nullptr);
+		m_logicalDevice->getAllocator().free(m_allocation);
 	}
 
 	void Image::createImage(
@@ -36,8 +38,13 @@ namespace ash
 		uint32_t height, 
 		VkFormat format, VkImageTiling tiling, 
 		VkImageUsageFlags usage, 
-		VkMemoryPropertyFlags properties)
+		VkMemoryPropertyFlags properties,
+		MemoryCategory category)
 	{
+		m_width		= width;
+		m_height	= height;
+		m_format	= format;
+
 		// Image creation info
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -60,30 +67,19 @@ namespace ash
 			throw std::runtime_error("failed to create image!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(*m_logicalDevice, m_image, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize	= memRequirements.size;
-		allocInfo.memoryTypeIndex	= physicalDevice->findMemoryType(
-			memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		if (vkAllocateMemory(*m_logicalDevice, &allocInfo, nullptr, &m_imageMemory) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to allocate image memory!");
-		}
-
-		vkBindImageMemory(*m_logicalDevice, m_image, m_imageMemory, 0);
+		m_allocation = m_logicalDevice->getAllocator().allocateImage(m_image, properties, tiling == VK_IMAGE_TILING_LINEAR, category);
 	}
 
-	void Image::createImageView(VkFormat format, VkImageAspectFlags aspectFlags)
+	void Image::createImageView(VkFormat format, VkImageAspectFlags aspectFlags, const VkComponentMapping& components)
 	{
+		m_components = components;
+
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType								= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewInfo.image								= m_image;
 		viewInfo.viewType							= VK_IMAGE_VIEW_TYPE_2D;
 		viewInfo.format								= format;
+		viewInfo.components							= components;
 		viewInfo.subresourceRange.aspectMask		= aspectFlags;
 		viewInfo.subresourceRange.baseMipLevel		= 0;
 		viewInfo.subresourceRange.levelCount		= 1;
@@ -96,10 +92,8 @@ namespace ash
 		}
 	}
 
-	void Image::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
+	void Image::transitionImageLayout(VkCommandBuffer commandBuffer, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
 	{
-		VkCommandBuffer commandBuffer = m_logicalDevice->beginSingleTimeCommand();
-
 		VkImageMemoryBarrier barrier{};
 		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.oldLayout						= oldLayout;
@@ -134,6 +128,14 @@ namespace ash
 			srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 			dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 		}
+		else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+		{
+			barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+			srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
 		else
 		{
 			throw std::runtime_error("unsupported layout transition!");
@@ -146,16 +148,12 @@ namespace ash
 			0, nullptr,
 			0, nullptr,
 			1, &barrier);
-
-		m_logicalDevice->endSingleTimeCommand(commandBuffer);
 	}
 
-	void Image::copyFromBuffer(VkBuffer buffer, uint32_t width, uint32_t height)
+	void Image::copyFromBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t width, uint32_t height, VkDeviceSize bufferOffset, uint32_t firstRow)
 	{
-		VkCommandBuffer commandBuffer = m_logicalDevice->beginSingleTimeCommand();
-
 		VkBufferImageCopy region{};
-		region.bufferOffset			= 0;
+		region.bufferOffset			= bufferOffset;
 		region.bufferRowLength		= 0;
 		region.bufferImageHeight	= 0;
 
@@ -164,7 +162,7 @@ namespace ash
 		region.imageSubresource.baseArrayLayer	= 0;
 		region.imageSubresource.layerCount		= 1;
 
-		region.imageOffset = { 0,0,0 };
+		region.imageOffset = { 0, static_cast<int32_t>(firstRow), 0 };
 		region.imageExtent = { width, height, 1 };
 
 		vkCmdCopyBufferToImage(
@@ -174,7 +172,27 @@ namespace ash
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
 			&region);
+	}
 
-		m_logicalDevice->endSingleTimeCommand(commandBuffer);
+	void Image::blitTo(VkCommandBuffer commandBuffer, Image& destination)
+	{
+		VkImageBlit blit{};
+		blit.srcSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel		= 0;
+		blit.srcSubresource.baseArrayLayer	= 0;
+		blit.srcSubresource.layerCount		= 1;
+		blit.srcOffsets[1]					= { static_cast<int32_t>(m_width), static_cast<int32_t>(m_height), 1 };
+		blit.dstSubresource					= blit.srcSubresource;
+		blit.dstOffsets[1]					= { static_cast<int32_t>(destination.m_width), static_cast<int32_t>(destination.m_height), 1 };
+
+		vkCmdBlitImage(
+			commandBuffer,
+			m_image,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			destination.m_image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1,
+			&blit,
+			VK_FILTER_LINEAR);
 	}
-}
\ No newline at end of file
+}
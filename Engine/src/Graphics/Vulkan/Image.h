@@ -27,7 +27,9 @@ namespace ash
 			VkImageTiling tiling,
 			VkImageUsageFlags usage,
 			VkMemoryPropertyFlags properties,
-			VkImageAspectFlags aspectFlags
+			VkImageAspectFlags aspectFlags,
+			MemoryCategory category = MemoryCategory::Other,
+			const VkComponentMapping& components = {}
 		);
 		~Image();
 
@@ -37,6 +39,30 @@ namespace ash
 		 */
 		operator const VkImageView& () const { return m_imageView; }
 
+		/**
+		 * Returns reference to the Vulkan Image, used for barriers
+		 */
+		const VkImage& getImage() const { return m_image; }
+
+		/**
+		 * Returns the size and format the image was created with
+		 */
+		uint32_t getWidth() const { return m_width; }
+
+		uint32_t getHeight() const { return m_height; }
+
+		VkFormat getFormat() const { return m_format; }
+
+		/**
+		 * Returns the swizzle of the image view
+		 */
+		const VkComponentMapping& getComponents() const { return m_components; }
+
+		/**
+		 * Returns the memory bound to the image, used to tell which heap it lives in
+		 */
+		const MemoryAllocation& getAllocation() const { return m_allocation; }
+
 		/**
 		 * Creates the Vulkan Image
 		 */
@@ -47,23 +73,33 @@ namespace ash
 			VkFormat format, 
 			VkImageTiling tiling, 
 			VkImageUsageFlags usage, 
-			VkMemoryPropertyFlags properties
+			VkMemoryPropertyFlags properties,
+			MemoryCategory category
 		);
 
 		/**
-		 * Creates the Vulkan Image View used to access the Vulkan Image
+		 * Creates the Vulkan Image View used to access the Vulkan Image,
+		 * components swizzles the stored channels (identity by default)
 		 */
-		void createImageView(VkFormat format, VkImageAspectFlags aspectFlags);
+		void createImageView(VkFormat format, VkImageAspectFlags aspectFlags, const VkComponentMapping& components = {});
 
 		/**
-		 * Transitions image from one format to another using Vulkan Barriers
+		 * Records a transition of the image from one layout to another using Vulkan Barriers
 		 */
-		void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+		void transitionImageLayout(VkCommandBuffer commandBuffer, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 
 		/**
-		 * Copy image data from provided buffer into the Vulkan Image
+		 * Records a copy of image data from provided buffer into the Vulkan Image
+		 * @param bufferOffset in bytes where the image data starts in the buffer
+		 * @param firstRow of the image the data is copied to, height rows are copied from there
 		 */
-		void copyFromBuffer(VkBuffer buffer, uint32_t width, uint32_t height);
+		void copyFromBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t width, uint32_t height, VkDeviceSize bufferOffset = 0, uint32_t firstRow = 0);
+
+		/**
+		 * Records a linear filtered blit of the whole image onto the whole destination, scaling it to fit.
+		 * The image must be in transfer source layout and the destination in transfer destination layout
+		 */
+		void blitTo(VkCommandBuffer commandBuffer, Image& destination);
 
 	private:
 
@@ -78,13 +114,27 @@ namespace ash
 		VkImage m_image{};
 
 		/**
-		 * Vulkan Device Memory, memory of stored Vulkan Image
+		 * Memory of stored Vulkan Image, sub-allocated from the logical device's allocator
 		 */
-		VkDeviceMemory m_imageMemory{};
+		MemoryAllocation m_allocation{};
 
 		/**
 		 * Vulkan Image View, used to access data in the Vulkan Image
 		 */
 		VkImageView m_imageView{};
+
+		/**
+		 * Size and format of the Vulkan Image
+		 */
+		uint32_t m_width{ 0 };
+
+		uint32_t m_height{ 0 };
+
+		VkFormat m_format{ VK_FORMAT_UNDEFINED };
+
+		/**
+		 * Swizzle of the Vulkan Image View
+		 */
+		VkComponentMapping m_components{};
 	};
 }
\ No newline at end of file
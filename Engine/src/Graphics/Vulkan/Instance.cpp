@@ -25,7 +25,7 @@ namespace ash
 		appInfo.applicationVersion	= VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName			= "Ashael Engine";
 		appInfo.engineVersion		= VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion			= VK_API_VERSION_1_0;
+		appInfo.apiVersion			= VK_API_VERSION_1_2;
 
 		// instance creation info
 		VkInstanceCreateInfo createInfo{};
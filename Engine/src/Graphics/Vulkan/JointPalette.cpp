@@ -0,0 +1,47 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/JointPalette.h"
+
+#include <stdexcept>
+
+namespace ash
+{
+	JointPalette::JointPalette(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, uint32_t jointCapacity, uint32_t frameCount) :
+		m_jointCapacity{ jointCapacity }, m_frameCount{ frameCount }
+	{
+		VkDeviceSize alignment{ physicalDevice->getProperties().limits.minStorageBufferOffsetAlignment };
+		m_frameSize = (sizeof(glm::mat4) * static_cast<VkDeviceSize>(jointCapacity) + alignment - 1) / alignment * alignment;
+
+		m_buffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			m_frameSize * frameCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			logicalDevice->getHostWriteProperties(),
+			MemoryCategory::Dynamic);
+	}
+
+	void JointPalette::beginFrame(uint32_t frame)
+	{
+		m_frameStart = m_frameSize * (frame % m_frameCount);
+		m_jointCount = 0;
+	}
+
+	uint32_t JointPalette::allocate(uint32_t jointCount)
+	{
+		if (jointCount > m_jointCapacity - m_jointCount)
+		{
+			throw std::runtime_error("failed to allocate joints, joint palette is full!");
+		}
+
+		uint32_t first{ m_jointCount };
+		m_jointCount += jointCount;
+		return first;
+	}
+
+	glm::mat4* JointPalette::getJoints(uint32_t first)
+	{
+		return reinterpret_cast<glm::mat4*>(static_cast<char*>(m_buffer->getMappedData()) + m_frameStart) + first;
+	}
+}
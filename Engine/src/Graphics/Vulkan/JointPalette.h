@@ -0,0 +1,108 @@
+/**
+ * Per frame buffer holding the joint matrices of every skin
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/PhysicalDevice.h"
+#include "Vulkan/LogicalDevice.h"
+#include "Vulkan/Buffer.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+
+namespace ash
+{
+	/**
+	 * Per frame buffer holding the joint matrices of every skin.
+	 * One persistently mapped buffer is split into a section per frame in flight. Skins
+	 * allocate their joints from the current frame's section each frame and pass the
+	 * returned joint offset to the shader, a single storage buffer descriptor covers a
+	 * whole section and the frame is selected with a dynamic offset.
+	 * Instanced draws allocate their transforms from the same section
+	 */
+	class JointPalette
+	{
+	public:
+		/**
+		 * @param jointCapacity number of joint matrices available to each frame
+		 * @param frameCount number of frames in flight, each gets its own section
+		 */
+		JointPalette(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, uint32_t jointCapacity, uint32_t frameCount);
+
+		/**
+		 * overide * operator for more intuitive access
+		 */
+		operator const VkBuffer& () const { return *m_buffer; }
+
+		/**
+		 * Resets the section of frame, the GPU must be done with the frame's previous use
+		 */
+		void beginFrame(uint32_t frame);
+
+		/**
+		 * Allocates jointCount matrices from the current frame's section
+		 * @return index of the first joint within the section
+		 */
+		uint32_t allocate(uint32_t jointCount);
+
+		/**
+		 * Returns the matrices of the current frame's section, starting at joint index first
+		 */
+		glm::mat4* getJoints(uint32_t first);
+
+		/**
+		 * Number of matrices allocated from the current frame's section, the index the next allocation returns
+		 */
+		uint32_t getCount() const { return m_jointCount; }
+
+		/**
+		 * Dynamic offset of the current frame's section
+		 */
+		uint32_t getDynamicOffset() const { return static_cast<uint32_t>(m_frameStart); }
+
+		/**
+		 * Size in bytes of a frame's section, the range of the descriptor
+		 */
+		VkDeviceSize getFrameSize() const { return m_frameSize; }
+
+	private:
+
+		/**
+		 * Host visible, persistently mapped buffer holding every frame's section
+		 */
+		std::unique_ptr<Buffer> m_buffer{};
+
+		/**
+		 * Number of joint matrices in a frame's section
+		 */
+		uint32_t m_jointCapacity{ 0 };
+
+		/**
+		 * Size of a frame's section, padded to the storage buffer offset alignment
+		 */
+		VkDeviceSize m_frameSize{ 0 };
+
+		/**
+		 * Number of sections in the buffer
+		 */
+		uint32_t m_frameCount{ 0 };
+
+		/**
+		 * Start of the current frame's section
+		 */
+		VkDeviceSize m_frameStart{ 0 };
+
+		/**
+		 * Number of joints allocated from the current frame's section
+		 */
+		uint32_t m_jointCount{ 0 };
+	};
+}
@@ -2,6 +2,7 @@
  * Copyright (C) 2021, Jesse Springborn
  */
 #include "Vulkan\LogicalDevice.h"
+#include "Vulkan\StagingRing.h"
 
 #include <stdexcept>
 #include <vector>
@@ -9,12 +10,16 @@
 
 namespace ash
 {
-	LogicalDevice::LogicalDevice(const Instance* instance, const PhysicalDevice* physicalDevice)
+	LogicalDevice::LogicalDevice(const Instance* instance, const PhysicalDevice* physicalDevice, VkDeviceSize stagingRingSize, bool directWrite) :
+		m_directWrite{ directWrite }
 	{
 		PhysicalDevice::QueueFamilyIndices indices = physicalDevice->getQueueFamilyIndices();
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		m_graphicsFamily = indices.graphicsFamily.value();
+		m_transferFamily = indices.transferFamily.value_or(m_graphicsFamily);
+
+		std::set<uint32_t> uniqueQueueFamilies = { m_graphicsFamily, indices.presentFamily.value(), m_transferFamily };
 
 		float queuePriority = 1.0f;
 
@@ -30,8 +35,28 @@ namespace ash
 		}
 
 		VkPhysicalDeviceFeatures deviceFeatures{};
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
-
+		deviceFeatures.samplerAnisotropy			= VK_TRUE;
+		// indirect draws of the GPU culling path
+		deviceFeatures.multiDrawIndirect			= physicalDevice->getDeviceFeatures().multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance	= physicalDevice->getDeviceFeatures().drawIndirectFirstInstance;
+
+		// only the descriptor indexing features used by the bindless texture array, and indirect count draws.
+		// the 1.2 struct can't be chained together with the descriptor indexing one
+		const bool bindless{ physicalDevice->supportsBindless() };
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType											= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.runtimeDescriptorArray							= bindless;
+		vulkan12Features.descriptorBindingPartiallyBound				= bindless;
+		vulkan12Features.descriptorBindingSampledImageUpdateAfterBind	= bindless;
+		vulkan12Features.descriptorBindingUpdateUnusedWhilePending		= bindless;
+		vulkan12Features.shaderSampledImageArrayNonUniformIndexing		= bindless;
+		vulkan12Features.drawIndirectCount								= physicalDevice->supportsDrawIndirectCount();
+
+		// render passes without render pass and framebuffer objects, only supported from 1.2 on
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+		dynamicRenderingFeatures.sType				= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+		dynamicRenderingFeatures.dynamicRendering	= VK_TRUE;
+		vulkan12Features.pNext = physicalDevice->supportsDynamicRendering() ? &dynamicRenderingFeatures : nullptr;
 
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType					= VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -40,6 +65,7 @@ namespace ash
 		createInfo.pEnabledFeatures			= &deviceFeatures;
 		createInfo.enabledExtensionCount	= static_cast<uint32_t>(physicalDevice->getDeviceExtensions().size());
 		createInfo.ppEnabledExtensionNames	= physicalDevice->getDeviceExtensions().data();
+		createInfo.pNext					= physicalDevice->getProperties().apiVersion >= VK_API_VERSION_1_2 ? &vulkan12Features : nullptr;
 
 		if (instance->isValidationEnabled)
 		{
@@ -59,14 +85,46 @@ namespace ash
 		vkGetDeviceQueue(m_device, physicalDevice->getQueueFamilyIndices().presentFamily.value(), 0, &m_presentQueue);
 
 		createCommandPool(physicalDevice);
+
+		// fall back to the graphics queue when there is no transfer family
+		m_transferQueue			= m_graphicsQueue;
+		m_transferCommandPool	= m_commandPool;
+		if (hasTransferQueue())
+		{
+			vkGetDeviceQueue(m_device, m_transferFamily, 0, &m_transferQueue);
+			m_transferCommandPool = createCommandPool(m_transferFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		}
+
+		m_allocator		= std::make_unique<MemoryAllocator>(m_device, physicalDevice);
+		m_stagingRing	= std::make_unique<StagingRing>(this, physicalDevice, stagingRingSize);
 	}
 
 	LogicalDevice::~LogicalDevice()
 	{
+		if (hasTransferQueue())
+		{
+			vkDestroyCommandPool(m_device, m_transferCommandPool, nullptr);
+		}
 		vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+		m_stagingRing = nullptr;
+		m_allocator = nullptr;
 		vkDestroyDevice(m_device, nullptr);
 	}
 
+	VkMemoryPropertyFlags LogicalDevice::getDeviceLocalProperties() const
+	{
+		return m_directWrite
+			? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			: VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	}
+
+	VkMemoryPropertyFlags LogicalDevice::getHostWriteProperties() const
+	{
+		return m_directWrite
+			? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			: VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+
 	const VkCommandBuffer LogicalDevice::beginSingleTimeCommand() const
 	{
 		VkCommandBufferAllocateInfo allocInfo{};
@@ -104,17 +162,22 @@ namespace ash
 
 	void LogicalDevice::createCommandPool(const PhysicalDevice* physicalDevice)
 	{
-		const PhysicalDevice::QueueFamilyIndices& queueFamilyIndices = physicalDevice->getQueueFamilyIndices();
+		m_commandPool = createCommandPool(physicalDevice->getQueueFamilyIndices().graphicsFamily.value(),
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	}
 
+	VkCommandPool LogicalDevice::createCommandPool(uint32_t queueFamily, VkCommandPoolCreateFlags flags)
+	{
 		VkCommandPoolCreateInfo poolInfo{};
 		poolInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.queueFamilyIndex	= queueFamilyIndices.graphicsFamily.value();
-		poolInfo.flags				= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT 
-									| VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex	= queueFamily;
+		poolInfo.flags				= flags;
 
-		if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+		VkCommandPool commandPool{};
+		if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to create command pool!");
 		}
+		return commandPool;
 	}
 }
\ No newline at end of file
@@ -7,13 +7,17 @@
 
 #include "Vulkan\Instance.h"
 #include "Vulkan\PhysicalDevice.h"
+#include "Vulkan\MemoryAllocator.h"
 
 #include <vulkan/vulkan.h>
 
+#include <memory>
 #include <vector>
 
 namespace ash
 {
+	class StagingRing;
+
 	/**
 	 * Wrapper for Vulkan Logical Device
 	 */
@@ -21,7 +25,11 @@ namespace ash
 	{
 	public:
 
-		LogicalDevice(const Instance* instance, const PhysicalDevice* physicalDevice);
+		/**
+		 * @param stagingRingSize in bytes of the ring all uploads are staged in
+		 * @param directWrite place device local buffers in host visible memory and write them directly
+		 */
+		LogicalDevice(const Instance* instance, const PhysicalDevice* physicalDevice, VkDeviceSize stagingRingSize, bool directWrite);
 
 		~LogicalDevice();
 
@@ -50,6 +58,57 @@ namespace ash
 		 */
 		const VkCommandPool& getCommandPool() const { return m_commandPool; }
 
+		/**
+		 * True when uploads have their own queue family, otherwise the transfer
+		 * getters return the graphics queue and pool
+		 */
+		bool hasTransferQueue() const { return m_transferFamily != m_graphicsFamily; }
+
+		/**
+		 * Returns Transfer Queue, used for uploads
+		 */
+		const VkQueue& getTransferQueue() const { return m_transferQueue; }
+
+		/**
+		 * Returns Command Pool of the transfer queue family
+		 */
+		const VkCommandPool& getTransferCommandPool() const { return m_transferCommandPool; }
+
+		/**
+		 * Returns queue family index of the graphics queue
+		 */
+		uint32_t getGraphicsFamily() const { return m_graphicsFamily; }
+
+		/**
+		 * Returns queue family index of the transfer queue
+		 */
+		uint32_t getTransferFamily() const { return m_transferFamily; }
+
+		/**
+		 * Returns the allocator all buffer and image memory comes from
+		 */
+		MemoryAllocator& getAllocator() const { return *m_allocator; }
+
+		/**
+		 * Returns the ring all upload data is staged in
+		 */
+		StagingRing& getStagingRing() const { return *m_stagingRing; }
+
+		/**
+		 * True when device local buffers are host visible and uploads write them directly
+		 */
+		bool usesDirectWrite() const { return m_directWrite; }
+
+		/**
+		 * Memory properties for device local buffers filled by uploads, also host visible when direct write is used
+		 */
+		VkMemoryPropertyFlags getDeviceLocalProperties() const;
+
+		/**
+		 * Memory properties for buffers the CPU writes every frame, also device local when direct write is used
+		 */
+		VkMemoryPropertyFlags getHostWriteProperties() const;
+
 		/**
 		 * Returns a command buffer that's started recording
 		 */
@@ -82,9 +141,46 @@ namespace ash
 		 */
 		VkCommandPool m_commandPool{};
 
+		/**
+		 * Vulkan Queue, used for uploads, same as the graphics queue without a transfer family
+		 */
+		VkQueue m_transferQueue{};
+
+		/**
+		 * Vulkan Command Pool for the transfer queue, same as m_commandPool without a transfer family
+		 */
+		VkCommandPool m_transferCommandPool{};
+
+		/**
+		 * Queue family indices of the graphics and transfer queues
+		 */
+		uint32_t m_graphicsFamily{ 0 };
+
+		uint32_t m_transferFamily{ 0 };
+
+		/**
+		 * True when device local buffers are host visible and uploads write them directly
+		 */
+		bool m_directWrite{ false };
+
+		/**
+		 * Sub-allocates device memory, destroyed before the device
+		 */
+		std::unique_ptr<MemoryAllocator> m_allocator{};
+
+		/**
+		 * Staging memory for uploads, allocated from m_allocator and destroyed before it
+		 */
+		std::unique_ptr<StagingRing> m_stagingRing{};
+
 		/**
 		 * Create Vulkan Command Pool
 		 */
 		void createCommandPool(const PhysicalDevice* physicalDevice);
+
+		/**
+		 * Create a Vulkan Command Pool for the provided queue family
+		 */
+		VkCommandPool createCommandPool(uint32_t queueFamily, VkCommandPoolCreateFlags flags);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+/**
+* Material parameters stored in the bindless material buffer, laid out to match std430
+*
+* Copyright (C) 2021, Jesse Springborn
+*/
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace ash
+{
+	/**
+	 * Material parameters stored in the bindless material buffer, laid out to match std430.
+	 * Texture members are indices into the bindless texture array, -1 when unused
+	 */
+	struct MaterialData
+	{
+		glm::vec4	baseColorFactor				{ 1.0f };
+		glm::vec4	emissiveFactor				{ 0.0f };	// rgb used, a is padding
+		float		metallicFactor				{ 1.0f };
+		float		roughnessFactor				{ 1.0f };
+		float		alphaCutoff					{ 0.5f };
+		int32_t		baseColorTexture			{ -1 };
+		int32_t		metallicRoughnessTexture	{ -1 };
+		int32_t		normalTexture				{ -1 };
+		int32_t		occlusionTexture			{ -1 };
+		int32_t		emissiveTexture				{ -1 };
+	};
+
+	static_assert(sizeof(MaterialData) == 64, "MaterialData must match the std430 layout in bindless.frag");
+}
@@ -0,0 +1,442 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/MemoryAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace ash
+{
+	namespace
+	{
+		/**
+		 * Size of new blocks on heaps larger than 1 GiB
+		 */
+		constexpr VkDeviceSize LARGE_HEAP_BLOCK_SIZE{ 64ull * 1024 * 1024 };
+
+		constexpr double MiB{ 1024.0 * 1024.0 };
+	}
+
+	const char* getMemoryCategoryName(MemoryCategory category)
+	{
+		switch (category)
+		{
+		case MemoryCategory::Geometry:		return "geometry";
+		case MemoryCategory::Texture:		return "textures";
+		case MemoryCategory::RenderTarget:	return "render targets";
+		case MemoryCategory::Staging:		return "staging";
+		case MemoryCategory::Dynamic:		return "dynamic";
+		default:							return "other";
+		}
+	}
+
+	MemoryAllocator::MemoryAllocator(VkDevice device, const PhysicalDevice* physicalDevice) :
+		m_device{ device }, m_physicalDevice{ physicalDevice }
+	{
+		m_supportsDedicatedQuery	= physicalDevice->getProperties().apiVersion >= VK_API_VERSION_1_1;
+		m_shareLinearAndOptimal		= physicalDevice->getProperties().limits.bufferImageGranularity <= 1;
+
+		const VkPhysicalDeviceMemoryProperties& memoryProperties{ physicalDevice->getMemoryProperties() };
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			VkDeviceSize heapSize{ memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size };
+			m_blockSizes[i] = std::min(LARGE_HEAP_BLOCK_SIZE, heapSize / 8);
+		}
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+		for (auto& blocks : m_blocks)
+		{
+			for (auto& block : blocks)
+			{
+				vkFreeMemory(m_device, block->memory, nullptr);	// also unmaps
+			}
+		}
+	}
+
+	MemoryAllocation MemoryAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryCategory category)
+	{
+		VkMemoryRequirements	requirements{};
+		bool					dedicated{ false };
+
+		if (m_supportsDedicatedQuery)
+		{
+			VkBufferMemoryRequirementsInfo2 info{};
+			info.sType	= VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+			info.buffer	= buffer;
+
+			VkMemoryDedicatedRequirements dedicatedRequirements{};
+			dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+			VkMemoryRequirements2 requirements2{};
+			requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+			requirements2.pNext = &dedicatedRequirements;
+
+			vkGetBufferMemoryRequirements2(m_device, &info, &requirements2);
+			requirements	= requirements2.memoryRequirements;
+			dedicated		= dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+		}
+		else
+		{
+			vkGetBufferMemoryRequirements(m_device, buffer, &requirements);
+		}
+
+		VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+		dedicatedInfo.sType		= VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.buffer	= buffer;
+
+		MemoryAllocation allocation{ allocate(requirements, properties, true, dedicated,
+			m_supportsDedicatedQuery ? &dedicatedInfo : nullptr, category) };
+
+		if (vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+		{
+			free(allocation);
+			throw std::runtime_error("failed to bind buffer memory!");
+		}
+		return allocation;
+	}
+
+	MemoryAllocation MemoryAllocator::allocateImage(VkImage image, VkMemoryPropertyFlags properties, bool linear, MemoryCategory category)
+	{
+		VkMemoryRequirements	requirements{};
+		bool					dedicated{ false };
+
+		if (m_supportsDedicatedQuery)
+		{
+			VkImageMemoryRequirementsInfo2 info{};
+			info.sType	= VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+			info.image	= image;
+
+			VkMemoryDedicatedRequirements dedicatedRequirements{};
+			dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+			VkMemoryRequirements2 requirements2{};
+			requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+			requirements2.pNext = &dedicatedRequirements;
+
+			vkGetImageMemoryRequirements2(m_device, &info, &requirements2);
+			requirements	= requirements2.memoryRequirements;
+			dedicated		= dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+		}
+		else
+		{
+			vkGetImageMemoryRequirements(m_device, image, &requirements);
+		}
+
+		VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+		dedicatedInfo.sType	= VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.image	= image;
+
+		MemoryAllocation allocation{ allocate(requirements, properties, linear, dedicated,
+			m_supportsDedicatedQuery ? &dedicatedInfo : nullptr, category) };
+
+		if (vkBindImageMemory(m_device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+		{
+			free(allocation);
+			throw std::runtime_error("failed to bind image memory!");
+		}
+		return allocation;
+	}
+
+	void MemoryAllocator::free(MemoryAllocation& allocation)
+	{
+		if (allocation.memory == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		m_categoryBytes[static_cast<size_t>(allocation.category)] -= allocation.size;
+
+		if (!allocation.block)
+		{
+			vkFreeMemory(m_device, allocation.memory, nullptr);
+			m_dedicatedCount--;
+			m_dedicatedBytes -= allocation.size;
+			m_heapBytes[allocation.heapIndex] -= allocation.size;
+			allocation = MemoryAllocation{};
+			return;
+		}
+
+		MemoryBlock* block{ allocation.block };
+		block->allocator.free(allocation.node);
+		allocation = MemoryAllocation{};
+
+		// keep one empty block per list around so loading doesn't thrash vkAllocateMemory
+		if (block->allocator.getAllocationCount() == 0)
+		{
+			for (auto& blocks : m_blocks)
+			{
+				auto found{ std::find_if(blocks.begin(), blocks.end(),
+					[block](const std::unique_ptr<MemoryBlock>& candidate) { return candidate.get() == block; }) };
+
+				if (found != blocks.end())
+				{
+					if (blocks.size() > 1)
+					{
+						m_heapBytes[getHeapIndex(block->memoryTypeIndex)] -= block->allocator.getSize();
+						vkFreeMemory(m_device, block->memory, nullptr);
+						blocks.erase(found);
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	void MemoryAllocator::addEvictionHandler(EvictionHandler handler)
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_evictionHandlers.push_back(std::move(handler));
+	}
+
+	MemoryStats MemoryAllocator::getStats() const
+	{
+		PhysicalDevice::MemoryBudget budget{ m_physicalDevice->queryMemoryBudget() };
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		MemoryStats stats{};
+		for (const auto& blocks : m_blocks)
+		{
+			for (const auto& block : blocks)
+			{
+				stats.blockCount++;
+				stats.allocationCount	+= block->allocator.getAllocationCount();
+				stats.blockBytes		+= block->allocator.getSize();
+				stats.usedBytes			+= block->allocator.getUsedSize();
+			}
+		}
+		stats.dedicatedAllocationCount	= m_dedicatedCount;
+		stats.dedicatedBytes			= m_dedicatedBytes;
+		stats.allocationCount			+= m_dedicatedCount;
+		stats.categoryBytes				= m_categoryBytes;
+		stats.evictionCount				= m_evictionCount;
+
+		// without the extension our own allocations are the best estimate of usage
+		stats.heapCount = m_physicalDevice->getMemoryProperties().memoryHeapCount;
+		for (uint32_t i = 0; i < stats.heapCount; i++)
+		{
+			stats.heapBytes[i]	= m_heapBytes[i];
+			stats.heapBudget[i]	= budget.budget[i];
+			stats.heapUsage[i]	= budget.fromExtension ? budget.usage[i] : m_heapBytes[i];
+		}
+
+		return stats;
+	}
+
+	void MemoryAllocator::printStats() const
+	{
+		MemoryStats stats{ getStats() };
+
+		std::cout << "GPU memory: " << stats.allocationCount << " allocations, "
+			<< stats.blockCount << " blocks (" << stats.usedBytes / MiB << " / " << stats.blockBytes / MiB << " MiB used), "
+			<< stats.dedicatedAllocationCount << " dedicated (" << stats.dedicatedBytes / MiB << " MiB), "
+			<< stats.evictionCount << " over budget" << '\n';
+
+		for (size_t i = 0; i < stats.categoryBytes.size(); i++)
+		{
+			std::cout << "  " << getMemoryCategoryName(static_cast<MemoryCategory>(i)) << ": "
+				<< stats.categoryBytes[i] / MiB << " MiB" << '\n';
+		}
+
+		for (uint32_t i = 0; i < stats.heapCount; i++)
+		{
+			std::cout << "  heap " << i << ": " << stats.heapBytes[i] / MiB << " MiB allocated, "
+				<< stats.heapUsage[i] / MiB << " / " << stats.heapBudget[i] / MiB << " MiB of budget used" << '\n';
+		}
+	}
+
+	MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+		bool linear, bool dedicated, const VkMemoryDedicatedAllocateInfo* dedicatedInfo, MemoryCategory category)
+	{
+		uint32_t memoryTypeIndex{ m_physicalDevice->findMemoryType(requirements.memoryTypeBits, properties) };
+		uint32_t heapIndex{ getHeapIndex(memoryTypeIndex) };
+
+		MemoryAllocation allocation{};
+		allocation.size			= requirements.size;
+		allocation.heapIndex	= heapIndex;
+		allocation.category		= category;
+
+		// resources bigger than half a block would waste most of a new block
+		bool useDedicated{ dedicated || requirements.size > m_blockSizes[memoryTypeIndex] / 2 };
+		auto& blocks{ m_blocks[memoryTypeIndex * 2 + ((linear || m_shareLinearAndOptimal) ? 0 : 1)] };
+
+		if (!useDedicated)
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			if (allocateFromBlocks(blocks, requirements, allocation))
+			{
+				m_categoryBytes[static_cast<size_t>(category)] += allocation.size;
+				return allocation;
+			}
+		}
+
+		// new device memory is needed, make room for it first
+		ensureBudget(heapIndex, useDedicated ? requirements.size : m_blockSizes[memoryTypeIndex]);
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		if (useDedicated)
+		{
+			allocation.memory = allocateMemory(requirements.size, memoryTypeIndex, dedicatedInfo, &allocation.mappedData);
+
+			m_dedicatedCount++;
+			m_dedicatedBytes += requirements.size;
+			m_heapBytes[heapIndex] += requirements.size;
+			m_categoryBytes[static_cast<size_t>(category)] += requirements.size;
+			return allocation;
+		}
+
+		// another thread may have added a block while the lock was released
+		if (!allocateFromBlocks(blocks, requirements, allocation))
+		{
+			auto newBlock{ std::make_unique<MemoryBlock>(m_blockSizes[memoryTypeIndex]) };
+			newBlock->memory			= allocateMemory(m_blockSizes[memoryTypeIndex], memoryTypeIndex, nullptr, &newBlock->mappedData);
+			newBlock->memoryTypeIndex	= memoryTypeIndex;
+			blocks.push_back(std::move(newBlock));
+			m_heapBytes[heapIndex] += m_blockSizes[memoryTypeIndex];
+
+			allocateFromBlocks(blocks, requirements, allocation);
+		}
+
+		m_categoryBytes[static_cast<size_t>(category)] += allocation.size;
+		return allocation;
+	}
+
+	bool MemoryAllocator::allocateFromBlocks(std::vector<std::unique_ptr<MemoryBlock>>& blocks,
+		const VkMemoryRequirements& requirements, MemoryAllocation& allocation)
+	{
+		for (auto& block : blocks)
+		{
+			TlsfAllocator::Allocation range{ block->allocator.allocate(requirements.size, requirements.alignment) };
+			if (range.node == TlsfAllocator::INVALID_NODE)
+			{
+				continue;
+			}
+
+			allocation.memory	= block->memory;
+			allocation.offset	= range.offset;
+			allocation.block	= block.get();
+			allocation.node		= range.node;
+			if (block->mappedData)
+			{
+				allocation.mappedData = static_cast<char*>(block->mappedData) + range.offset;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void MemoryAllocator::ensureBudget(uint32_t heapIndex, VkDeviceSize bytes)
+	{
+		PhysicalDevice::MemoryBudget budget{ m_physicalDevice->queryMemoryBudget() };
+		VkDeviceSize limit{ static_cast<VkDeviceSize>(budget.budget[heapIndex] * BUDGET_THRESHOLD) };
+
+		VkDeviceSize usage{};
+		std::vector<EvictionHandler> handlers{};
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+
+			usage = budget.fromExtension ? budget.usage[heapIndex] : m_heapBytes[heapIndex];
+			if (usage + bytes <= limit)
+			{
+				return;
+			}
+			m_evictionCount++;
+
+			// cached empty blocks are the cheapest memory to give back
+			usage -= std::min(usage, releaseEmptyBlocks(heapIndex));
+			if (!m_evicting)
+			{
+				handlers	= m_evictionHandlers;
+				m_evicting	= !handlers.empty();
+			}
+		}
+
+		// handlers destroy resources, which calls back into free, so run them unlocked
+		for (auto& handler : handlers)
+		{
+			if (usage + bytes <= limit)
+			{
+				break;
+			}
+			usage -= std::min(usage, handler(heapIndex, usage + bytes - limit));
+		}
+
+		if (!handlers.empty())
+		{
+			// resources freed by the handlers may have emptied blocks
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			releaseEmptyBlocks(heapIndex);
+			m_evicting = false;
+		}
+
+		if (usage + bytes > limit)
+		{
+			std::cout << "warning: GPU memory heap " << heapIndex << " over budget, "
+				<< (usage + bytes) / MiB << " / " << budget.budget[heapIndex] / MiB << " MiB" << '\n';
+		}
+	}
+
+	VkDeviceSize MemoryAllocator::releaseEmptyBlocks(uint32_t heapIndex)
+	{
+		VkDeviceSize released{ 0 };
+		for (auto& blocks : m_blocks)
+		{
+			auto empty{ std::remove_if(blocks.begin(), blocks.end(), [&](const std::unique_ptr<MemoryBlock>& block)
+				{
+					if (getHeapIndex(block->memoryTypeIndex) != heapIndex || block->allocator.getAllocationCount() != 0)
+					{
+						return false;
+					}
+					released += block->allocator.getSize();
+					vkFreeMemory(m_device, block->memory, nullptr);
+					return true;
+				}) };
+			blocks.erase(empty, blocks.end());
+		}
+
+		m_heapBytes[heapIndex] -= released;
+		return released;
+	}
+
+	VkDeviceMemory MemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, const void* pNext, void** mappedData)
+	{
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.pNext				= pNext;
+		allocInfo.allocationSize	= size;
+		allocInfo.memoryTypeIndex	= memoryTypeIndex;
+
+		VkDeviceMemory memory{};
+		if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate device memory!");
+		}
+
+		// host visible memory stays mapped for its whole lifetime
+		*mappedData = nullptr;
+		if (isHostVisible(memoryTypeIndex) && vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS)
+		{
+			vkFreeMemory(m_device, memory, nullptr);
+			throw std::runtime_error("failed to map device memory!");
+		}
+		return memory;
+	}
+
+	uint32_t MemoryAllocator::getHeapIndex(uint32_t memoryTypeIndex) const
+	{
+		return m_physicalDevice->getMemoryProperties().memoryTypes[memoryTypeIndex].heapIndex;
+	}
+
+	bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const
+	{
+		return (m_physicalDevice->getMemoryProperties().memoryTypes[memoryTypeIndex].propertyFlags
+			& VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+}
@@ -0,0 +1,263 @@
+/**
+ * Sub-allocates Vulkan device memory for buffers and images
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan\PhysicalDevice.h"
+#include "Utils/TlsfAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * A large VkDeviceMemory allocation that buffers and images are placed in
+	 */
+	struct MemoryBlock
+	{
+		VkDeviceMemory	memory			{};
+		TlsfAllocator	allocator;
+		void*			mappedData		{};		// persistently mapped when the memory type is host visible
+		uint32_t		memoryTypeIndex	{ 0 };
+
+		MemoryBlock(VkDeviceSize size) : allocator{ size } {}
+	};
+
+	/**
+	 * What a resource is used for, allocations are tracked per category
+	 */
+	enum class MemoryCategory : uint32_t
+	{
+		Geometry,		// vertex and index data
+		Texture,		// sampled images loaded from assets
+		RenderTarget,	// attachments sized to the swap chain
+		Staging,		// upload buffers
+		Dynamic,		// per frame host written data
+		Other,
+		Count
+	};
+
+	/**
+	 * Returns a printable name for the category
+	 */
+	const char* getMemoryCategoryName(MemoryCategory category);
+
+	/**
+	 * Memory bound to a single buffer or image
+	 */
+	struct MemoryAllocation
+	{
+		VkDeviceMemory	memory		{};
+		VkDeviceSize	offset		{ 0 };
+		VkDeviceSize	size		{ 0 };
+		void*			mappedData	{};		// points at offset, null unless the memory is host visible
+		MemoryBlock*	block		{};		// null for dedicated allocations
+		uint32_t		node		{ TlsfAllocator::INVALID_NODE };
+		uint32_t		heapIndex	{ 0 };
+		MemoryCategory	category	{ MemoryCategory::Other };
+	};
+
+	/**
+	 * Totals reported by MemoryAllocator::getStats
+	 */
+	struct MemoryStats
+	{
+		uint32_t		blockCount					{ 0 };
+		uint32_t		allocationCount				{ 0 };
+		uint32_t		dedicatedAllocationCount	{ 0 };
+		VkDeviceSize	blockBytes					{ 0 };
+		VkDeviceSize	usedBytes					{ 0 };
+		VkDeviceSize	dedicatedBytes				{ 0 };
+
+		// bytes bound to resources of every category
+		std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryBytes{};
+
+		// per heap: device memory allocated by us, the budget and the usage of the process
+		uint32_t										heapCount	{ 0 };
+		std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS>	heapBytes	{};
+		std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS>	heapBudget	{};
+		std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS>	heapUsage	{};
+
+		// times a heap went over budget and eviction ran
+		uint32_t										evictionCount{ 0 };
+	};
+
+	/**
+	 * Sub-allocates Vulkan device memory for buffers and images.
+	 * Each memory type gets a list of large blocks split with a TLSF allocator, so
+	 * vkAllocateMemory is only called when a block fills up. Buffers and optimal images
+	 * use separate blocks when the device's bufferImageGranularity requires it.
+	 * Large resources, and ones the driver asks for, get dedicated allocations.
+	 * Before new device memory is allocated the heap's budget is checked, when it would be
+	 * exceeded cached empty blocks are released and then the eviction handlers are asked
+	 * to free streamable resources
+	 */
+	class MemoryAllocator
+	{
+	public:
+		/**
+		 * Asked to free at least bytesNeeded on the heap, returns the number of bytes it released.
+		 * Called without the allocator locked so it may destroy and create resources, allocations
+		 * made by a handler never run the handlers again
+		 */
+		using EvictionHandler = std::function<VkDeviceSize(uint32_t heapIndex, VkDeviceSize bytesNeeded)>;
+
+		/**
+		 * Fraction of the budget new device memory may fill before eviction starts
+		 */
+		static constexpr double BUDGET_THRESHOLD{ 0.9 };
+
+	public:
+		MemoryAllocator(VkDevice device, const PhysicalDevice* physicalDevice);
+		~MemoryAllocator();
+
+		/**
+		 * Allocates memory for the buffer and binds it
+		 */
+		MemoryAllocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryCategory category);
+
+		/**
+		 * Allocates memory for the image and binds it
+		 * @param linear true for VK_IMAGE_TILING_LINEAR images
+		 */
+		MemoryAllocation allocateImage(VkImage image, VkMemoryPropertyFlags properties, bool linear, MemoryCategory category);
+
+		/**
+		 * Returns the memory to its block, or frees it when dedicated
+		 */
+		void free(MemoryAllocation& allocation);
+
+		/**
+		 * Registers a handler that frees resources when a heap runs over budget
+		 */
+		void addEvictionHandler(EvictionHandler handler);
+
+		/**
+		 * Totals over all blocks and dedicated allocations, with the current budget of every heap
+		 */
+		MemoryStats getStats() const;
+
+		/**
+		 * Writes the stats to std::cout
+		 */
+		void printStats() const;
+
+	private:
+
+		/**
+		 * Vulkan Logical Device, used for allocation and resource destruction
+		 */
+		VkDevice m_device{};
+
+		/**
+		 * Used to pick memory types and read device limits
+		 */
+		const PhysicalDevice* m_physicalDevice{};
+
+		/**
+		 * True when vkGet*MemoryRequirements2 can report dedicated allocation preferences
+		 */
+		bool m_supportsDedicatedQuery{ false };
+
+		/**
+		 * True when buffers and optimal images can share a block without padding
+		 */
+		bool m_shareLinearAndOptimal{ false };
+
+		/**
+		 * Size of new blocks for every memory type, smaller on small heaps
+		 */
+		std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> m_blockSizes{};
+
+		/**
+		 * Blocks for every memory type, two lists per type: linear resources then optimal images
+		 */
+		std::array<std::vector<std::unique_ptr<MemoryBlock>>, VK_MAX_MEMORY_TYPES * 2> m_blocks{};
+
+		/**
+		 * Number and size of live dedicated allocations
+		 */
+		uint32_t m_dedicatedCount{ 0 };
+
+		VkDeviceSize m_dedicatedBytes{ 0 };
+
+		/**
+		 * Bytes bound to resources of every category
+		 */
+		std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> m_categoryBytes{};
+
+		/**
+		 * Device memory allocated on every heap, blocks and dedicated allocations
+		 */
+		std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> m_heapBytes{};
+
+		/**
+		 * Number of times a heap went over budget and eviction ran
+		 */
+		uint32_t m_evictionCount{ 0 };
+
+		/**
+		 * Called in order when a heap runs over budget
+		 */
+		std::vector<EvictionHandler> m_evictionHandlers{};
+
+		/**
+		 * True while the handlers run, the resources they create don't evict again
+		 */
+		bool m_evicting{ false };
+
+		/**
+		 * Guards the blocks, loading may allocate from several threads
+		 */
+		mutable std::mutex m_mutex{};
+
+		/**
+		 * Picks a block (or dedicated memory) for the requirements, binding is left to the caller
+		 * @param dedicatedInfo chained into vkAllocateMemory when a dedicated allocation is made, may be null
+		 */
+		MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+			bool linear, bool dedicated, const VkMemoryDedicatedAllocateInfo* dedicatedInfo, MemoryCategory category);
+
+		/**
+		 * Tries to sub-allocate from the existing blocks of the list, m_mutex must be held
+		 * @return false when no block has room
+		 */
+		bool allocateFromBlocks(std::vector<std::unique_ptr<MemoryBlock>>& blocks,
+			const VkMemoryRequirements& requirements, MemoryAllocation& allocation);
+
+		/**
+		 * Makes room for bytes of new device memory on the heap when it would go over budget,
+		 * m_mutex must not be held
+		 */
+		void ensureBudget(uint32_t heapIndex, VkDeviceSize bytes);
+
+		/**
+		 * Frees the cached empty blocks of the heap, m_mutex must be held
+		 * @return the number of bytes released
+		 */
+		VkDeviceSize releaseEmptyBlocks(uint32_t heapIndex);
+
+		/**
+		 * Allocates a new VkDeviceMemory, mapping it when host visible
+		 */
+		VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, const void* pNext, void** mappedData);
+
+		/**
+		 * Heap the memory type allocates from
+		 */
+		uint32_t getHeapIndex(uint32_t memoryTypeIndex) const;
+
+		/**
+		 * True when the memory type is host visible
+		 */
+		bool isHostVisible(uint32_t memoryTypeIndex) const;
+	};
+}
@@ -3,6 +3,8 @@
  */
 #include "Vulkan\PhysicalDevice.h"
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <vector>
 #include <set>
@@ -41,6 +43,10 @@ namespace ash
 		vkGetPhysicalDeviceProperties(m_physicalDevice, &m_properties);
 		vkGetPhysicalDeviceFeatures(m_physicalDevice, &m_features);
 		vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+		queryDescriptorIndexingSupport();
+		queryIndirectDrawSupport();
+		selectExtensions();
+		findDirectWriteMemory();
 		queueFamilyIndices = findQueueFamilies(m_physicalDevice, *surface);
 		swapChainsSupportDetails = querySwapChainSupport(m_physicalDevice, *surface);
 	}
@@ -51,12 +57,10 @@ namespace ash
 
 	const uint32_t PhysicalDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
 	{
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
-
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+		// memory properties are queried once in the constructor
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
 		{
-			if ( (typeFilter & (1 << i)) && ((memProperties.memoryTypes[i].propertyFlags & properties) == properties) )
+			if ( (typeFilter & (1 << i)) && ((m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) )
 			{
 				return i;
 			}
@@ -65,6 +69,63 @@ namespace ash
 		throw std::runtime_error("failed to find suitable memory type!");
 	}
 
+	bool PhysicalDevice::supportsBindless() const
+	{
+		return m_descriptorIndexingFeatures.runtimeDescriptorArray
+			&& m_descriptorIndexingFeatures.descriptorBindingPartiallyBound
+			&& m_descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+			&& m_descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending
+			&& m_descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+	}
+
+	PhysicalDevice::MemoryBudget PhysicalDevice::queryMemoryBudget() const
+	{
+		MemoryBudget result{};
+
+		// the budget query needs the 1.1 properties2 entry point as well as the extension
+		if (m_supportsMemoryBudget && m_properties.apiVersion >= VK_API_VERSION_1_1)
+		{
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+			budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+			VkPhysicalDeviceMemoryProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			properties.pNext = &budget;
+			vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &properties);
+
+			for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+			{
+				result.budget[i]	= budget.heapBudget[i];
+				result.usage[i]		= budget.heapUsage[i];
+			}
+			result.fromExtension = true;
+			return result;
+		}
+
+		// without the extension assume the rest of the system leaves us 80% of every heap
+		for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+		{
+			result.budget[i] = m_memoryProperties.memoryHeaps[i].size / 5 * 4;
+		}
+		return result;
+	}
+
+	bool PhysicalDevice::prefersDirectWrite() const
+	{
+		// without resizable BAR discrete GPUs only map a 256 MiB window, too small to hold static data
+		constexpr VkDeviceSize BAR_WINDOW_SIZE{ 256ull * 1024 * 1024 };
+
+		if (!supportsDirectWrite())
+		{
+			return false;
+		}
+
+		bool unified{ m_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU
+			|| m_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU };
+
+		return unified || m_directWriteHeapSize > BAR_WINDOW_SIZE;
+	}
+
 	const VkFormat PhysicalDevice::findDepthFormat() const
 	{
 		return findSupportedFormat(
@@ -145,9 +206,84 @@ namespace ash
 			++index;
 		}
 
+		// a family without graphics lets uploads run beside rendering, prefer one without compute as well.
+		// copies of arbitrary image sizes need a transfer granularity of a single texel
+		for (uint32_t i = 0; i < queueFamilyCount; i++)
+		{
+			const VkQueueFamilyProperties&	family		{ queueFamilies[i] };
+			const VkExtent3D&				granularity	{ family.minImageTransferGranularity };
+
+			bool transferOnly	{ (family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT) };
+			bool fineGrained	{ granularity.width == 1 && granularity.height == 1 && granularity.depth == 1 };
+			if (!transferOnly || !fineGrained)
+			{
+				continue;
+			}
+
+			if (!indices.transferFamily.has_value() || !(family.queueFlags & VK_QUEUE_COMPUTE_BIT))
+			{
+				indices.transferFamily = i;
+			}
+		}
+
 		return indices;
 	}
 
+	void PhysicalDevice::queryDescriptorIndexingSupport()
+	{
+		m_descriptorIndexingFeatures.sType		= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		m_descriptorIndexingProperties.sType	= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+		// descriptor indexing is core since 1.2, older devices keep everything unsupported
+		if (m_properties.apiVersion < VK_API_VERSION_1_2)
+		{
+			return;
+		}
+
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &m_descriptorIndexingFeatures;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features);
+
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &m_descriptorIndexingProperties;
+		vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
+
+		// the structs are kept around, don't leave them pointing at the stack
+		m_descriptorIndexingFeatures.pNext		= nullptr;
+		m_descriptorIndexingProperties.pNext	= nullptr;
+	}
+
+	void PhysicalDevice::queryIndirectDrawSupport()
+	{
+		if (m_properties.apiVersion < VK_API_VERSION_1_2)
+		{
+			return;
+		}
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &vulkan12Features;
+		vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features);
+
+		m_supportsDrawIndirectCount = vulkan12Features.drawIndirectCount;
+	}
+
+	bool PhysicalDevice::supportsGpuCulling() const
+	{
+		uint32_t queueFamilyCount{ 0 };
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		uint32_t graphicsFamily{ queueFamilyIndices.graphicsFamily.value() };
+		return m_features.drawIndirectFirstInstance && (queueFamilies[graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT);
+	}
+
 	bool PhysicalDevice::checkDeviceExtensionSupport(VkPhysicalDevice device)
 	{
 		uint32_t extensionCount;
@@ -165,6 +301,58 @@ namespace ash
 		return requiredExtensions.empty();	// if all empty all extensions were found
 	}
 
+	void PhysicalDevice::findDirectWriteMemory()
+	{
+		constexpr VkMemoryPropertyFlags DIRECT_WRITE_PROPERTIES{
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+
+		for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+		{
+			const VkMemoryType& type{ m_memoryProperties.memoryTypes[i] };
+			if ((type.propertyFlags & DIRECT_WRITE_PROPERTIES) == DIRECT_WRITE_PROPERTIES)
+			{
+				m_directWriteHeapSize = std::max(m_directWriteHeapSize, m_memoryProperties.memoryHeaps[type.heapIndex].size);
+			}
+		}
+	}
+
+	void PhysicalDevice::selectExtensions()
+	{
+		m_enabledExtensions = deviceExtensions;
+
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions)
+		{
+			if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+			{
+				m_supportsMemoryBudget = true;
+				m_enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			}
+			// the extension's dependencies are core since 1.2
+			if (strcmp(extension.extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0
+				&& m_properties.apiVersion >= VK_API_VERSION_1_2)
+			{
+				VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+				dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+				VkPhysicalDeviceFeatures2 features{};
+				features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+				features.pNext = &dynamicRenderingFeatures;
+				vkGetPhysicalDeviceFeatures2(m_physicalDevice, &features);
+
+				if (dynamicRenderingFeatures.dynamicRendering)
+				{
+					m_supportsDynamicRendering = true;
+					m_enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+				}
+			}
+		}
+	}
+
 	PhysicalDevice::SwapChainSupportDetails PhysicalDevice::querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) const
 	{
 		SwapChainSupportDetails details;
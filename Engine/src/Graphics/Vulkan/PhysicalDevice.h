@@ -10,6 +10,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include <array>
 #include <optional>
 #include <vector>
 
@@ -29,6 +30,9 @@ namespace ash
 			std::optional<uint32_t> graphicsFamily;
 			std::optional<uint32_t> presentFamily;
 
+			// transfer only family for uploads, empty when the GPU has none
+			std::optional<uint32_t> transferFamily;
+
 			bool isComplete()
 			{
 				return graphicsFamily.has_value() && presentFamily.has_value();
@@ -45,6 +49,18 @@ namespace ash
 			std::vector<VkPresentModeKHR> presentModes;
 		};
 
+		/**
+		 * Per heap memory budget, see queryMemoryBudget
+		 */
+		struct MemoryBudget
+		{
+			std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> budget{};
+			std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> usage{};
+
+			// false when VK_EXT_memory_budget is missing, budget is then estimated from the heap size and usage is 0
+			bool fromExtension{ false };
+		};
+
 	public:
 		PhysicalDevice(const Instance* instance, const Surface* surface);
 		~PhysicalDevice();
@@ -74,6 +90,59 @@ namespace ash
 		 */
 		const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return m_memoryProperties; }
 
+		/**
+		 * Returns struct containing the GPU's descriptor indexing features
+		 */
+		const VkPhysicalDeviceDescriptorIndexingFeatures& getDescriptorIndexingFeatures() const { return m_descriptorIndexingFeatures; }
+
+		/**
+		 * Returns struct containing the GPU's descriptor indexing limits
+		 */
+		const VkPhysicalDeviceDescriptorIndexingProperties& getDescriptorIndexingProperties() const { return m_descriptorIndexingProperties; }
+
+		/**
+		 * True if the GPU supports the descriptor indexing features needed for bindless textures
+		 */
+		bool supportsBindless() const;
+
+		/**
+		 * True if VK_EXT_memory_budget is enabled on the device
+		 */
+		bool supportsMemoryBudget() const { return m_supportsMemoryBudget; }
+
+		/**
+		 * True if the GPU supports vkCmdDrawIndexedIndirectCount, core since 1.2
+		 */
+		bool supportsDrawIndirectCount() const { return m_supportsDrawIndirectCount; }
+
+		/**
+		 * True if VK_KHR_dynamic_rendering is enabled on the device, render pass and framebuffer
+		 * objects can be left out
+		 */
+		bool supportsDynamicRendering() const { return m_supportsDynamicRendering; }
+
+		/**
+		 * True if draws can be culled by a compute shader on the graphics queue,
+		 * which needs indirect draws with a first instance
+		 */
+		bool supportsGpuCulling() const;
+
+		/**
+		 * Reads the current per heap budget and usage of this process from the driver
+		 */
+		MemoryBudget queryMemoryBudget() const;
+
+		/**
+		 * True if the GPU has device local memory the CPU can map
+		 */
+		bool supportsDirectWrite() const { return m_directWriteHeapSize > 0; }
+
+		/**
+		 * True if writing device local memory from the CPU is expected to beat staging:
+		 * integrated and CPU devices, or discrete GPUs exposing all of VRAM through resizable BAR
+		 */
+		bool prefersDirectWrite() const;
+
 		/**
 		 * NOT CURRENTLY IMPLEMENTED
 		 */
@@ -85,9 +154,9 @@ namespace ash
 		const QueueFamilyIndices& getQueueFamilyIndices() const { return queueFamilyIndices; }
 
 		/**
-		 * Returns struct containing the device's supported extensions
+		 * Returns the extensions to enable on the device, the required ones plus supported optional ones
 		 */
-		const std::vector<const char*>& getDeviceExtensions() const { return deviceExtensions; }
+		const std::vector<const char*>& getDeviceExtensions() const { return m_enabledExtensions; }
 
 		/**
 		 * Returns struct of swap chain support info for current Physical Device
@@ -131,6 +200,16 @@ namespace ash
 		 */
 		VkPhysicalDeviceFeatures m_features{};		
 
+		/**
+		 * Contains GPU supported descriptor indexing features, queried on Vulkan 1.2 devices
+		 */
+		VkPhysicalDeviceDescriptorIndexingFeatures m_descriptorIndexingFeatures{};
+
+		/**
+		 * Contains GPU descriptor indexing limits, queried on Vulkan 1.2 devices
+		 */
+		VkPhysicalDeviceDescriptorIndexingProperties m_descriptorIndexingProperties{};
+
 		/**
 		 * Contains GPU supported memory properties
 		 */
@@ -151,6 +230,31 @@ namespace ash
 		 */
 		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
+		/**
+		 * Required extensions plus the optional ones the selected GPU supports
+		 */
+		std::vector<const char*> m_enabledExtensions{};
+
+		/**
+		 * True when VK_EXT_memory_budget is enabled
+		 */
+		bool m_supportsMemoryBudget{ false };
+
+		/**
+		 * True when the GPU supports the drawIndirectCount feature
+		 */
+		bool m_supportsDrawIndirectCount{ false };
+
+		/**
+		 * True when VK_KHR_dynamic_rendering is enabled
+		 */
+		bool m_supportsDynamicRendering{ false };
+
+		/**
+		 * Size of the largest heap with host visible and coherent device local memory, 0 when there is none
+		 */
+		VkDeviceSize m_directWriteHeapSize{ 0 };
+
 		/**
 		 * Struct containing swap chain support info
 		 */
@@ -171,6 +275,26 @@ namespace ash
 		 */
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 
+		/**
+		 * Queries descriptor indexing features and limits, left zeroed on pre 1.2 devices
+		 */
+		void queryDescriptorIndexingSupport();
+
+		/**
+		 * Queries the drawIndirectCount feature, left unsupported on pre 1.2 devices
+		 */
+		void queryIndirectDrawSupport();
+
+		/**
+		 * Fills m_enabledExtensions with the required extensions and the optional ones the GPU supports
+		 */
+		void selectExtensions();
+
+		/**
+		 * Looks for device local memory the CPU can write directly
+		 */
+		void findDirectWriteMemory();
+
 		/**
 		 * Returns swap chain support info of provided GPU
 		 */
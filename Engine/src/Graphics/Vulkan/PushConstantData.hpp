@@ -21,5 +21,15 @@ namespace ash
 		 * Transform matrix, used to calculate 3D position
 		 */
 		glm::mat4 transform;
+
+		/**
+		 * Index into the bindless material buffer, unused by the per texture descriptor set path
+		 */
+		uint32_t materialIndex{ 0 };
+
+		/**
+		 * First joint of the node's skin in the joint palette, -1 for unskinned nodes
+		 */
+		int32_t jointOffset{ -1 };
 	};
 }
\ No newline at end of file
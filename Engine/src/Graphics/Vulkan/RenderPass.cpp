@@ -8,9 +8,23 @@
 
 namespace ash
 {
-	RenderPass::RenderPass(const LogicalDevice* logicalDevice, const SwapChain* swapChain, const PhysicalDevice* physicalDevice) :
-		m_logicalDevice{ logicalDevice }
+	RenderPass::RenderPass(const LogicalDevice* logicalDevice, const SwapChain* swapChain, const PhysicalDevice* physicalDevice,
+		bool dynamicRendering) :
+		m_logicalDevice{ logicalDevice },
+		m_dynamicRendering{ dynamicRendering }
 	{
+		// the extension's commands rather than the 1.3 core ones, the instance targets 1.2
+		if (m_dynamicRendering)
+		{
+			m_cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(*m_logicalDevice, "vkCmdBeginRenderingKHR"));
+			m_cmdEndRendering	= reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(*m_logicalDevice, "vkCmdEndRenderingKHR"));
+
+			if (!m_cmdBeginRendering || !m_cmdEndRendering)
+			{
+				throw std::runtime_error("failed to load dynamic rendering commands!");
+			}
+		}
+
 		createRenderPass(swapChain, physicalDevice);
 	}
 
@@ -22,32 +36,217 @@ namespace ash
 	void RenderPass::cleanupRenderPass()
 	{
 		vkDestroyRenderPass(*m_logicalDevice, m_renderPass, nullptr);
+		vkDestroyRenderPass(*m_logicalDevice, m_beginRenderPass, nullptr);
+		vkDestroyRenderPass(*m_logicalDevice, m_endRenderPass, nullptr);
 	}
 
 	void RenderPass::createRenderPass(const SwapChain* swapChain, const PhysicalDevice* physicalDevice)
 	{
+		m_colorFormat	= swapChain->getImageFormat();
+		m_depthFormat	= physicalDevice->findDepthFormat();
+		m_depthAspects	= VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (m_depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || m_depthFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+		{
+			m_depthAspects |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+
+		if (m_dynamicRendering)
+		{
+			return;
+		}
+
+		m_renderPass = createPass(swapChain, physicalDevice, VK_ATTACHMENT_LOAD_OP_CLEAR,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+		// the same pass split in two, the depth is kept for compute work between the halves
+		m_beginRenderPass = createPass(swapChain, physicalDevice, VK_ATTACHMENT_LOAD_OP_CLEAR,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_STORE_OP_STORE);
+		m_endRenderPass = createPass(swapChain, physicalDevice, VK_ATTACHMENT_LOAD_OP_LOAD,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+	}
+
+	VkRenderPass RenderPass::getPass(RenderPassPart part) const
+	{
+		switch (part)
+		{
+		case RenderPassPart::Begin:
+			return m_beginRenderPass;
+		case RenderPassPart::End:
+			return m_endRenderPass;
+		default:
+			return m_renderPass;
+		}
+	}
+
+	void RenderPass::begin(VkCommandBuffer commandBuffer, const RenderTarget& target, VkSubpassContents contents,
+		RenderPassPart part) const
+	{
+		std::array<VkClearValue, 2> clearValues{};
+		clearValues[0].color		= { {0.0f, 0.0f, 0.0f, 1.0f} };
+		clearValues[1].depthStencil	= { 1.0f, 0 };
+
+		if (!m_dynamicRendering)
+		{
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass			= getPass(part);
+			renderPassInfo.framebuffer			= target.framebuffer;
+			renderPassInfo.renderArea.offset	= { 0,0 };
+			renderPassInfo.renderArea.extent	= target.extent;
+			renderPassInfo.clearValueCount		= static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues			= clearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+			return;
+		}
+
+		transitionForRendering(commandBuffer, target, part);
+
+		// the same load and store operations as the render pass objects
+		const bool load{ part == RenderPassPart::End };
+
+		VkRenderingAttachmentInfoKHR colorAttachment{};
+		colorAttachment.sType		= VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageView	= target.colorView;
+		colorAttachment.imageLayout	= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp		= load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp		= VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue	= clearValues[0];
+
+		VkRenderingAttachmentInfoKHR depthAttachment{};
+		depthAttachment.sType		= VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		depthAttachment.imageView	= target.depthView;
+		depthAttachment.imageLayout	= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp		= load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp		= part == RenderPassPart::Begin ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.clearValue	= clearValues[1];
+
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType					= VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.flags					= contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+											? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+		renderingInfo.renderArea.offset		= { 0,0 };
+		renderingInfo.renderArea.extent		= target.extent;
+		renderingInfo.layerCount			= 1;
+		renderingInfo.colorAttachmentCount	= 1;
+		renderingInfo.pColorAttachments		= &colorAttachment;
+		renderingInfo.pDepthAttachment		= &depthAttachment;
+
+		m_cmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+
+	void RenderPass::end(VkCommandBuffer commandBuffer, const RenderTarget& target, RenderPassPart part) const
+	{
+		if (!m_dynamicRendering)
+		{
+			vkCmdEndRenderPass(commandBuffer);
+			return;
+		}
+
+		m_cmdEndRendering(commandBuffer);
+
+		if (part != RenderPassPart::Begin)
+		{
+			transitionForPresent(commandBuffer, target);
+		}
+	}
+
+	void RenderPass::transitionForRendering(VkCommandBuffer commandBuffer, const RenderTarget& target, RenderPassPart part) const
+	{
+		const VkPipelineStageFlags stages{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+			| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT };
+
+		// the end part loads what the begin part wrote, the depth is synchronized by whoever read it in between
+		if (part == RenderPassPart::End)
+		{
+			VkMemoryBarrier barrier{};
+			barrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			barrier.dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+									| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			return;
+		}
+
+		// both attachments are cleared, earlier frames only have to be done with them. The color
+		// stage waits on the image available semaphore
+		std::array<VkImageMemoryBarrier, 2> barriers{};
+		barriers[0].sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[0].srcAccessMask					= 0;
+		barriers[0].dstAccessMask					= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		barriers[0].oldLayout						= VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[0].newLayout						= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		barriers[0].srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].image							= target.colorImage;
+		barriers[0].subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		barriers[0].subresourceRange.levelCount		= 1;
+		barriers[0].subresourceRange.layerCount		= 1;
+
+		barriers[1].sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[1].srcAccessMask					= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barriers[1].dstAccessMask					= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barriers[1].oldLayout						= VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout						= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		barriers[1].srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barriers[1].dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barriers[1].image							= target.depthImage;
+		barriers[1].subresourceRange.aspectMask		= m_depthAspects;
+		barriers[1].subresourceRange.levelCount		= 1;
+		barriers[1].subresourceRange.layerCount		= 1;
+
+		vkCmdPipelineBarrier(commandBuffer, stages, stages, 0, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(barriers.size()), barriers.data());
+	}
+
+	void RenderPass::transitionForPresent(VkCommandBuffer commandBuffer, const RenderTarget& target) const
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask					= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask					= 0;
+		barrier.oldLayout						= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		barrier.newLayout						= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.image							= target.colorImage;
+		barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount		= 1;
+		barrier.subresourceRange.layerCount		= 1;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	VkRenderPass RenderPass::createPass(const SwapChain* swapChain, const PhysicalDevice* physicalDevice, VkAttachmentLoadOp loadOp,
+		VkImageLayout initialLayout, VkImageLayout finalLayout, VkAttachmentStoreOp depthStoreOp)
+	{
+		const bool load{ loadOp == VK_ATTACHMENT_LOAD_OP_LOAD };
+
 		VkAttachmentDescription colorAttachment{};
 		colorAttachment.format			= swapChain->getImageFormat();
 		colorAttachment.samples			= VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.loadOp			= loadOp;
 		colorAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_STORE;
 		colorAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout		= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachment.initialLayout	= initialLayout;
+		colorAttachment.finalLayout		= finalLayout;
 
 		VkAttachmentReference colorAttachmentRef{};
 		colorAttachmentRef.attachment	= 0;
 		colorAttachmentRef.layout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+		// a loaded depth is expected back in the attachment layout
 		VkAttachmentDescription depthAttachment{};
 		depthAttachment.format			= physicalDevice->findDepthFormat();
 		depthAttachment.samples			= VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.loadOp			= loadOp;
+		depthAttachment.storeOp			= depthStoreOp;
 		depthAttachment.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.initialLayout	= load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
 		depthAttachment.finalLayout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference depthAttachmentRef{};
@@ -60,16 +259,18 @@ namespace ash
 		subpass.pColorAttachments		= &colorAttachmentRef;
 		subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+		// a loaded color attachment was written by the first half, the depth is synchronized by whoever read it
 		VkSubpassDependency dependency{};
 		dependency.srcSubpass			= VK_SUBPASS_EXTERNAL;
 		dependency.dstSubpass			= 0;
 		dependency.srcStageMask			= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT 
 										| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.srcAccessMask		= 0;
+		dependency.srcAccessMask		= load ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
 		dependency.dstStageMask			= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT 
 										| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 		dependency.dstAccessMask		= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT 
-										| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+										| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+										| (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
 
 		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
 
@@ -82,11 +283,12 @@ namespace ash
 		renderPassInfo.dependencyCount	= 1;
 		renderPassInfo.pDependencies	= &dependency;
 
-		if (vkCreateRenderPass(*m_logicalDevice, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
+		VkRenderPass renderPass{};
+		if (vkCreateRenderPass(*m_logicalDevice, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to create render pass!");
 		}
-
+		return renderPass;
 	}
 
 }
\ No newline at end of file
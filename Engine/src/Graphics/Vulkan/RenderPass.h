@@ -13,19 +13,71 @@
 namespace ash
 {
 	/**
-	 * Wrapper for the Vulkan RenderPass
+	 * What a render pass instance draws, the whole frame or one half of the frame split in two
+	 */
+	enum class RenderPassPart
+	{
+		Whole,		// clears the attachments and presents
+		Begin,		// clears the attachments and keeps them for the end
+		End			// loads what the begin part drew and presents
+	};
+
+	/**
+	 * Attachments of a frame, render pass objects use the framebuffer and dynamic rendering the images
+	 */
+	struct RenderTarget
+	{
+		VkFramebuffer	framebuffer	{};
+		VkImage			colorImage	{};
+		VkImageView		colorView	{};
+		VkImage			depthImage	{};
+		VkImageView		depthView	{};
+		VkExtent2D		extent		{};
+	};
+
+	/**
+	 * Wrapper for the Vulkan RenderPass.
+	 * With dynamic rendering no render pass or framebuffer objects are created, the attachments are
+	 * given when recording through VK_KHR_dynamic_rendering and their layouts changed with barriers,
+	 * so only a change of format affects it
 	 */
 	class RenderPass
 	{
 	public:
-		RenderPass(const LogicalDevice* logicalDevice, const SwapChain* swapChain, const PhysicalDevice* physicalDevice);
+		RenderPass(const LogicalDevice* logicalDevice, const SwapChain* swapChain, const PhysicalDevice* physicalDevice,
+			bool dynamicRendering = false);
 		~RenderPass();
 
 		/**
-		 * overide * operator for more intuitive access
+		 * overide * operator for more intuitive access, VK_NULL_HANDLE with dynamic rendering
 		 */
 		operator const VkRenderPass& () const { return m_renderPass; }
 
+		/**
+		 * Whether attachments are given when recording instead of through render pass and framebuffer objects
+		 */
+		bool isDynamic() const { return m_dynamicRendering; }
+
+		/**
+		 * Formats of the attachments, pipelines and secondary command buffers are created for them
+		 * when rendering dynamically
+		 */
+		VkFormat getColorFormat() const { return m_colorFormat; }
+
+		VkFormat getDepthFormat() const { return m_depthFormat; }
+
+		/**
+		 * Begins drawing the part of the frame into the target
+		 * @param contents VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS when the draws are recorded on other threads
+		 */
+		void begin(VkCommandBuffer commandBuffer, const RenderTarget& target, VkSubpassContents contents,
+			RenderPassPart part = RenderPassPart::Whole) const;
+
+		/**
+		 * Ends drawing the part of the frame begun with the same target
+		 */
+		void end(VkCommandBuffer commandBuffer, const RenderTarget& target, RenderPassPart part = RenderPassPart::Whole) const;
+
 		/**
 		 * Cleans up Vulkan RenderPass, called during swap chain recreation
 		 */
@@ -36,6 +88,13 @@ namespace ash
 		 */
 		void createRenderPass(const SwapChain* swapChain, const PhysicalDevice* physicalDevice);
 
+		/**
+		 * Render pass object drawing the part, VK_NULL_HANDLE with dynamic rendering.
+		 * After the begin part the depth is in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		 * and the end part expects it back there
+		 */
+		VkRenderPass getPass(RenderPassPart part) const;
+
 	private:
 		
 		/**
@@ -43,11 +102,53 @@ namespace ash
 		 */
 		VkRenderPass m_renderPass{};
 
+		/**
+		 * Halves of m_renderPass for work that must happen between drawing, compatible with the same framebuffers
+		 */
+		VkRenderPass m_beginRenderPass{};
+
+		VkRenderPass m_endRenderPass{};
+
 		/**
 		 * Vulkan Logical Device, used for resource destruction
 		 */
 		const LogicalDevice* m_logicalDevice{};
-		
 
+		bool m_dynamicRendering{ false };
+
+		VkFormat m_colorFormat{ VK_FORMAT_UNDEFINED };
+
+		VkFormat m_depthFormat{ VK_FORMAT_UNDEFINED };
+
+		/**
+		 * Aspects of the depth format, the stencil is transitioned along with the depth
+		 */
+		VkImageAspectFlags m_depthAspects{ VK_IMAGE_ASPECT_DEPTH_BIT };
+
+		/**
+		 * VK_KHR_dynamic_rendering commands, loaded from the device when rendering dynamically
+		 */
+		PFN_vkCmdBeginRenderingKHR m_cmdBeginRendering{};
+
+		PFN_vkCmdEndRenderingKHR m_cmdEndRendering{};
+
+		/**
+		 * Creates a render pass with the swap chain's color and the depth attachment
+		 * @param loadOp of both attachments
+		 * @param initialLayout and finalLayout of the color attachment
+		 */
+		VkRenderPass createPass(const SwapChain* swapChain, const PhysicalDevice* physicalDevice, VkAttachmentLoadOp loadOp,
+			VkImageLayout initialLayout, VkImageLayout finalLayout, VkAttachmentStoreOp depthStoreOp);
+
+		/**
+		 * Records the barriers moving the attachments into the layouts the part draws in,
+		 * or making what the begin part drew visible to the end part
+		 */
+		void transitionForRendering(VkCommandBuffer commandBuffer, const RenderTarget& target, RenderPassPart part) const;
+
+		/**
+		 * Records the barrier moving the color attachment to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+		 */
+		void transitionForPresent(VkCommandBuffer commandBuffer, const RenderTarget& target) const;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/SecondaryCommandBuffers.h"
+
+#include <stdexcept>
+
+namespace ash
+{
+	SecondaryCommandBuffers::SecondaryCommandBuffers(const LogicalDevice* logicalDevice, uint32_t frameCount, uint32_t bufferCount) :
+		m_logicalDevice{ logicalDevice }, m_bufferCount{ bufferCount }
+	{
+		m_pools.resize(static_cast<size_t>(frameCount) * bufferCount);
+		m_commandBuffers.resize(m_pools.size());
+
+		for (size_t i = 0; i < m_pools.size(); i++)
+		{
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex	= m_logicalDevice->getGraphicsFamily();
+			poolInfo.flags				= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(*m_logicalDevice, &poolInfo, nullptr, &m_pools[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create secondary command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool			= m_pools[i];
+			allocInfo.level					= VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount	= 1;
+
+			if (vkAllocateCommandBuffers(*m_logicalDevice, &allocInfo, &m_commandBuffers[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to allocate secondary command buffer!");
+			}
+		}
+	}
+
+	SecondaryCommandBuffers::~SecondaryCommandBuffers()
+	{
+		// destroying a pool frees its command buffers
+		for (VkCommandPool pool : m_pools)
+		{
+			vkDestroyCommandPool(*m_logicalDevice, pool, nullptr);
+		}
+	}
+
+	void SecondaryCommandBuffers::reset(uint32_t frame)
+	{
+		for (uint32_t i = 0; i < m_bufferCount; i++)
+		{
+			vkResetCommandPool(*m_logicalDevice, m_pools[frame * m_bufferCount + i], 0);
+		}
+	}
+
+	VkCommandBuffer SecondaryCommandBuffers::begin(uint32_t frame, uint32_t index, const RenderPass& renderPass, VkFramebuffer framebuffer)
+	{
+		VkCommandBuffer commandBuffer{ m_commandBuffers[frame * m_bufferCount + index] };
+
+		const VkFormat colorFormat{ renderPass.getColorFormat() };
+
+		VkCommandBufferInheritanceRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType						= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+		renderingInfo.colorAttachmentCount		= 1;
+		renderingInfo.pColorAttachmentFormats	= &colorFormat;
+		renderingInfo.depthAttachmentFormat		= renderPass.getDepthFormat();
+		renderingInfo.rasterizationSamples		= VK_SAMPLE_COUNT_1_BIT;
+
+		// with dynamic rendering there is neither a render pass nor a framebuffer to inherit
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType		= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.pNext		= renderPass.isDynamic() ? &renderingInfo : nullptr;
+		inheritanceInfo.renderPass	= renderPass;
+		inheritanceInfo.subpass		= 0;
+		inheritanceInfo.framebuffer	= renderPass.isDynamic() ? VK_NULL_HANDLE : framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags				= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo	= &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+		return commandBuffer;
+	}
+}
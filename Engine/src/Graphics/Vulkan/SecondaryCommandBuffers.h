@@ -0,0 +1,78 @@
+/**
+ * Secondary command buffers for recording a render pass on several threads
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/LogicalDevice.h"
+#include "Vulkan/RenderPass.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Secondary command buffers for recording a render pass on several threads.
+	 * Every frame in flight gets one command pool per buffer, so each buffer can be
+	 * recorded on a different thread without locking, and the whole frame is
+	 * recycled with a pool reset once its fence signaled.
+	 * Buffers are not one time submit, a frame's buffers can be executed again
+	 * every time the frame comes around until they are reset
+	 */
+	class SecondaryCommandBuffers
+	{
+	public:
+		SecondaryCommandBuffers(const LogicalDevice* logicalDevice, uint32_t frameCount, uint32_t bufferCount);
+		~SecondaryCommandBuffers();
+
+		SecondaryCommandBuffers(const SecondaryCommandBuffers&) = delete;
+		SecondaryCommandBuffers& operator=(const SecondaryCommandBuffers&) = delete;
+
+		/**
+		 * Number of buffers every frame has
+		 */
+		uint32_t getBufferCount() const { return m_bufferCount; }
+
+		/**
+		 * Resets the frame's pools, the GPU must be done with the frame
+		 */
+		void reset(uint32_t frame);
+
+		/**
+		 * Begins recording the buffer inside subpass 0 of the render pass, or inside dynamic rendering
+		 * with the render pass' attachment formats
+		 * @param framebuffer may be VK_NULL_HANDLE when the buffer is executed with several framebuffers
+		 */
+		VkCommandBuffer begin(uint32_t frame, uint32_t index, const RenderPass& renderPass, VkFramebuffer framebuffer);
+
+		/**
+		 * Returns the frame's buffers in index order, for vkCmdExecuteCommands
+		 */
+		const VkCommandBuffer* getCommandBuffers(uint32_t frame) const { return &m_commandBuffers[frame * m_bufferCount]; }
+
+	private:
+
+		/**
+		 * Vulkan Logical Device, used for pool creation and destruction
+		 */
+		const LogicalDevice* m_logicalDevice{};
+
+		/**
+		 * Number of buffers every frame has
+		 */
+		uint32_t m_bufferCount{ 0 };
+
+		/**
+		 * One pool per buffer, frame major
+		 */
+		std::vector<VkCommandPool> m_pools{};
+
+		/**
+		 * One secondary buffer per pool, frame major
+		 */
+		std::vector<VkCommandBuffer> m_commandBuffers{};
+	};
+}
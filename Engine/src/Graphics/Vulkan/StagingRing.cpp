@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/StagingRing.h"
+#include "Vulkan/LogicalDevice.h"
+
+#include <stdexcept>
+
+namespace ash
+{
+	StagingRing::StagingRing(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, VkDeviceSize size) :
+		m_logicalDevice{ logicalDevice }, m_size{ size }
+	{
+		m_buffer = std::make_unique<Buffer>(
+			logicalDevice,
+			physicalDevice,
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			MemoryCategory::Staging);
+	}
+
+	uint32_t StagingRing::beginRegion()
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		uint32_t region{ m_nextRegion++ };
+		m_regions[region] = VK_NULL_HANDLE;
+		return region;
+	}
+
+	void StagingRing::submitRegion(uint32_t region, VkFence fence)
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		m_regions[region] = fence;
+	}
+
+	void StagingRing::endRegion(uint32_t region)
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		m_regions.erase(region);
+		retire();
+	}
+
+	bool StagingRing::allocate(uint32_t region, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation)
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+
+		retire();
+
+		// allocations never wrap, skip to the start of the ring when the end is too small
+		uint64_t start{ (m_head + alignment - 1) / alignment * alignment };
+		if (start % m_size + size > m_size)
+		{
+			start = (start / m_size + 1) * m_size;
+		}
+		uint64_t end{ start + size };
+
+		if (size > m_size || end - m_tail > m_size)
+		{
+			return false;
+		}
+
+		m_entries.push_back(Entry{ end, region });
+		m_head = end;
+
+		allocation.buffer	= *m_buffer;
+		allocation.offset	= start % m_size;
+		allocation.data		= static_cast<char*>(m_buffer->getMappedData()) + allocation.offset;
+		return true;
+	}
+
+	bool StagingRing::waitForSpace(uint32_t region)
+	{
+		VkFence fence{};
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+
+			retire();
+			if (m_entries.empty())
+			{
+				return true;
+			}
+
+			uint32_t oldest{ m_entries.front().region };
+			if (oldest == region)
+			{
+				return false;
+			}
+
+			fence = m_regions.at(oldest);
+			if (fence == VK_NULL_HANDLE)
+			{
+				throw std::runtime_error("failed to stage upload, the staging ring is full of unsubmitted uploads!");
+			}
+		}
+
+		vkWaitForFences(*m_logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+		return true;
+	}
+
+	void StagingRing::retire()
+	{
+		while (!m_entries.empty() && isRegionDone(m_entries.front().region))
+		{
+			m_tail = m_entries.front().end;
+			m_entries.pop_front();
+		}
+
+		// an empty ring restarts at the front so large allocations fit again
+		if (m_entries.empty())
+		{
+			m_head = 0;
+			m_tail = 0;
+		}
+	}
+
+	bool StagingRing::isRegionDone(uint32_t region) const
+	{
+		auto found{ m_regions.find(region) };
+		if (found == m_regions.end())
+		{
+			return true;
+		}
+		return found->second != VK_NULL_HANDLE && vkGetFenceStatus(*m_logicalDevice, found->second) == VK_SUCCESS;
+	}
+}
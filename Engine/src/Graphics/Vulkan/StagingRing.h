@@ -0,0 +1,139 @@
+/**
+ * Persistently mapped ring buffer that all uploads stage their data in
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/PhysicalDevice.h"
+#include "Vulkan/Buffer.h"
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace ash
+{
+	class LogicalDevice;
+
+	/**
+	 * Persistently mapped ring buffer that all uploads stage their data in.
+	 * Allocations belong to a region, usually one per UploadBatch submission. Space is
+	 * reclaimed in order once a region's fence signals or the region is ended, so
+	 * repeated uploads never touch the memory allocator
+	 */
+	class StagingRing
+	{
+	public:
+		/**
+		 * Staging memory handed out by allocate
+		 */
+		struct Allocation
+		{
+			void*			data	{};
+			VkBuffer		buffer	{};
+			VkDeviceSize	offset	{ 0 };
+		};
+
+		StagingRing(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, VkDeviceSize size);
+
+		/**
+		 * Size of the whole ring, single allocations can't be larger
+		 */
+		VkDeviceSize getSize() const { return m_size; }
+
+		/**
+		 * Opens a region that following allocations are tracked by
+		 */
+		uint32_t beginRegion();
+
+		/**
+		 * Ties the region to the fence of the submission reading it, space is reclaimed once it signals
+		 */
+		void submitRegion(uint32_t region, VkFence fence);
+
+		/**
+		 * Releases the region's space, the GPU must be done reading it.
+		 * Must be called before the region's fence is destroyed
+		 */
+		void endRegion(uint32_t region);
+
+		/**
+		 * Hands out size bytes of contiguous staging memory
+		 * @return false when the ring has no room until older regions finish
+		 */
+		bool allocate(uint32_t region, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+
+		/**
+		 * Blocks until the oldest region in the ring finishes
+		 * @return false when the oldest region is the caller's own unsubmitted region, which it has to submit first
+		 */
+		bool waitForSpace(uint32_t region);
+
+	private:
+
+		/**
+		 * A range of the ring, ending at a virtual offset, and the region it belongs to
+		 */
+		struct Entry
+		{
+			uint64_t end	{ 0 };
+			uint32_t region	{ 0 };
+		};
+
+		/**
+		 * Vulkan Logical Device, used to poll and wait on fences
+		 */
+		const LogicalDevice* m_logicalDevice{};
+
+		/**
+		 * Host visible, persistently mapped ring memory
+		 */
+		std::unique_ptr<Buffer> m_buffer{};
+
+		/**
+		 * Size of the ring in bytes
+		 */
+		VkDeviceSize m_size{ 0 };
+
+		/**
+		 * Virtual offsets of the next allocation and of the oldest live byte, the physical offset is virtual % size
+		 */
+		uint64_t m_head{ 0 };
+
+		uint64_t m_tail{ 0 };
+
+		/**
+		 * Live ranges, oldest first
+		 */
+		std::deque<Entry> m_entries{};
+
+		/**
+		 * Fence of every region that hasn't ended, null until submitted
+		 */
+		std::unordered_map<uint32_t, VkFence> m_regions{};
+
+		/**
+		 * Id of the next region
+		 */
+		uint32_t m_nextRegion{ 0 };
+
+		/**
+		 * Guards the ring, uploads may be recorded from several threads
+		 */
+		std::mutex m_mutex{};
+
+		/**
+		 * Moves the tail past every leading range whose region is done
+		 */
+		void retire();
+
+		/**
+		 * True when the region ended or its fence signaled
+		 */
+		bool isRegionDone(uint32_t region) const;
+	};
+}
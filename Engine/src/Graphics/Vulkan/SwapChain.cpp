@@ -7,6 +7,7 @@
 #include <algorithm>	// for std::clamp
 #include <array>
 #include <stdexcept>
+#include <utility>
 
 namespace ash
 {
@@ -69,7 +70,8 @@ namespace ash
 
 	}
 
-	void SwapChain::createSwapChain(const Window* window, const Surface* surface, const PhysicalDevice* physicalDevice)
+	void SwapChain::createSwapChain(const Window* window, const Surface* surface, const PhysicalDevice* physicalDevice,
+		VkSwapchainKHR oldSwapChain)
 	{
 		const PhysicalDevice::SwapChainSupportDetails swapChainSupportDetails{ physicalDevice->getSwapChainSupportDetails() };
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupportDetails.formats);
@@ -112,7 +114,7 @@ namespace ash
 		createInfo.compositeAlpha	= VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		createInfo.presentMode		= presentMode;
 		createInfo.clipped			= VK_TRUE;
-		createInfo.oldSwapchain		= VK_NULL_HANDLE;
+		createInfo.oldSwapchain		= oldSwapChain;
 
 		if (vkCreateSwapchainKHR(*m_logicalDevice, &createInfo, nullptr, &m_swapChain) != VK_SUCCESS)
 		{
@@ -186,6 +188,36 @@ namespace ash
 		
 	}
 
+	SwapChain::RetiredObjects SwapChain::retire()
+	{
+		RetiredObjects retired{};
+		retired.swapChain		= m_swapChain;
+		retired.imageViews		= std::move(m_imageViews);
+		retired.framebuffers	= std::move(m_framebuffers);
+
+		m_swapChain = VK_NULL_HANDLE;
+		m_imageViews.clear();
+		m_framebuffers.clear();
+		m_images.clear();
+
+		return retired;
+	}
+
+	void SwapChain::destroyRetired(const RetiredObjects& retired) const
+	{
+		for (auto framebuffer : retired.framebuffers)
+		{
+			vkDestroyFramebuffer(*m_logicalDevice, framebuffer, nullptr);
+		}
+
+		for (auto imageView : retired.imageViews)
+		{
+			vkDestroyImageView(*m_logicalDevice, imageView, nullptr);
+		}
+
+		vkDestroySwapchainKHR(*m_logicalDevice, retired.swapChain, nullptr);
+	}
+
 	void SwapChain::cleanupFramebuffers()
 	{
 		for (auto framebuffer : m_framebuffers)
@@ -22,6 +22,16 @@ namespace ash
 	class SwapChain
 	{
 	public:
+		/**
+		 * Objects handed over by retire, destroyed with destroyRetired once no frame uses them
+		 */
+		struct RetiredObjects
+		{
+			VkSwapchainKHR				swapChain		{};
+			std::vector<VkImageView>	imageViews		{};
+			std::vector<VkFramebuffer>	framebuffers	{};
+		};
+
 		SwapChain(const Window* window, const Surface* surface, const PhysicalDevice* physicalDevice, const LogicalDevice* logicalDevice);
 		~SwapChain();
 
@@ -46,7 +56,14 @@ namespace ash
 		const uint32_t getImageCount() const { return m_imageCount; }
 
 		/**
-		 * Returns array of swap chain framebuffers
+		 * Returns array of swap chain images and their views, drawn to directly with dynamic rendering
+		 */
+		const std::vector<VkImage>& getImages() const { return m_images; }
+
+		const std::vector<VkImageView>& getImageViews() const { return m_imageViews; }
+
+		/**
+		 * Returns array of swap chain framebuffers, empty with dynamic rendering
 		 */
 		const std::vector<VkFramebuffer>& getFramebuffers() const { return m_framebuffers; }
 
@@ -72,8 +89,21 @@ namespace ash
 
 		/**
 		 * Creates the Vulkan Swap Chain
+		 * @param oldSwapChain retired swap chain being replaced, lets presentation of its images finish
+		 */
+		void createSwapChain(const Window* window, const Surface* surface, const PhysicalDevice* physicalDevice,
+			VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+
+		/**
+		 * Hands over the swap chain, its image views and its framebuffers without destroying them,
+		 * called during swap chain recreation while frames in flight may still use them
+		 */
+		RetiredObjects retire();
+
+		/**
+		 * Destroys objects handed over by retire
 		 */
-		void createSwapChain(const Window* window, const Surface* surface, const PhysicalDevice* physicalDevice);
+		void destroyRetired(const RetiredObjects& retired) const;
 
 		/**
 		 * Creates image views for all swap chain images
@@ -0,0 +1,394 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Vulkan/UploadBatch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace ash
+{
+	namespace
+	{
+		/**
+		 * Stages that read uploaded data
+		 */
+		constexpr VkPipelineStageFlags CONSUMER_STAGES{
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+
+		/**
+		 * Accesses that read uploaded data
+		 */
+		constexpr VkAccessFlags CONSUMER_ACCESS{
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT };
+	}
+
+	UploadBatch::UploadBatch(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice) :
+		m_logicalDevice{ logicalDevice },
+		m_ownershipTransfer{ logicalDevice->hasTransferQueue() }
+	{
+		m_stagingAlignment = std::max(m_stagingAlignment, physicalDevice->getProperties().limits.optimalBufferCopyOffsetAlignment);
+
+		begin();
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(*m_logicalDevice, &fenceInfo, nullptr, &m_fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload fence!");
+		}
+
+		if (m_ownershipTransfer)
+		{
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			if (vkCreateSemaphore(*m_logicalDevice, &semaphoreInfo, nullptr, &m_semaphore) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create upload semaphore!");
+			}
+		}
+	}
+
+	UploadBatch::~UploadBatch()
+	{
+		if (m_submitted)
+		{
+			wait();
+		}
+		release();
+		vkDestroySemaphore(*m_logicalDevice, m_semaphore, nullptr);
+		vkDestroyFence(*m_logicalDevice, m_fence, nullptr);
+	}
+
+	void UploadBatch::copyToBuffer(const Buffer& dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset)
+	{
+		// coherent host writes are made visible to the device by the next queue submission
+		if (dst.getMappedData())
+		{
+			memcpy(static_cast<char*>(dst.getMappedData()) + dstOffset, data, static_cast<size_t>(size));
+			return;
+		}
+
+		const VkDeviceSize maxChunkSize{ getMaxChunkSize() };
+
+		for (VkDeviceSize copied = 0; copied < size; )
+		{
+			VkDeviceSize			chunkSize	{ std::min(size - copied, maxChunkSize) };
+			StagingRing::Allocation	staging		{ allocateStaging(chunkSize) };
+			memcpy(staging.data, static_cast<const char*>(data) + copied, static_cast<size_t>(chunkSize));
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset	= staging.offset;
+			copyRegion.dstOffset	= dstOffset + copied;
+			copyRegion.size			= chunkSize;
+
+			vkCmdCopyBuffer(m_commandBuffer, staging.buffer, dst, 1, &copyRegion);
+			m_recorded = true;
+			copied += chunkSize;
+		}
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask		= VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask		= CONSUMER_ACCESS;
+		barrier.srcQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex	= VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer				= dst;
+		barrier.offset				= dstOffset;
+		barrier.size				= size;
+
+		m_bufferBarriers.push_back(barrier);
+	}
+
+	void UploadBatch::copyToImage(
+		Image& image,
+		VkFormat format,
+		uint32_t width,
+		uint32_t height,
+		uint32_t texelSize,
+		const std::function<void(void* dst, uint32_t firstRow, uint32_t rowCount)>& writeRows)
+	{
+		// chunks are made of whole rows so each one is a single buffer to image copy
+		const VkDeviceSize	rowSize		{ static_cast<VkDeviceSize>(width) * texelSize };
+		const uint32_t		chunkRows	{ static_cast<uint32_t>(std::max<VkDeviceSize>(getMaxChunkSize() / rowSize, 1)) };
+
+		for (uint32_t firstRow = 0; firstRow < height; firstRow += chunkRows)
+		{
+			uint32_t				rowCount	{ std::min(chunkRows, height - firstRow) };
+			StagingRing::Allocation	staging		{ allocateStaging(rowSize * rowCount) };
+
+			// recorded after the first allocation, which may have flushed the batch
+			if (firstRow == 0)
+			{
+				image.transitionImageLayout(m_commandBuffer, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			}
+
+			writeRows(staging.data, firstRow, rowCount);
+			image.copyFromBuffer(m_commandBuffer, staging.buffer, width, rowCount, staging.offset, firstRow);
+			m_recorded = true;
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout						= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout						= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.image							= image.getImage();
+		barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel	= 0;
+		barrier.subresourceRange.levelCount		= 1;
+		barrier.subresourceRange.baseArrayLayer	= 0;
+		barrier.subresourceRange.layerCount		= 1;
+		barrier.srcAccessMask					= VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask					= VK_ACCESS_SHADER_READ_BIT;
+
+		m_imageBarriers.push_back(barrier);
+	}
+
+	void UploadBatch::submit()
+	{
+		if (m_submitted || !m_commandBuffer)
+		{
+			throw std::runtime_error("upload batch was already submitted!");
+		}
+
+		recordBarriers();
+
+		if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record upload command buffer!");
+		}
+
+		// everything was written directly, there is nothing to wait for
+		if (!m_recorded)
+		{
+			release();
+			return;
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount	= 1;
+		submitInfo.pCommandBuffers		= &m_commandBuffer;
+
+		if (!m_ownershipTransfer)
+		{
+			if (vkQueueSubmit(m_logicalDevice->getGraphicQueue(), 1, &submitInfo, m_fence) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to submit upload batch!");
+			}
+			m_logicalDevice->getStagingRing().submitRegion(m_stagingRegion, m_fence);
+			m_submitted = true;
+			return;
+		}
+
+		// copies on the transfer queue, then the acquire barriers on the graphics queue once they finish
+		submitInfo.signalSemaphoreCount	= 1;
+		submitInfo.pSignalSemaphores	= &m_semaphore;
+
+		if (vkQueueSubmit(m_logicalDevice->getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+
+		VkPipelineStageFlags waitStage{ CONSUMER_STAGES };
+
+		// a flush before any barrier was recorded has nothing to acquire, the submit only waits and signals the fence
+		VkSubmitInfo acquireInfo{};
+		acquireInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireInfo.waitSemaphoreCount	= 1;
+		acquireInfo.pWaitSemaphores		= &m_semaphore;
+		acquireInfo.pWaitDstStageMask	= &waitStage;
+		acquireInfo.commandBufferCount	= m_acquireCommandBuffer ? 1 : 0;
+		acquireInfo.pCommandBuffers		= m_acquireCommandBuffer ? &m_acquireCommandBuffer : nullptr;
+
+		if (vkQueueSubmit(m_logicalDevice->getGraphicQueue(), 1, &acquireInfo, m_fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit upload acquire!");
+		}
+		m_logicalDevice->getStagingRing().submitRegion(m_stagingRegion, m_fence);
+		m_submitted = true;
+	}
+
+	void UploadBatch::wait()
+	{
+		if (!m_submitted)
+		{
+			return;
+		}
+
+		vkWaitForFences(*m_logicalDevice, 1, &m_fence, VK_TRUE, UINT64_MAX);
+		release();
+	}
+
+	bool UploadBatch::isComplete()
+	{
+		if (m_submitted && vkGetFenceStatus(*m_logicalDevice, m_fence) == VK_SUCCESS)
+		{
+			release();
+		}
+		return !m_submitted && !m_commandBuffer;
+	}
+
+	void UploadBatch::begin()
+	{
+		m_commandBuffer = beginCommandBuffer(m_logicalDevice->getTransferCommandPool());
+		m_stagingRegion = m_logicalDevice->getStagingRing().beginRegion();
+	}
+
+	StagingRing::Allocation UploadBatch::allocateStaging(VkDeviceSize size)
+	{
+		StagingRing& ring{ m_logicalDevice->getStagingRing() };
+		if (size > ring.getSize())
+		{
+			throw std::runtime_error("failed to stage upload, it is larger than the staging ring!");
+		}
+
+		StagingRing::Allocation allocation{};
+		while (!ring.allocate(m_stagingRegion, size, m_stagingAlignment, allocation))
+		{
+			// when the oldest data in the ring is our own it only frees up once this batch is submitted
+			if (!ring.waitForSpace(m_stagingRegion))
+			{
+				flush();
+			}
+		}
+		return allocation;
+	}
+
+	void UploadBatch::flush()
+	{
+		submit();
+		wait();
+		vkResetFences(*m_logicalDevice, 1, &m_fence);
+		begin();
+	}
+
+	VkDeviceSize UploadBatch::getMaxChunkSize() const
+	{
+		return std::max<VkDeviceSize>(m_logicalDevice->getStagingRing().getSize() / 2, 1);
+	}
+
+	VkCommandBuffer UploadBatch::beginCommandBuffer(VkCommandPool pool)
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level					= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool			= pool;
+		allocInfo.commandBufferCount	= 1;
+
+		VkCommandBuffer commandBuffer{};
+		if (vkAllocateCommandBuffers(*m_logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		return commandBuffer;
+	}
+
+	void UploadBatch::recordBarriers()
+	{
+		if (m_bufferBarriers.empty() && m_imageBarriers.empty())
+		{
+			return;
+		}
+
+		if (!m_ownershipTransfer)
+		{
+			vkCmdPipelineBarrier(
+				m_commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, CONSUMER_STAGES,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(m_bufferBarriers.size()), m_bufferBarriers.data(),
+				static_cast<uint32_t>(m_imageBarriers.size()), m_imageBarriers.data());
+			return;
+		}
+
+		// the release and acquire halves must describe the same transfer, including the layout change.
+		// access to the other queue's half is ignored, so release only makes the writes available
+		// and acquire only makes them visible
+		for (auto& barrier : m_bufferBarriers)
+		{
+			barrier.srcQueueFamilyIndex = m_logicalDevice->getTransferFamily();
+			barrier.dstQueueFamilyIndex = m_logicalDevice->getGraphicsFamily();
+		}
+		for (auto& barrier : m_imageBarriers)
+		{
+			barrier.srcQueueFamilyIndex = m_logicalDevice->getTransferFamily();
+			barrier.dstQueueFamilyIndex = m_logicalDevice->getGraphicsFamily();
+		}
+
+		std::vector<VkBufferMemoryBarrier>	releaseBuffers	{ m_bufferBarriers };
+		std::vector<VkImageMemoryBarrier>	releaseImages	{ m_imageBarriers };
+		for (auto& barrier : releaseBuffers)
+		{
+			barrier.dstAccessMask = 0;
+		}
+		for (auto& barrier : releaseImages)
+		{
+			barrier.dstAccessMask = 0;
+		}
+
+		vkCmdPipelineBarrier(
+			m_commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(releaseBuffers.size()), releaseBuffers.data(),
+			static_cast<uint32_t>(releaseImages.size()), releaseImages.data());
+
+		for (auto& barrier : m_bufferBarriers)
+		{
+			barrier.srcAccessMask = 0;
+		}
+		for (auto& barrier : m_imageBarriers)
+		{
+			barrier.srcAccessMask = 0;
+		}
+
+		// the semaphore wait blocks the consumer stages, chain the acquire to them
+		m_acquireCommandBuffer = beginCommandBuffer(m_logicalDevice->getCommandPool());
+		vkCmdPipelineBarrier(
+			m_acquireCommandBuffer,
+			CONSUMER_STAGES, CONSUMER_STAGES,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(m_bufferBarriers.size()), m_bufferBarriers.data(),
+			static_cast<uint32_t>(m_imageBarriers.size()), m_imageBarriers.data());
+
+		if (vkEndCommandBuffer(m_acquireCommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record upload acquire command buffer!");
+		}
+	}
+
+	void UploadBatch::release()
+	{
+		if (m_commandBuffer)
+		{
+			vkFreeCommandBuffers(*m_logicalDevice, m_logicalDevice->getTransferCommandPool(), 1, &m_commandBuffer);
+			m_commandBuffer = VK_NULL_HANDLE;
+			m_logicalDevice->getStagingRing().endRegion(m_stagingRegion);
+		}
+		if (m_acquireCommandBuffer)
+		{
+			vkFreeCommandBuffers(*m_logicalDevice, m_logicalDevice->getCommandPool(), 1, &m_acquireCommandBuffer);
+			m_acquireCommandBuffer = VK_NULL_HANDLE;
+		}
+		m_bufferBarriers.clear();
+		m_imageBarriers.clear();
+		m_submitted = false;
+		m_recorded = false;
+	}
+}
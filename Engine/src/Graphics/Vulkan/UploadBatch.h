@@ -0,0 +1,175 @@
+/**
+ * Records many buffer and image uploads into one command buffer
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "Vulkan/PhysicalDevice.h"
+#include "Vulkan/LogicalDevice.h"
+#include "Vulkan/Buffer.h"
+#include "Vulkan/Image.h"
+#include "Vulkan/StagingRing.h"
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Records many buffer and image uploads into one command buffer.
+	 * Data is copied into the device's staging ring as uploads are added, everything is
+	 * submitted at once with a fence and the ring space is reclaimed when it signals.
+	 * Uploads that don't fit in the ring are split into chunks, flushing the batch when
+	 * the ring is full of its own data.
+	 * When the device has a transfer queue the copies run there and ownership of the
+	 * destinations is handed to the graphics queue behind a semaphore.
+	 * Buffers in host visible memory (see LogicalDevice::usesDirectWrite) are written
+	 * directly without staging, a batch that recorded no copies is never submitted.
+	 * Destinations must not be used before the batch completes
+	 */
+	class UploadBatch
+	{
+	public:
+		UploadBatch(const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice);
+
+		/**
+		 * Waits for a submitted batch, a batch that was never submitted is discarded
+		 */
+		~UploadBatch();
+
+		UploadBatch(const UploadBatch&) = delete;
+		UploadBatch& operator=(const UploadBatch&) = delete;
+
+		/**
+		 * Stages size bytes of data and records a copy into dst, or writes dst directly when it is mapped
+		 */
+		void copyToBuffer(const Buffer& dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+		/**
+		 * Records the layout transitions and copies that fill image and leave it ready for sampling.
+		 * writeRows is called per chunk to fill staging memory with rowCount tightly packed rows starting at firstRow
+		 */
+		void copyToImage(
+			Image& image,
+			VkFormat format,
+			uint32_t width,
+			uint32_t height,
+			uint32_t texelSize,
+			const std::function<void(void* dst, uint32_t firstRow, uint32_t rowCount)>& writeRows);
+
+		/**
+		 * Ends recording and submits the batch, to the transfer queue when there is one
+		 */
+		void submit();
+
+		/**
+		 * Blocks until the submitted batch is done, then releases staging memory
+		 */
+		void wait();
+
+		/**
+		 * True once the submitted batch is done, releases staging memory when it is
+		 */
+		bool isComplete();
+
+	private:
+
+		/**
+		 * Vulkan Logical Device, used for recording and resource destruction
+		 */
+		const LogicalDevice* m_logicalDevice{};
+
+		/**
+		 * Alignment of staging allocations, satisfies image copies and the device's preferred copy offset
+		 */
+		VkDeviceSize m_stagingAlignment{ 16 };
+
+		/**
+		 * Region of the staging ring the recorded copies read from
+		 */
+		uint32_t m_stagingRegion{ 0 };
+
+		/**
+		 * True when copies run on a separate transfer queue family
+		 */
+		bool m_ownershipTransfer{ false };
+
+		/**
+		 * All copies of the batch, recorded for the transfer queue
+		 */
+		VkCommandBuffer m_commandBuffer{};
+
+		/**
+		 * Acquires ownership of the destinations on the graphics queue, only used with a transfer queue
+		 */
+		VkCommandBuffer m_acquireCommandBuffer{};
+
+		/**
+		 * Signaled by the transfer submission, waited on by the acquire submission
+		 */
+		VkSemaphore m_semaphore{};
+
+		/**
+		 * Signaled when the batch finished executing
+		 */
+		VkFence m_fence{};
+
+		/**
+		 * True after submit, until the staging memory is released
+		 */
+		bool m_submitted{ false };
+
+		/**
+		 * True once a copy was recorded, empty batches skip the queue submission
+		 */
+		bool m_recorded{ false };
+
+		/**
+		 * Barriers making the copied buffers readable, recorded at submit
+		 */
+		std::vector<VkBufferMemoryBarrier> m_bufferBarriers{};
+
+		/**
+		 * Barriers moving the copied images to shader read layout, recorded at submit
+		 */
+		std::vector<VkImageMemoryBarrier> m_imageBarriers{};
+
+		/**
+		 * Starts recording and opens a staging region
+		 */
+		void begin();
+
+		/**
+		 * Returns size bytes of staging memory, waits on older batches or flushes this one when the ring is full
+		 */
+		StagingRing::Allocation allocateStaging(VkDeviceSize size);
+
+		/**
+		 * Submits and waits for everything recorded so far, then starts recording again
+		 */
+		void flush();
+
+		/**
+		 * Largest upload chunk, half the ring so a chunk fits beside data other batches still have in flight
+		 */
+		VkDeviceSize getMaxChunkSize() const;
+
+		/**
+		 * Allocates a primary command buffer from pool and begins recording
+		 */
+		VkCommandBuffer beginCommandBuffer(VkCommandPool pool);
+
+		/**
+		 * Records the barriers that hand the destinations over to the graphics queue
+		 */
+		void recordBarriers();
+
+		/**
+		 * Frees the command buffers and staging region of a finished batch
+		 */
+		void release();
+	};
+}
@@ -6,11 +6,13 @@
 #pragma once
 
 #include "Model/Model.h"
+#include "Loaders/PixelConversion.h"
 #include "Graphics/Vulkan/Buffer.h"
 #include "Vulkan/PhysicalDevice.h"
 #include "Vulkan/LogicalDevice.h"
 #include "Vulkan/Vertex.hpp"
 #include "Vulkan/Buffer.h"
+#include "Vulkan/UploadBatch.h"
 
 // TODO: This file is throwing a API REDEFINITION warning. It's related to glfw.h and windows.h
 #define TINYGLTF_IMPLEMENTATION
@@ -29,6 +31,8 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/euler_angles.hpp>
 
+#include <algorithm>
+#include <limits>
 #include <vector>
 #include <string>
 #include <stdexcept>
@@ -45,83 +49,282 @@ namespace ash
 		}
 	}
 
+	int getTextureIndex(const tinygltf::ParameterMap& values, const char* name)
+	{
+		auto value{ values.find(name) };
+		return value != values.end() ? value->second.TextureIndex() : -1;
+	}
+
 	void loadMaterials(tinygltf::Model& input, Model& model)
 	{
 		model.getMaterials().resize(input.materials.size());
 		for (size_t i = 0; i < input.materials.size(); i++) {
-			// We only read the most basic properties required for our sample
-			tinygltf::Material glTFMaterial = input.materials[i];
+			tinygltf::Material& glTFMaterial = input.materials[i];
+			Material& material = model.getMaterials()[i];
 			// Get the base color factor
 			if (glTFMaterial.values.find("baseColorFactor") != glTFMaterial.values.end()) {
-				model.getMaterials()[i].baseColorFactor = glm::make_vec4(glTFMaterial.values["baseColorFactor"].ColorFactor().data());
+				material.baseColorFactor = glm::make_vec4(glTFMaterial.values["baseColorFactor"].ColorFactor().data());
+			}
+			if (glTFMaterial.values.find("metallicFactor") != glTFMaterial.values.end()) {
+				material.metallicFactor = static_cast<float>(glTFMaterial.values["metallicFactor"].Factor());
+			}
+			if (glTFMaterial.values.find("roughnessFactor") != glTFMaterial.values.end()) {
+				material.roughnessFactor = static_cast<float>(glTFMaterial.values["roughnessFactor"].Factor());
+			}
+			if (glTFMaterial.additionalValues.find("emissiveFactor") != glTFMaterial.additionalValues.end()) {
+				material.emissiveFactor = glm::make_vec3(glTFMaterial.additionalValues["emissiveFactor"].ColorFactor().data());
 			}
-			// Get base color texture index
-			if (glTFMaterial.values.find("baseColorTexture") != glTFMaterial.values.end()) {
-				model.getMaterials()[i].baseColorTextureIndex = glTFMaterial.values["baseColorTexture"].TextureIndex();
+			if (glTFMaterial.additionalValues.find("alphaCutoff") != glTFMaterial.additionalValues.end()) {
+				material.alphaCutoff = static_cast<float>(glTFMaterial.additionalValues["alphaCutoff"].Factor());
 			}
+			// Get texture indices, -1 when the material doesn't use the slot
+			material.baseColorTextureIndex			= getTextureIndex(glTFMaterial.values, "baseColorTexture");
+			material.metallicRoughnessTextureIndex	= getTextureIndex(glTFMaterial.values, "metallicRoughnessTexture");
+			material.normalTextureIndex				= getTextureIndex(glTFMaterial.additionalValues, "normalTexture");
+			material.occlusionTextureIndex			= getTextureIndex(glTFMaterial.additionalValues, "occlusionTexture");
+			material.emissiveTextureIndex			= getTextureIndex(glTFMaterial.additionalValues, "emissiveTexture");
+		}
+	}
+
+	/**
+	 * How the materials of a glTF file sample one of its images
+	 */
+	struct ImageUsage
+	{
+		/**
+		 * True when the image holds color data stored in sRGB
+		 */
+		bool srgb{ false };
+
+		/**
+		 * Channels read by the shaders, bit 0 = r, 1 = g, 2 = b, 3 = a
+		 */
+		uint32_t channelMask{ 0 };
+	};
+
+	/**
+	 * Format an image is uploaded with and how its pixels are packed into it
+	 */
+	struct TextureFormat
+	{
+		/**
+		 * Narrowest supported format holding every channel the shaders read
+		 */
+		VkFormat format{ VK_FORMAT_R8G8B8A8_SRGB };
+
+		/**
+		 * Number of channels per pixel of format
+		 */
+		uint32_t channels{ 4 };
+
+		/**
+		 * Source channel written to each stored channel
+		 */
+		ChannelMap packing{ 0, 1, 2, 3 };
+
+		/**
+		 * Image view swizzle that presents the packed channels where the shaders expect them
+		 */
+		VkComponentMapping swizzle{};
+	};
+
+	void markImageUsage(const tinygltf::Model& input, std::vector<ImageUsage>& usages, int textureIndex, bool srgb, uint32_t channelMask)
+	{
+		if (textureIndex < 0 || textureIndex >= static_cast<int>(input.textures.size()))
+		{
+			return;
 		}
+
+		int imageIndex{ input.textures[textureIndex].source };
+		if (imageIndex < 0 || imageIndex >= static_cast<int>(usages.size()))
+		{
+			return;
+		}
+
+		// color wins when an image is (unusually) shared between color and data slots
+		usages[imageIndex].srgb			= usages[imageIndex].srgb || srgb;
+		usages[imageIndex].channelMask	|= channelMask;
 	}
 
-	void loadImages(tinygltf::Model& input, Model& model, const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice)
+	/**
+	 * Works out the color space and channels each image is sampled with from the material slots referencing it
+	 */
+	std::vector<ImageUsage> findImageUsages(const tinygltf::Model& input)
 	{
+		std::vector<ImageUsage> usages(input.images.size());
+
+		for (const tinygltf::Material& material : input.materials)
+		{
+			markImageUsage(input, usages, getTextureIndex(material.values, "baseColorTexture"),				true,	0xF);
+			markImageUsage(input, usages, getTextureIndex(material.values, "metallicRoughnessTexture"),		false,	0x6);	// g = roughness, b = metalness
+			markImageUsage(input, usages, getTextureIndex(material.additionalValues, "normalTexture"),		false,	0x7);
+			markImageUsage(input, usages, getTextureIndex(material.additionalValues, "occlusionTexture"),	false,	0x1);
+			markImageUsage(input, usages, getTextureIndex(material.additionalValues, "emissiveTexture"),	true,	0x7);
+		}
+
+		// images only referenced through extensions (or not at all) are kept as full color
+		for (ImageUsage& usage : usages)
+		{
+			if (usage.channelMask == 0)
+			{
+				usage.srgb			= true;
+				usage.channelMask	= 0xF;
+			}
+		}
+
+		return usages;
+	}
+
+	/**
+	 * Picks the narrowest format the GPU can sample that holds every channel the shaders read from the image
+	 */
+	TextureFormat chooseTextureFormat(const PhysicalDevice* physicalDevice, uint32_t sourceChannels, const ImageUsage& usage)
+	{
+		// source channel behind each of r, g, b, a, following the glTF convention for grey and grey-alpha images
+		ChannelMap sourceOf{ 0, 1, 2, 3 };
+		switch (sourceChannels)
+		{
+		case 1:		sourceOf = { 0, 0, 0, CHANNEL_ONE };	break;
+		case 2:		sourceOf = { 0, 0, 0, 1 };				break;
+		case 3:		sourceOf = { 0, 1, 2, CHANNEL_ONE };	break;
+		default:	break;
+		}
+
+		// pack the distinct source channels that are actually read
+		TextureFormat	textureFormat	{};
+		int8_t			packedIndex[4]	{ -1, -1, -1, -1 };
+		uint32_t		packedCount		{ 0 };
+
+		textureFormat.packing = { CHANNEL_ZERO, CHANNEL_ZERO, CHANNEL_ZERO, CHANNEL_ZERO };
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			int8_t source{ sourceOf[c] };
+			if ((usage.channelMask & (1u << c)) && source >= 0 && packedIndex[source] < 0)
+			{
+				packedIndex[source]							= static_cast<int8_t>(packedCount);
+				textureFormat.packing[packedCount++]		= source;
+			}
+		}
+
+		std::vector<VkFormat> candidates{};
+		if (packedCount <= 1)
+		{
+			candidates = usage.srgb ?
+				std::vector<VkFormat>{ VK_FORMAT_R8_SRGB, VK_FORMAT_R8G8_SRGB, VK_FORMAT_R8G8B8A8_SRGB } :
+				std::vector<VkFormat>{ VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8A8_UNORM };
+		}
+		else if (packedCount == 2)
+		{
+			candidates = usage.srgb ?
+				std::vector<VkFormat>{ VK_FORMAT_R8G8_SRGB, VK_FORMAT_R8G8B8A8_SRGB } :
+				std::vector<VkFormat>{ VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8A8_UNORM };
+		}
+		else
+		{
+			// 3 channel formats are rarely supported for optimal tiling, RGB is padded to RGBA
+			candidates = { usage.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM };
+		}
+
+		textureFormat.format = physicalDevice->findSupportedFormat(
+			candidates,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+		switch (textureFormat.format)
+		{
+		case VK_FORMAT_R8_SRGB:
+		case VK_FORMAT_R8_UNORM:	textureFormat.channels = 1;	break;
+		case VK_FORMAT_R8G8_SRGB:
+		case VK_FORMAT_R8G8_UNORM:	textureFormat.channels = 2;	break;
+		default:					textureFormat.channels = 4;	break;
+		}
+
+		// fill channels the chosen format has beyond the packed ones, alpha is opaque
+		for (uint32_t c = packedCount; c < textureFormat.channels; c++)
+		{
+			textureFormat.packing[c] = (c == 3) ? CHANNEL_ONE : CHANNEL_ZERO;
+		}
+
+		// route each channel the shaders read to where it was packed
+		VkComponentSwizzle* swizzle[4]{
+			&textureFormat.swizzle.r, &textureFormat.swizzle.g, &textureFormat.swizzle.b, &textureFormat.swizzle.a };
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			int8_t source{ sourceOf[c] };
+			if (source == CHANNEL_ONE || !(usage.channelMask & (1u << c)))
+			{
+				*swizzle[c] = (c == 3) ? VK_COMPONENT_SWIZZLE_ONE : VK_COMPONENT_SWIZZLE_ZERO;
+			}
+			else if (static_cast<uint32_t>(packedIndex[source]) == c)
+			{
+				*swizzle[c] = VK_COMPONENT_SWIZZLE_IDENTITY;
+			}
+			else
+			{
+				*swizzle[c] = static_cast<VkComponentSwizzle>(VK_COMPONENT_SWIZZLE_R + packedIndex[source]);
+			}
+		}
+
+		return textureFormat;
+	}
+
+	void loadImages(tinygltf::Model& input, Model& model, const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, UploadBatch& batch)
+	{
+		std::vector<ImageUsage> usages{ findImageUsages(input) };
+
 		// Images can be stored inside the glTF (which is the case for the sample model), so instead of directly
 		// loading them from disk, we fetch them from the glTF loader and upload the buffers
 		model.getTextureImages().resize(input.images.size());
 		for (size_t i = 0; i < input.images.size(); i++) {
-			tinygltf::Image& glTFImage = input.images[i];
-			// Get the image data from the glTF loader
-			unsigned char* buffer = nullptr;
-			VkDeviceSize bufferSize = 0;
-			bool deleteBuffer = false;
-			// We convert RGB-only images to RGBA, as most devices don't support RGB-formats in Vulkan
-			if (glTFImage.component == 3) {
-				bufferSize = glTFImage.width * glTFImage.height * 4;
-				buffer = new unsigned char[bufferSize];
-				unsigned char* rgba = buffer;
-				unsigned char* rgb = &glTFImage.image[0];
-				for (size_t i = 0; i < glTFImage.width * glTFImage.height; ++i) {
-					memcpy(rgba, rgb, sizeof(unsigned char) * 3);
-					rgba += 4;
-					rgb += 3;
-				}
-				deleteBuffer = true;
-			}
-			else {
-				buffer = &glTFImage.image[0];
-				bufferSize = glTFImage.image.size();
-			}
-
-			std::unique_ptr<Buffer> stagingBuffer{ std::make_unique<Buffer>(
-			logicalDevice,
-			physicalDevice,
-			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) };
+			tinygltf::Image&	glTFImage		{ input.images[i] };
+			uint32_t			sourceChannels	{ static_cast<uint32_t>(glTFImage.component) };
+			TextureFormat		textureFormat	{ chooseTextureFormat(physicalDevice, sourceChannels, usages[i]) };
+			uint32_t			width			{ static_cast<uint32_t>(glTFImage.width) };
 
-			void* data;
-			vkMapMemory(*logicalDevice, stagingBuffer->getBufferMemory(), 0, bufferSize, 0, &data);
-			memcpy(data, buffer, static_cast<size_t>(bufferSize));
-			vkUnmapMemory(*logicalDevice, stagingBuffer->getBufferMemory());
+			bool passthrough{ sourceChannels == textureFormat.channels };
+			for (uint32_t c = 0; c < textureFormat.channels; c++)
+			{
+				passthrough = passthrough && (textureFormat.packing[c] == static_cast<int8_t>(c));
+			}
 
 			model.getTextureImages()[i].texture = std::make_unique<Image>(
 				logicalDevice,
 				physicalDevice,
 				glTFImage.width,
 				glTFImage.height,
-				VK_FORMAT_R8G8B8A8_SRGB, 
+				textureFormat.format, 
 				VK_IMAGE_TILING_OPTIMAL,
-				VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
+				// transfer source so the texture can be downgraded when memory runs low
+				VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				VK_IMAGE_ASPECT_COLOR_BIT);
+				VK_IMAGE_ASPECT_COLOR_BIT,
+				MemoryCategory::Texture,
+				textureFormat.swizzle);
 
-			model.getTextureImages()[i].texture->transitionImageLayout(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-			model.getTextureImages()[i].texture->copyFromBuffer(*stagingBuffer, static_cast<uint32_t>(glTFImage.width), static_cast<uint32_t>(glTFImage.height));
-			model.getTextureImages()[i].texture->transitionImageLayout(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-			
-			if (deleteBuffer) 
+			// pack straight into the staging memory, expanding RGB or dropping unread channels as needed
+			auto writeRows = [&](void* data, uint32_t firstRow, uint32_t rowCount)
 			{
-				delete[] buffer;
-			}
+				const uint8_t*	source		{ glTFImage.image.data() + static_cast<size_t>(firstRow) * width * sourceChannels };
+				size_t			pixelCount	{ static_cast<size_t>(rowCount) * width };
+				if (passthrough)
+				{
+					memcpy(data, source, pixelCount * textureFormat.channels);
+				}
+				else
+				{
+					convertPixels(
+						source,
+						sourceChannels,
+						static_cast<uint8_t*>(data),
+						textureFormat.channels,
+						textureFormat.packing,
+						pixelCount);
+				}
+			};
+
+			batch.copyToImage(*model.getTextureImages()[i].texture, textureFormat.format,
+				width, static_cast<uint32_t>(glTFImage.height), textureFormat.channels, writeRows);
 		}
 	}
 
@@ -157,7 +360,7 @@ namespace ash
 		return nodeFound;
 	}
 
-	void loadSkins(tinygltf::Model& input, Model& model, const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice)
+	void loadSkins(tinygltf::Model& input, Model& model)
 	{
 		std::vector<Skin>& skins{ model.getSkins() };
 
@@ -193,16 +396,6 @@ namespace ash
 				memcpy(skins[i].inverseBindMatrices.data(), 
 					&buffer.data[accessor.byteOffset + bufferView.byteOffset], 
 					accessor.count * sizeof(glm::mat4));
-				
-				// TODO: find a way to compress local buffer creation into a reusable function
-
-				VkDeviceSize bufferSize = sizeof(glm::mat4) * skins[i].inverseBindMatrices.size();
-				skins[i].ssbo = Buffer::createDeviceLocalBuffer(
-					logicalDevice, 
-					physicalDevice, 
-					bufferSize, 
-					skins[i].inverseBindMatrices.data(), 
-					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 			}
 		}
 	}
@@ -484,10 +677,26 @@ namespace ash
 							return;
 					}
 				}
+				// Bounding sphere around the center of the primitive's box, used for culling
+				glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+				glm::vec3 boundsMax{ -std::numeric_limits<float>::max() };
+				for (size_t v = vertexStart; v < outVertices.size(); v++)
+				{
+					boundsMin = glm::min(boundsMin, glm::vec3(outVertices[v].pos));
+					boundsMax = glm::max(boundsMax, glm::vec3(outVertices[v].pos));
+				}
+				glm::vec3	center	{ (boundsMin + boundsMax) * 0.5f };
+				float		radius	{ 0.0f };
+				for (size_t v = vertexStart; v < outVertices.size(); v++)
+				{
+					radius = std::max(radius, glm::length(glm::vec3(outVertices[v].pos) - center));
+				}
+
 				Primitive primitive{};
 				primitive.firstIndex	= firstIndex;
 				primitive.indexCount	= indexCount;
 				primitive.materialIndex = glTFPrimitive.material;
+				primitive.bounds		= outVertices.size() > vertexStart ? glm::vec4(center, radius) : glm::vec4(0.0f);
 				node->mesh.primitives.push_back(primitive);
 			}
 		}
@@ -500,7 +709,10 @@ namespace ash
 		}
 	}
 
-	void loadglTFFile(std::string filename, Model& model, const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice)
+	/**
+	 * Loads the glTF file into model, all GPU uploads are recorded into batch
+	 */
+	void loadglTFFile(std::string filename, Model& model, const LogicalDevice* logicalDevice, const PhysicalDevice* physicalDevice, UploadBatch& batch)
 	{
 		tinygltf::Model		glTFInput;
 		tinygltf::TinyGLTF	gltfContext;
@@ -510,7 +722,7 @@ namespace ash
 		bool fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filename);
 
 		if (fileLoaded) {
-			loadImages(glTFInput, model, logicalDevice, physicalDevice);
+			loadImages(glTFInput, model, logicalDevice, physicalDevice, batch);
 			loadMaterials(glTFInput, model);
 			loadTextures(glTFInput, model);
 			const tinygltf::Scene& scene = glTFInput.scenes[0];
@@ -519,7 +731,7 @@ namespace ash
 				const tinygltf::Node node = glTFInput.nodes[scene.nodes[i]];
 				loadNode(node, glTFInput, nullptr, scene.nodes[i], model.getIndices(), model.getVertices(), model.getNodes());
 			}
-			loadSkins(glTFInput, model, logicalDevice, physicalDevice);
+			loadSkins(glTFInput, model);
 			loadAnimations(glTFInput, model);
 		}
 		else 
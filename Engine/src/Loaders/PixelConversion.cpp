@@ -0,0 +1,149 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Loaders/PixelConversion.h"
+#include "Utils/CpuFeatures.h"
+
+#if defined(ASH_X86)
+#include <tmmintrin.h>	// SSSE3
+#endif
+
+#include <cstring>
+
+namespace ash
+{
+	namespace
+	{
+		void convertPixelsScalar(
+			const uint8_t* src,
+			uint32_t srcChannels,
+			uint8_t* dst,
+			uint32_t dstChannels,
+			const ChannelMap& channelMap,
+			size_t pixelCount)
+		{
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				for (uint32_t c = 0; c < dstChannels; c++)
+				{
+					int8_t source{ channelMap[c] };
+					if (source >= 0)
+					{
+						dst[c] = src[source];
+					}
+					else
+					{
+						dst[c] = (source == CHANNEL_ONE) ? 0xFF : 0x00;
+					}
+				}
+				src += srcChannels;
+				dst += dstChannels;
+			}
+		}
+
+#if defined(ASH_X86)
+		/**
+		 * Converts pixels in blocks of 16. Every 16 byte load holds 4 source pixels (the
+		 * 3 channel case ignores the last 4 bytes), which are shuffled into place in the
+		 * destination vector and merged. Returns the number of pixels converted, the
+		 * remainder is left to the scalar path.
+		 */
+		ASH_TARGET("ssse3")
+		size_t convertPixelsSsse3(
+			const uint8_t* src,
+			uint32_t srcChannels,
+			uint8_t* dst,
+			uint32_t dstChannels,
+			const ChannelMap& channelMap,
+			size_t pixelCount)
+		{
+			const uint32_t	loadsPerStore	{ 4 / dstChannels };
+			alignas(16) uint8_t shuffles[4][16];
+			alignas(16) uint8_t constants[16];
+
+			// shuffle q places the 4 pixels of a load at destination pixels [q*4, q*4 + 4) of the store
+			for (uint32_t q = 0; q < loadsPerStore; q++)
+			{
+				memset(shuffles[q], 0x80, sizeof(shuffles[q]));
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					for (uint32_t c = 0; c < dstChannels; c++)
+					{
+						int8_t source{ channelMap[c] };
+						if (source >= 0)
+						{
+							shuffles[q][(q * 4 + p) * dstChannels + c] = static_cast<uint8_t>(p * srcChannels + source);
+						}
+					}
+				}
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				constants[i] = (channelMap[i % dstChannels] == CHANNEL_ONE) ? 0xFF : 0x00;
+			}
+
+			const __m128i one{ _mm_load_si128(reinterpret_cast<const __m128i*>(constants)) };
+			__m128i masks[4];
+			for (uint32_t q = 0; q < loadsPerStore; q++)
+			{
+				masks[q] = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffles[q]));
+			}
+
+			// a 3 channel load reads 4 bytes past its last pixel, keep two pixels in reserve for the tail
+			const size_t	reserve		{ srcChannels == 3 ? size_t{ 2 } : size_t{ 0 } };
+			const size_t	srcStride	{ size_t{ 4 } * srcChannels };
+			size_t			converted	{ 0 };
+
+			while (converted + 16 + reserve <= pixelCount)
+			{
+				for (uint32_t store = 0; store < dstChannels; store++)
+				{
+					__m128i result{ one };
+					for (uint32_t q = 0; q < loadsPerStore; q++)
+					{
+						__m128i pixels{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)) };
+						result = _mm_or_si128(result, _mm_shuffle_epi8(pixels, masks[q]));
+						src += srcStride;
+					}
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), result);
+					dst += 16;
+				}
+				converted += 16;
+			}
+
+			return converted;
+		}
+#endif
+	}
+
+	void convertPixels(
+		const uint8_t* src,
+		uint32_t srcChannels,
+		uint8_t* dst,
+		uint32_t dstChannels,
+		const ChannelMap& channelMap,
+		size_t pixelCount)
+	{
+		size_t converted{ 0 };
+
+#if defined(ASH_X86)
+		bool vectorizable{
+			(srcChannels == 3 || srcChannels == 4) &&
+			(dstChannels == 1 || dstChannels == 2 || dstChannels == 4) };
+
+		if (vectorizable && getCpuFeatures().ssse3)
+		{
+			converted = convertPixelsSsse3(src, srcChannels, dst, dstChannels, channelMap, pixelCount);
+		}
+#endif
+
+		convertPixelsScalar(
+			src + converted * srcChannels,
+			srcChannels,
+			dst + converted * dstChannels,
+			dstChannels,
+			channelMap,
+			pixelCount - converted);
+	}
+}
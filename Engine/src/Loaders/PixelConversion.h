@@ -0,0 +1,43 @@
+/**
+ * Channel packing and expansion kernels used when uploading textures
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ash
+{
+	/**
+	 * Channel map value that writes 0 into the destination channel
+	 */
+	constexpr int8_t CHANNEL_ZERO{ -1 };
+
+	/**
+	 * Channel map value that writes 255 into the destination channel
+	 */
+	constexpr int8_t CHANNEL_ONE{ -2 };
+
+	/**
+	 * For each destination channel, the source channel index it is read from,
+	 * or CHANNEL_ZERO / CHANNEL_ONE for a constant
+	 */
+	using ChannelMap = std::array<int8_t, 4>;
+
+	/**
+	 * Converts 8 bit per channel pixels between channel layouts,
+	 * e.g. RGB -> RGBA expansion or RGBA -> R extraction.
+	 * Uses SSSE3 byte shuffles when the CPU supports them, scalar code otherwise.
+	 * src and dst must not overlap.
+	 */
+	void convertPixels(
+		const uint8_t* src,
+		uint32_t srcChannels,
+		uint8_t* dst,
+		uint32_t dstChannels,
+		const ChannelMap& channelMap,
+		size_t pixelCount);
+}
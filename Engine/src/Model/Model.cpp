@@ -12,6 +12,8 @@
 //#include <stb_image.h>
 
 
+#include <algorithm>
+#include <cstddef>
 #include <stdexcept>
 
 namespace ash
@@ -19,20 +21,26 @@ namespace ash
 	Model::Model(
 		const LogicalDevice* logicalDevice, 
 		const PhysicalDevice* physicalDevice, 
+		GeometryHeap* geometryHeap,
 		const int swapChainImageCount, 
 		VkDescriptorSetLayout setLayout, 
-		VkDescriptorPool pool,
 		VkSampler sampler, 
-		std::vector<std::unique_ptr<Buffer>>& uniformBuffers,
 		std::string modelPath) :
-		m_logicalDevice{ logicalDevice }
+		m_logicalDevice{ logicalDevice }, m_physicalDevice{ physicalDevice }, m_geometryHeap{ geometryHeap }
 	{
+		// every upload of the model goes out in one submission
+		UploadBatch batch{ logicalDevice, physicalDevice };
+
 		//createTexture(physicalDevice, texturePath);
-		loadglTFFile(modelPath, *this, logicalDevice, physicalDevice);
+		loadglTFFile(modelPath, *this, logicalDevice, physicalDevice, batch);
 		std::cout << "Vertices count: " << m_vertices.size() << '\n';
 		//loadModel(modelPath, m_vertices, m_indices);
-		createVertexBuffer(physicalDevice);
-		createIndexBuffer(physicalDevice);
+		m_geometry = m_geometryHeap->allocate(m_vertices, m_indices, batch);
+		computeBounds();
+		computeOccluder();
+
+		batch.submit();
+		batch.wait();
 		//createUniformBuffers(physicalDevice, swapChainImageCount);
 
 		std::cout << "Image count: " << m_textureImages.size() << '\n';
@@ -42,63 +50,47 @@ namespace ash
 
 	Model::~Model()
 	{
-	}
-
-	void Model::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, size_t index,TransformComponent* transform)
-	{
-		VkBuffer vertexBuffers[] = { *m_vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		
-		//vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		//vkCmdBindIndexBuffer(commandBuffer, *m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-		PushConstantData push{};
-		auto newTransform = transform->mat4();
-		push.transform = transform->mat4();
-
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantData), &push);
-		/*
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);*/
+		m_geometryHeap->free(m_geometry);
 
-		// All vertices and indices are stored in single buffers, so we only need to bind once
-
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, *m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		// Render all nodes at top-level
-		for (auto& node : nodes) {
-			drawNode(commandBuffer, pipelineLayout, *node);
+		// texture sets go back to the allocator, which reuses them once the frames being recorded are done
+		if (m_descriptorAllocator)
+		{
+			for (auto& image : m_textureImages)
+			{
+				if (image.descriptorSet)
+				{
+					m_descriptorAllocator->release(m_textureSetLayout, image.descriptorSet);
+				}
+			}
 		}
-	}
 
-	void Model::createVertexBuffer(const PhysicalDevice* physicalDevice)
-	{
-		VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
-
-		m_vertexBuffer = Buffer::createDeviceLocalBuffer(
-			m_logicalDevice, 
-			physicalDevice, 
-			bufferSize, 
-			m_vertices.data(), 
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		if (m_bindlessSet)
+		{
+			for (auto& image : m_textureImages)
+			{
+				m_bindlessSet->removeTexture(image.bindlessIndex);
+			}
+			for (auto& material : m_materials)
+			{
+				m_bindlessSet->removeMaterial(material.bindlessIndex);
+			}
+		}
 	}
 
-	void Model::createIndexBuffer(const PhysicalDevice* physicalDevice)
+	void Model::enqueue(RenderQueue& queue, const glm::mat4& transform)
 	{
-		VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
-
-		m_indexBuffer = Buffer::createDeviceLocalBuffer(
-			m_logicalDevice,
-			physicalDevice,
-			bufferSize,
-			m_indices.data(),
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+		// All vertices and indices live in the geometry heap, which is bound once per frame
+		// Queue all nodes at top-level
+		uint32_t transformIndex = queue.addTransform(transform);
+		for (auto& node : nodes) {
+			enqueueNode(queue, *node, transform, transformIndex);
+		}
 	}
 
 
-	void Model::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Node node)
+	void Model::enqueueNode(RenderQueue& queue, const Node& node, const glm::mat4& transform, uint32_t transformIndex)
 	{
 		if (node.mesh.primitives.size() > 0) {
-			// Pass the node's matrix via push constants
 			// Traverse the node hierarchy to the top-most parent to get the final matrix of the current node
 			glm::mat4 nodeMatrix = node.matrix;
 			Node* currentParent = node.parent;
@@ -106,57 +98,301 @@ namespace ash
 				nodeMatrix = currentParent->matrix * nodeMatrix;
 				currentParent = currentParent->parent;
 			}
-			// Pass the final matrix to the vertex shader using push constants
-			//vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
-			for (Primitive& primitive : node.mesh.primitives) {
+			// The node's origin is used to sort its primitives front to back
+			glm::vec3 position = transform * nodeMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+			DrawCommand command{};
+			command.transformIndex = transformIndex;
+			command.vertexOffset = static_cast<int32_t>(m_geometry.vertexOffset);
+			// Skinned nodes read their joints from the palette, -1 leaves the vertices unskinned
+			command.jointOffset = node.skin > -1 ? static_cast<int32_t>(m_skins[node.skin].jointOffset) : -1;
+
+			for (const Primitive& primitive : node.mesh.primitives) {
 				if (primitive.indexCount > 0) {
-					// Get the texture index for this primitive
-					Texture texture = m_textures[m_materials[primitive.materialIndex].baseColorTextureIndex];
-					// Bind the descriptor for the current primitive's texture
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &m_textureImages[texture.imageIndex].descriptorSet, 0, nullptr);
-					vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+					const Material* material = primitive.materialIndex >= 0 ? &m_materials[primitive.materialIndex] : nullptr;
+					// Every draw binds a set without bindless, so a chunk never inherits another draw's texture
+					command.textureSet = m_bindlessSet ? VK_NULL_HANDLE : m_defaultTextureSet;
+					command.materialIndex = 0;
+					if (m_bindlessSet) {
+						// The bindless set is bound once per frame, only the material index changes
+						command.materialIndex = material ? material->bindlessIndex : BindlessSet::DEFAULT_MATERIAL;
+					}
+					else if (material && material->baseColorTextureIndex >= 0) {
+						// The descriptor set of the primitive's texture
+						const Texture& texture = m_textures[material->baseColorTextureIndex];
+						command.textureSet = m_textureImages[texture.imageIndex].descriptorSet;
+					}
+					// Primitive ranges are relative to the model's range of the geometry heap
+					command.indexCount = primitive.indexCount;
+					command.firstIndex = m_geometry.firstIndex + primitive.firstIndex;
+					// Joints can move skinned vertices anywhere, only rigid primitives are culled
+					command.bounds = node.skin > -1 ? glm::vec4(0.0f, 0.0f, 0.0f, -1.0f) : primitive.bounds;
+					queue.add(command, position);
 				}
 			}
 		}
 		for (auto& child : node.children) {
-			drawNode(commandBuffer, pipelineLayout, *child);
+			enqueueNode(queue, *child, transform, transformIndex);
+		}
+	}
+
+	void Model::computeBounds()
+	{
+		m_bounds = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+		if (!m_skins.empty())
+		{
+			return;
+		}
+
+		// the vertices are drawn with the game object's transform alone, so the primitive spheres
+		// are already in model space, the same space the draws and the GPU culler test them in
+		std::vector<glm::vec4>	spheres	{};
+		std::vector<Node*>		stack	{ nodes };
+		while (!stack.empty())
+		{
+			Node* node{ stack.back() };
+			stack.pop_back();
+			stack.insert(stack.end(), node->children.begin(), node->children.end());
+
+			for (const Primitive& primitive : node->mesh.primitives)
+			{
+				if (primitive.indexCount > 0)
+				{
+					spheres.push_back(primitive.bounds);
+				}
+			}
+		}
+
+		if (spheres.empty() || std::any_of(spheres.begin(), spheres.end(), [](const glm::vec4& sphere) { return sphere.w < 0.0f; }))
+		{
+			return;
 		}
+
+		// centered on the box around the spheres, large enough to reach the farthest one
+		glm::vec3 minimum{ glm::vec3(spheres[0]) - spheres[0].w };
+		glm::vec3 maximum{ glm::vec3(spheres[0]) + spheres[0].w };
+		for (const glm::vec4& sphere : spheres)
+		{
+			minimum = glm::min(minimum, glm::vec3(sphere) - sphere.w);
+			maximum = glm::max(maximum, glm::vec3(sphere) + sphere.w);
+		}
+
+		glm::vec3	center	{ (minimum + maximum) * 0.5f };
+		float		radius	{ 0.0f };
+		for (const glm::vec4& sphere : spheres)
+		{
+			radius = std::max(radius, glm::length(glm::vec3(sphere) - center) + sphere.w);
+		}
+		m_bounds = glm::vec4(center, radius);
 	}
 
-	void Model::createDescriptorSets(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkSampler sampler)
+	void Model::computeOccluder()
 	{
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = pool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = &layout;
+		// enough triangles for the silhouette of a building or a rock at the occlusion buffer's resolution
+		constexpr uint32_t MAX_OCCLUDER_TRIANGLES{ 256 };
+
+		m_occluder = OccluderMesh{};
+		if (!m_skins.empty())
+		{
+			return;
+		}
+
+		// the triangles of every primitive in mesh space, where the draws place the vertices,
+		// simplifyOccluder keeps only the vertices they use
+		std::vector<glm::vec3>	positions	{};
+		std::vector<uint32_t>	indices		{};
+		std::vector<Node*>		stack		{ nodes };
+		positions.reserve(m_vertices.size());
+		for (const Vertex& vertex : m_vertices)
+		{
+			positions.push_back(vertex.pos);
+		}
+		while (!stack.empty())
+		{
+			Node* node{ stack.back() };
+			stack.pop_back();
+			stack.insert(stack.end(), node->children.begin(), node->children.end());
+
+			for (const Primitive& primitive : node->mesh.primitives)
+			{
+				indices.insert(indices.end(), m_indices.begin() + primitive.firstIndex,
+					m_indices.begin() + primitive.firstIndex + primitive.indexCount);
+			}
+		}
+
+		m_occluder = simplifyOccluder(positions, indices, MAX_OCCLUDER_TRIANGLES);
+	}
+
+	void Model::createDescriptorSets(DescriptorAllocator& allocator, VkDescriptorSetLayout layout, VkSampler sampler, VkDescriptorSet defaultSet)
+	{
+		m_descriptorAllocator	= &allocator;
+		m_textureSetLayout		= layout;
+		m_textureSampler		= sampler;
+		m_defaultTextureSet		= defaultSet;
 
 		for (auto& image : m_textureImages)
 		{
-			if (vkAllocateDescriptorSets(*m_logicalDevice, &allocInfo, &image.descriptorSet) != VK_SUCCESS)
+			// sets live as long as the model, they survive swap chain recreation
+			if (image.descriptorSet)
 			{
-				throw std::runtime_error("railed to allocate descriptor sets!");
+				continue;
 			}
+			image.descriptorSet = allocator.allocate(layout);
+			writeDescriptorSet(image);
+		}
+	}
 
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = *image.texture;	// * returns image view
-			imageInfo.sampler = sampler;
+	void Model::writeDescriptorSet(const TextureImage& image)
+	{
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = *image.texture;	// * returns image view
+		imageInfo.sampler = m_textureSampler;
+
+		std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = image.descriptorSet;
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(*m_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
 
-			std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+	VkDeviceSize Model::downgradeTextures(uint32_t heapIndex, VkDeviceSize bytesNeeded)
+	{
+		// textures keep enough detail to be recognizable from a distance
+		constexpr uint32_t MIN_TEXTURE_SIZE{ 64 };
+		constexpr VkFormatFeatureFlags BLIT_FEATURES{ VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+			| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT };
 
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = image.descriptorSet;
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pImageInfo = &imageInfo;
+		std::vector<TextureImage*> candidates{};
+		for (auto& image : m_textureImages)
+		{
+			const Image& texture{ *image.texture };
 
-			vkUpdateDescriptorSets(*m_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+			VkFormatProperties properties{};
+			vkGetPhysicalDeviceFormatProperties(*m_physicalDevice, texture.getFormat(), &properties);
+			if (texture.getAllocation().heapIndex == heapIndex
+				&& std::min(texture.getWidth(), texture.getHeight()) / 2 >= MIN_TEXTURE_SIZE
+				&& (properties.optimalTilingFeatures & BLIT_FEATURES) == BLIT_FEATURES)
+			{
+				candidates.push_back(&image);
+			}
+		}
+		if (candidates.empty())
+		{
+			return 0;
 		}
 
+		// the largest textures first, so as few as possible lose detail
+		std::sort(candidates.begin(), candidates.end(), [](const TextureImage* a, const TextureImage* b)
+			{
+				return a->texture->getAllocation().size > b->texture->getAllocation().size;
+			});
+
+		// the replaced textures are destroyed once the blits reading them are done
+		std::vector<std::unique_ptr<Image>>	replaced		{};
+		VkDeviceSize						released		{ 0 };
+		VkCommandBuffer						commandBuffer	{ m_logicalDevice->beginSingleTimeCommand() };
+		for (TextureImage* image : candidates)
+		{
+			if (released >= bytesNeeded)
+			{
+				break;
+			}
+
+			Image&		source	{ *image->texture };
+			VkFormat	format	{ source.getFormat() };
+			auto downgraded{ std::make_unique<Image>(
+				m_logicalDevice,
+				m_physicalDevice,
+				source.getWidth() / 2,
+				source.getHeight() / 2,
+				format,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT,
+				MemoryCategory::Texture,
+				source.getComponents()) };
+
+			source.transitionImageLayout(commandBuffer, format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+			downgraded->transitionImageLayout(commandBuffer, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			source.blitTo(commandBuffer, *downgraded);
+			downgraded->transitionImageLayout(commandBuffer, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+			released += source.getAllocation().size - std::min(source.getAllocation().size, downgraded->getAllocation().size);
+			replaced.push_back(std::move(image->texture));
+			image->texture = std::move(downgraded);
+		}
+		m_logicalDevice->endSingleTimeCommand(commandBuffer);
 
+		// the descriptors aren't used by any frame in flight, point them at the new textures in place
+		for (size_t i = 0; i < replaced.size(); i++)
+		{
+			if (m_bindlessSet)
+			{
+				m_bindlessSet->updateTexture(candidates[i]->bindlessIndex, *candidates[i]->texture);
+			}
+			else if (candidates[i]->descriptorSet)
+			{
+				writeDescriptorSet(*candidates[i]);
+			}
+		}
+		replaced.clear();
+
+		return released;
+	}
+
+	void Model::createBindlessResources(BindlessSet* bindlessSet)
+	{
+		// resources survive swap chain recreation, register them once
+		if (m_bindlessSet)
+		{
+			return;
+		}
+		m_bindlessSet = bindlessSet;
+
+		for (auto& image : m_textureImages)
+		{
+			image.bindlessIndex = m_bindlessSet->addTexture(*image.texture);	// * returns image view
+		}
+
+		for (auto& material : m_materials)
+		{
+			MaterialData data{};
+			data.baseColorFactor			= material.baseColorFactor;
+			data.emissiveFactor				= glm::vec4(material.emissiveFactor, 0.0f);
+			data.metallicFactor				= material.metallicFactor;
+			data.roughnessFactor			= material.roughnessFactor;
+			data.alphaCutoff				= material.alphaCutoff;
+			data.baseColorTexture			= getBindlessTextureIndex(material.baseColorTextureIndex);
+			data.metallicRoughnessTexture	= getBindlessTextureIndex(material.metallicRoughnessTextureIndex);
+			data.normalTexture				= getBindlessTextureIndex(material.normalTextureIndex);
+			data.occlusionTexture			= getBindlessTextureIndex(material.occlusionTextureIndex);
+			data.emissiveTexture			= getBindlessTextureIndex(material.emissiveTextureIndex);
+
+			material.bindlessIndex = m_bindlessSet->addMaterial(data);
+		}
+	}
+
+	int32_t Model::getBindlessTextureIndex(int32_t textureIndex) const
+	{
+		if (textureIndex < 0 || textureIndex >= static_cast<int32_t>(m_textures.size()))
+		{
+			return -1;
+		}
+
+		int32_t imageIndex{ m_textures[textureIndex].imageIndex };
+		if (imageIndex < 0 || imageIndex >= static_cast<int32_t>(m_textureImages.size()))
+		{
+			return -1;
+		}
+		return static_cast<int32_t>(m_textureImages[imageIndex].bindlessIndex);
 	}
 
 	glm::mat4 Model::getNodeMatrix(Node* node)
@@ -172,28 +408,40 @@ namespace ash
 		return nodeMatrix;
 	}
 
-	void Model::updateJoints(Node* node)
+	void Model::updateJoints(JointPalette& palette)
+	{
+		if (m_skins.empty())
+		{
+			return;
+		}
+
+		for (auto& node : nodes)
+		{
+			updateJoints(node, palette);
+		}
+	}
+
+	void Model::updateJoints(Node* node, JointPalette& palette)
 	{
 		if (node->skin > -1)
 		{
-			// update the joint matrices
+			// update the joint matrices, straight into this frame's section of the palette
 			glm::mat4 inverseTransform{ glm::inverse(getNodeMatrix(node)) };
 			Skin& skin = m_skins[node->skin];
-			size_t numJoints{ (uint32_t)skin.joints.size() };
-			std::vector<glm::mat4> jointMatrices(numJoints);
-			for (size_t i = 0; i < numJoints; i++)
+			uint32_t numJoints{ static_cast<uint32_t>(skin.joints.size()) };
+			skin.jointOffset = palette.allocate(numJoints);
+			glm::mat4* jointMatrices{ palette.getJoints(skin.jointOffset) };
+			for (uint32_t i = 0; i < numJoints; i++)
 			{
-				jointMatrices[i] = getNodeMatrix(skin.joints[i]) * skin.inverseBindMatrices[i];
-				jointMatrices[i] = inverseTransform * jointMatrices[i];
+				// skins without inverse bind matrices use identity
+				glm::mat4 inverseBindMatrix{ i < skin.inverseBindMatrices.size() ? skin.inverseBindMatrices[i] : glm::mat4(1.0f) };
+				jointMatrices[i] = inverseTransform * getNodeMatrix(skin.joints[i]) * inverseBindMatrix;
 			}
-
-			// update ssbo
-			skin.ssbo->copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
 		}
 		
 		for (auto& child : node->children)
 		{
-			updateJoints(child);
+			updateJoints(child, palette);
 		}
 	}
 
@@ -253,10 +501,6 @@ namespace ash
 				}
 			}
 		}
-		for (auto& node : nodes)
-		{
-			updateJoints(node);
-		}
 	}
 
 	// NOT CURRENTLY USED: textures are now loaded directly from glTF files
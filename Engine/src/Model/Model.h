@@ -9,9 +9,16 @@
 #include "Vulkan/LogicalDevice.h"
 #include "Vulkan/Buffer.h"
 #include "Vulkan/Image.h"
+#include "Vulkan/BindlessSet.h"
+#include "Vulkan/UploadBatch.h"
+#include "Vulkan/GeometryHeap.h"
+#include "Vulkan/JointPalette.h"
+#include "Vulkan/DescriptorAllocator.h"
 #include "Vulkan/Vertex.hpp"
 #include "Vulkan/PushConstantData.hpp"
 #include "TransformComponent.hpp"
+#include "RenderQueue.h"
+#include "OcclusionBuffer.h"
 
 #include <vulkan/vulkan.h>
 
@@ -30,6 +37,7 @@ namespace ash
 		uint32_t firstIndex;
 		uint32_t indexCount;
 		int32_t materialIndex;
+		glm::vec4 bounds;	// bounding sphere of the vertices, center and radius
 	};
 
 	// Contains the node's (optional) geometry and can be made up of an arbitrary number of primitives
@@ -60,8 +68,7 @@ namespace ash
 		Node*						skeletonRoot			{ nullptr };
 		std::vector<glm::mat4>		inverseBindMatrices		{};
 		std::vector<Node*>			joints					{};
-		std::unique_ptr<Buffer>		ssbo					{};
-		VkDescriptorSet				descriptorSet			{};
+		uint32_t					jointOffset				{ 0 };	// first joint in this frame's section of the joint palette
 	};
 
 	// Contains key frame data
@@ -92,10 +99,21 @@ namespace ash
 	};
 
 	// A glTF material stores information in e.g. the texture that is attached to it and colors
+	// Texture indices are -1 when the material doesn't use the slot
 	struct Material 
 	{
 		glm::vec4 baseColorFactor = glm::vec4(1.0f);
-		uint32_t baseColorTextureIndex;
+		int32_t baseColorTextureIndex = -1;
+		glm::vec3 emissiveFactor = glm::vec3(0.0f);
+		float metallicFactor = 1.0f;
+		float roughnessFactor = 1.0f;
+		float alphaCutoff = 0.5f;
+		int32_t metallicRoughnessTextureIndex = -1;
+		int32_t normalTextureIndex = -1;
+		int32_t occlusionTextureIndex = -1;
+		int32_t emissiveTextureIndex = -1;
+		// Slot of the material in the bindless material buffer
+		uint32_t bindlessIndex = BindlessSet::DEFAULT_MATERIAL;
 	};
 
 	// Contains the texture for a single glTF image
@@ -104,7 +122,9 @@ namespace ash
 	{
 		std::unique_ptr<Image> texture;
 		// We also store (and create) a descriptor set that's used to access this texture from the fragment shader
-		VkDescriptorSet descriptorSet;
+		VkDescriptorSet descriptorSet{};
+		// Slot of the texture in the bindless texture array
+		uint32_t bindlessIndex;
 	};
 
 	// A glTF texture stores a reference to the image and a sampler
@@ -123,30 +143,36 @@ namespace ash
 		Model(
 			const LogicalDevice* logicalDevice, 
 			const PhysicalDevice* physicalDevice,
+			GeometryHeap* geometryHeap,
 			const int swapChainImageCount, 
 			VkDescriptorSetLayout setLayout, 
-			VkDescriptorPool pool,
 			VkSampler sampler, 
-			std::vector<std::unique_ptr<Buffer>>& uniformBuffers,
 			std::string modelPath
 		);
 
 		~Model();
 
 		/**
-		 * Binds buffers and descriptor set, then calls draw command
+		 * Adds a draw for every primitive to the queue, transform places the model in the world
 		 */
-		void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, size_t index, TransformComponent* transform);
+		void enqueue(RenderQueue& queue, const glm::mat4& transform);
 
 		/**
-		 * Creates buffer to hold vertices
+		 * Returns the model's range of the geometry heap
 		 */
-		void createVertexBuffer(const PhysicalDevice* physicalDevice);
+		const GeometryAllocation& getGeometry() const { return m_geometry; }
 
 		/**
-		 * Creates buffer to hold indices of vertices
+		 * Returns the sphere enclosing every primitive in model space, the radius is negative
+		 * when the model has skins and so can't be culled
 		 */
-		void createIndexBuffer(const PhysicalDevice* physicalDevice);
+		const glm::vec4& getBounds() const { return m_bounds; }
+
+		/**
+		 * Returns a simplified copy of the triangles in model space for the occlusion buffer,
+		 * empty when the model has skins
+		 */
+		const OccluderMesh& getOccluder() const { return m_occluder; }
 
 		/**
 		 * NOT CURRENTLY USED: textures are now loaded directly from glTF files
@@ -170,10 +196,34 @@ namespace ash
 		
 		std::vector<Animation>& getAnimations() { return m_animations; }
 
-		// Draw a single node including child nodes (if present)
-		void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, Node node);
+		// Queue a single node including child nodes (if present)
+		void enqueueNode(RenderQueue& queue, const Node& node, const glm::mat4& transform, uint32_t transformIndex);
+
+		/**
+		 * Allocates a descriptor set per texture image from allocator, images that already have one are skipped
+		 * @param defaultSet bound by primitives without a base color texture
+		 */
+		void createDescriptorSets(DescriptorAllocator& allocator, VkDescriptorSetLayout layout, VkSampler sampler, VkDescriptorSet defaultSet);
+
+		/**
+		 * Registers textures and materials with the bindless set, replaces createDescriptorSets
+		 * when bindless rendering is enabled. Only the first call does any work
+		 */
+		void createBindlessResources(BindlessSet* bindlessSet);
+
+		/**
+		 * Replaces the largest textures on the heap with copies of half their size until bytesNeeded
+		 * are released or every texture is at its minimum size. No frame in flight may use the model
+		 * @return number of bytes released
+		 */
+		VkDeviceSize downgradeTextures(uint32_t heapIndex, VkDeviceSize bytesNeeded);
+
+		/**
+		 * Count of submitted frames once the last frame drawing the model is submitted
+		 */
+		uint64_t getLastUsedFrame() const { return m_lastUsedFrame; }
 
-		void createDescriptorSets(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkSampler sampler);
+		void setLastUsedFrame(uint64_t frame) { m_lastUsedFrame = frame; }
 
 		/**
 		 * returns the transform matrix of the provided node
@@ -182,12 +232,14 @@ namespace ash
 		glm::mat4 getNodeMatrix(Node* node);
 
 		/**
-		 * updates joints for given node
+		 * writes the joint matrices of every skin into the current frame's section of palette,
+		 * must be called each frame before the model is drawn
 		 */
-		void updateJoints(Node* node);
+		void updateJoints(JointPalette& palette);
 
 		/**
-		 * updates animation based on time passed since last frame
+		 * updates animation based on time passed since last frame,
+		 * the joints follow when they are next written to the palette
 		 */
 		void updateAnimation(float deltaTime);
 
@@ -198,6 +250,11 @@ namespace ash
 		 */
 		const LogicalDevice* m_logicalDevice{};
 
+		/**
+		 * Vulkan Physical Device, used to create downgraded textures
+		 */
+		const PhysicalDevice* m_physicalDevice{};
+
 		/**
 		 * Vertex data of model
 		 */
@@ -209,14 +266,24 @@ namespace ash
 		std::vector<uint32_t> m_indices;
 
 		/**
-		 * Buffer to hold vertex data
+		 * Shared buffers the vertices and indices are uploaded to
 		 */
-		std::unique_ptr<Buffer> m_vertexBuffer;
-		
+		GeometryHeap* m_geometryHeap{};
+
+		/**
+		 * Range of the geometry heap holding the vertices and indices
+		 */
+		GeometryAllocation m_geometry{};
+
+		/**
+		 * Sphere enclosing every primitive, see getBounds
+		 */
+		glm::vec4 m_bounds{ 0.0f, 0.0f, 0.0f, -1.0f };
+
 		/**
-		 * Buffer to hold index of vertices
+		 * Occluder built from the geometry, see getOccluder
 		 */
-		std::unique_ptr<Buffer> m_indexBuffer;
+		OccluderMesh m_occluder{};
 
 		/**
 		 * Texture to be displayed on geometry during fragment stage of pipeline
@@ -257,5 +324,57 @@ namespace ash
 		 * index of the currently active animation
 		 */
 		uint32_t m_activeAnimation{ 0 };
+
+		/**
+		 * set the textures and materials are registered with, null unless bindless rendering is enabled
+		 */
+		BindlessSet* m_bindlessSet{};
+
+		/**
+		 * Allocator the texture sets came from and their layout, the sets are released to it on destruction
+		 */
+		DescriptorAllocator* m_descriptorAllocator{};
+
+		VkDescriptorSetLayout m_textureSetLayout{};
+
+		/**
+		 * Sampler the texture sets are written with
+		 */
+		VkSampler m_textureSampler{};
+
+		/**
+		 * Texture set of primitives without a base color texture, owned by Graphics
+		 */
+		VkDescriptorSet m_defaultTextureSet{};
+
+		/**
+		 * See getLastUsedFrame
+		 */
+		uint64_t m_lastUsedFrame{ 0 };
+
+		/**
+		 * writes the joint matrices of the given node's skin and those of its children
+		 */
+		void updateJoints(Node* node, JointPalette& palette);
+
+		/**
+		 * returns the bindless texture slot of a glTF texture index, -1 for no texture
+		 */
+		int32_t getBindlessTextureIndex(int32_t textureIndex) const;
+
+		/**
+		 * Points the image's descriptor set at its texture
+		 */
+		void writeDescriptorSet(const TextureImage& image);
+
+		/**
+		 * Sets m_bounds from the primitives' bounding spheres in mesh space, where the draws place the vertices
+		 */
+		void computeBounds();
+
+		/**
+		 * Sets m_occluder from the primitives' triangles in mesh space, where the draws place the vertices
+		 */
+		void computeOccluder();
 	};
 }
@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Utils/CpuFeatures.h"
+
+#if defined(ASH_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include <cstdint>
+
+namespace ash
+{
+	namespace
+	{
+#if defined(ASH_X86)
+		void cpuid(int leaf, int subLeaf, uint32_t registers[4])
+		{
+#if defined(_MSC_VER)
+			int values[4];
+			__cpuidex(values, leaf, subLeaf);
+			for (int i = 0; i < 4; i++)
+			{
+				registers[i] = static_cast<uint32_t>(values[i]);
+			}
+#else
+			__cpuid_count(leaf, subLeaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+		}
+
+		/**
+		 * Returns true when the OS saves the AVX (YMM) register state on context switches
+		 */
+		bool osSupportsAvx()
+		{
+#if defined(_MSC_VER)
+			return (_xgetbv(0) & 0x6) == 0x6;
+#else
+			uint32_t eax, edx;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return (eax & 0x6) == 0x6;
+#endif
+		}
+#endif
+
+		CpuFeatures queryCpuFeatures()
+		{
+			CpuFeatures features{};
+
+#if defined(ASH_X86)
+			uint32_t registers[4]{};
+			cpuid(0, 0, registers);
+			uint32_t maxLeaf{ registers[0] };
+
+			if (maxLeaf >= 1)
+			{
+				cpuid(1, 0, registers);
+				features.sse2	= (registers[3] & (1u << 26)) != 0;
+				features.ssse3	= (registers[2] & (1u << 9)) != 0;
+				features.sse41	= (registers[2] & (1u << 19)) != 0;
+				features.fma	= (registers[2] & (1u << 12)) != 0;
+
+				bool osxsave	{ (registers[2] & (1u << 27)) != 0 };
+				bool avxBit		{ (registers[2] & (1u << 28)) != 0 };
+				features.avx	= osxsave && avxBit && osSupportsAvx();
+			}
+
+			if (maxLeaf >= 7 && features.avx)
+			{
+				cpuid(7, 0, registers);
+				features.avx2 = (registers[1] & (1u << 5)) != 0;
+			}
+
+			features.fma = features.fma && features.avx;
+#endif
+
+			return features;
+		}
+	}
+
+	const CpuFeatures& getCpuFeatures()
+	{
+		static const CpuFeatures features{ queryCpuFeatures() };
+		return features;
+	}
+}
@@ -0,0 +1,39 @@
+/**
+ * Runtime detection of SIMD instruction sets supported by the CPU
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ASH_X86 1
+#endif
+
+// GCC and Clang only emit SIMD intrinsics inside functions tagged with the target instruction set,
+// MSVC allows them anywhere
+#if defined(ASH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ASH_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ASH_TARGET(isa)
+#endif
+
+namespace ash
+{
+	/**
+	 * Instruction set extensions available on the CPU the engine is running on
+	 */
+	struct CpuFeatures
+	{
+		bool sse2{ false };
+		bool ssse3{ false };
+		bool sse41{ false };
+		bool avx{ false };
+		bool avx2{ false };
+		bool fma{ false };
+	};
+
+	/**
+	 * Returns the features of the current CPU, queried once on first call
+	 */
+	const CpuFeatures& getCpuFeatures();
+}
@@ -0,0 +1,515 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Utils/DynamicBvh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace ash
+{
+	namespace
+	{
+		Aabb combine(const Aabb& a, const Aabb& b)
+		{
+			return Aabb{ glm::min(a.min, b.min), glm::max(a.max, b.max) };
+		}
+
+		/**
+		 * Number of bins the centroids are sorted into when searching a split
+		 */
+		constexpr uint32_t BIN_COUNT{ 16 };
+	}
+
+	DynamicBvh::DynamicBvh(float margin, float rebuildRatio) :
+		m_margin{ margin }, m_rebuildRatio{ rebuildRatio }
+	{
+	}
+
+	int32_t DynamicBvh::insert(const Aabb& box, void* userData)
+	{
+		int32_t leaf{ allocateNode() };
+		m_nodes[leaf].box		= Aabb{ box.min - m_margin, box.max + m_margin };
+		m_nodes[leaf].tightBox	= box;
+		m_nodes[leaf].userData	= userData;
+
+		insertLeaf(leaf);
+		m_leafCount++;
+		m_changes++;
+		return leaf;
+	}
+
+	void DynamicBvh::remove(int32_t proxy)
+	{
+		removeLeaf(proxy);
+		freeNode(proxy);
+		m_leafCount--;
+		m_changes++;
+	}
+
+	bool DynamicBvh::move(int32_t proxy, const Aabb& box)
+	{
+		Node& leaf{ m_nodes[proxy] };
+		leaf.tightBox = box;
+		if (leaf.box.contains(box))
+		{
+			return false;
+		}
+
+		removeLeaf(proxy);
+		m_nodes[proxy].box = Aabb{ box.min - m_margin, box.max + m_margin };
+		insertLeaf(proxy);
+		m_changes++;
+		return true;
+	}
+
+	bool DynamicBvh::optimize()
+	{
+		// measuring the cost walks every node, only worth it once a fair share of the leaves changed
+		if (m_changes == 0 || m_changes < m_leafCount / 8)
+		{
+			return false;
+		}
+		m_changes = 0;
+
+		if (getCost() <= m_rebuildCost * m_rebuildRatio)
+		{
+			return false;
+		}
+		rebuild();
+		return true;
+	}
+
+	void DynamicBvh::rebuild()
+	{
+		// internal nodes are freed and built again, leaves keep their index so proxies stay valid
+		std::vector<int32_t> leaves{};
+		leaves.reserve(m_leafCount);
+		m_stack.clear();
+		if (m_root != NULL_NODE)
+		{
+			m_stack.push_back(m_root);
+		}
+		while (!m_stack.empty())
+		{
+			int32_t index{ m_stack.back() };
+			m_stack.pop_back();
+			if (m_nodes[index].isLeaf())
+			{
+				leaves.push_back(index);
+			}
+			else
+			{
+				m_stack.push_back(m_nodes[index].left);
+				m_stack.push_back(m_nodes[index].right);
+				freeNode(index);
+			}
+		}
+
+		m_root = leaves.empty() ? NULL_NODE : build(leaves, 0, leaves.size());
+		if (m_root != NULL_NODE)
+		{
+			m_nodes[m_root].parent = NULL_NODE;
+		}
+		m_rebuildCost	= getCost();
+		m_changes		= 0;
+	}
+
+	float DynamicBvh::getCost() const
+	{
+		if (m_root == NULL_NODE || m_nodes[m_root].isLeaf())
+		{
+			return 0.0f;
+		}
+
+		float area{ 0.0f };
+		m_stack.assign(1, m_root);
+		while (!m_stack.empty())
+		{
+			const Node& node{ m_nodes[m_stack.back()] };
+			m_stack.pop_back();
+			if (!node.isLeaf())
+			{
+				area += node.box.area();
+				m_stack.push_back(node.left);
+				m_stack.push_back(node.right);
+			}
+		}
+
+		float rootArea{ m_nodes[m_root].box.area() };
+		return rootArea > 0.0f ? area / rootArea : 0.0f;
+	}
+
+	void DynamicBvh::queryFrustum(const FrustumPlanes& planes, std::vector<void*>& results) const
+	{
+		if (m_root == NULL_NODE)
+		{
+			return;
+		}
+
+		m_stack.assign(1, m_root);
+		while (!m_stack.empty())
+		{
+			const int32_t	index	{ m_stack.back() };
+			const Node&		node	{ m_nodes[index] };
+			const Aabb&		box		{ node.isLeaf() ? node.tightBox : node.box };
+			m_stack.pop_back();
+
+			const glm::vec3 center{ (box.min + box.max) * 0.5f };
+			const glm::vec3 extent{ (box.max - box.min) * 0.5f };
+
+			// the box is outside when even its corner furthest along a plane's normal is behind it
+			bool outside{ false };
+			bool inside	{ true };
+			for (const glm::vec4& plane : planes)
+			{
+				float distance	{ plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w };
+				float radius	{ std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z };
+				if (distance + radius < 0.0f)
+				{
+					outside = true;
+					break;
+				}
+				inside = inside && distance - radius >= 0.0f;
+			}
+
+			if (outside)
+			{
+				continue;
+			}
+			if (node.isLeaf())
+			{
+				results.push_back(node.userData);
+			}
+			else if (inside)
+			{
+				collectLeaves(index, results);
+			}
+			else
+			{
+				m_stack.push_back(node.left);
+				m_stack.push_back(node.right);
+			}
+		}
+	}
+
+	void DynamicBvh::querySphere(const glm::vec4& sphere, std::vector<void*>& results) const
+	{
+		if (m_root == NULL_NODE)
+		{
+			return;
+		}
+
+		const glm::vec3	center			{ sphere };
+		const float		radiusSquared	{ sphere.w * sphere.w };
+
+		m_stack.assign(1, m_root);
+		while (!m_stack.empty())
+		{
+			const Node&	node	{ m_nodes[m_stack.back()] };
+			const Aabb&	box		{ node.isLeaf() ? node.tightBox : node.box };
+			m_stack.pop_back();
+
+			glm::vec3 offset{ glm::max(box.min - center, glm::max(center - box.max, glm::vec3(0.0f))) };
+			if (glm::dot(offset, offset) > radiusSquared)
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				results.push_back(node.userData);
+			}
+			else
+			{
+				m_stack.push_back(node.left);
+				m_stack.push_back(node.right);
+			}
+		}
+	}
+
+	void DynamicBvh::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<RayHit>& results) const
+	{
+		if (m_root == NULL_NODE)
+		{
+			return;
+		}
+
+		const size_t	firstHit	{ results.size() };
+		const glm::vec3	inverse		{ 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+
+		m_stack.assign(1, m_root);
+		while (!m_stack.empty())
+		{
+			const Node&	node	{ m_nodes[m_stack.back()] };
+			const Aabb&	box		{ node.isLeaf() ? node.tightBox : node.box };
+			m_stack.pop_back();
+
+			// slab test, a zero direction component gives infinities that keep or reject the whole axis
+			glm::vec3	toMin		{ (box.min - origin) * inverse };
+			glm::vec3	toMax		{ (box.max - origin) * inverse };
+			glm::vec3	entries		{ glm::min(toMin, toMax) };
+			glm::vec3	exits		{ glm::max(toMin, toMax) };
+			float		entry		{ std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f)) };
+			float		exit		{ std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance)) };
+			if (!(entry <= exit))
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				results.push_back(RayHit{ node.userData, entry });
+			}
+			else
+			{
+				m_stack.push_back(node.left);
+				m_stack.push_back(node.right);
+			}
+		}
+
+		std::sort(results.begin() + firstHit, results.end(),
+			[](const RayHit& a, const RayHit& b) { return a.distance < b.distance; });
+	}
+
+	int32_t DynamicBvh::allocateNode()
+	{
+		if (m_freeList == NULL_NODE)
+		{
+			m_nodes.emplace_back();
+			return static_cast<int32_t>(m_nodes.size() - 1);
+		}
+
+		int32_t node{ m_freeList };
+		m_freeList		= m_nodes[node].parent;
+		m_nodes[node]	= Node{};
+		return node;
+	}
+
+	void DynamicBvh::freeNode(int32_t node)
+	{
+		m_nodes[node]			= Node{};
+		m_nodes[node].parent	= m_freeList;
+		m_freeList				= node;
+	}
+
+	void DynamicBvh::insertLeaf(int32_t leaf)
+	{
+		if (m_root == NULL_NODE)
+		{
+			m_root					= leaf;
+			m_nodes[leaf].parent	= NULL_NODE;
+			return;
+		}
+
+		// descend towards the sibling whose pairing adds the least area, counting the growth of
+		// every ancestor on the way, and stop once going deeper can't be cheaper
+		const Aabb& leafBox{ m_nodes[leaf].box };
+		int32_t sibling{ m_root };
+		while (!m_nodes[sibling].isLeaf())
+		{
+			const Node& node{ m_nodes[sibling] };
+			float area			{ node.box.area() };
+			float combinedArea	{ combine(node.box, leafBox).area() };
+
+			float cost			{ 2.0f * combinedArea };
+			float inheritance	{ 2.0f * (combinedArea - area) };
+
+			auto childCost = [&](int32_t child)
+			{
+				const Node& childNode{ m_nodes[child] };
+				float grown{ combine(leafBox, childNode.box).area() };
+				return (childNode.isLeaf() ? grown : grown - childNode.box.area()) + inheritance;
+			};
+			float leftCost	{ childCost(node.left) };
+			float rightCost	{ childCost(node.right) };
+
+			if (cost < leftCost && cost < rightCost)
+			{
+				break;
+			}
+			sibling = leftCost < rightCost ? node.left : node.right;
+		}
+
+		// a new parent takes the sibling's place with the sibling and the leaf as children
+		int32_t oldParent	{ m_nodes[sibling].parent };
+		int32_t newParent	{ allocateNode() };
+		m_nodes[newParent].parent	= oldParent;
+		m_nodes[newParent].left		= sibling;
+		m_nodes[newParent].right	= leaf;
+		m_nodes[sibling].parent		= newParent;
+		m_nodes[leaf].parent		= newParent;
+
+		if (oldParent == NULL_NODE)
+		{
+			m_root = newParent;
+		}
+		else if (m_nodes[oldParent].left == sibling)
+		{
+			m_nodes[oldParent].left = newParent;
+		}
+		else
+		{
+			m_nodes[oldParent].right = newParent;
+		}
+
+		refit(newParent);
+	}
+
+	void DynamicBvh::removeLeaf(int32_t leaf)
+	{
+		if (leaf == m_root)
+		{
+			m_root = NULL_NODE;
+			return;
+		}
+
+		// the sibling takes the parent's place
+		int32_t parent		{ m_nodes[leaf].parent };
+		int32_t grandParent	{ m_nodes[parent].parent };
+		int32_t sibling		{ m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left };
+
+		m_nodes[sibling].parent = grandParent;
+		if (grandParent == NULL_NODE)
+		{
+			m_root = sibling;
+		}
+		else
+		{
+			if (m_nodes[grandParent].left == parent)
+			{
+				m_nodes[grandParent].left = sibling;
+			}
+			else
+			{
+				m_nodes[grandParent].right = sibling;
+			}
+			refit(grandParent);
+		}
+
+		freeNode(parent);
+		m_nodes[leaf].parent = NULL_NODE;
+	}
+
+	void DynamicBvh::refit(int32_t node)
+	{
+		for (; node != NULL_NODE; node = m_nodes[node].parent)
+		{
+			m_nodes[node].box = combine(m_nodes[m_nodes[node].left].box, m_nodes[m_nodes[node].right].box);
+		}
+	}
+
+	int32_t DynamicBvh::build(std::vector<int32_t>& leaves, size_t first, size_t last)
+	{
+		if (last - first == 1)
+		{
+			return leaves[first];
+		}
+
+		Aabb bounds{ m_nodes[leaves[first]].box };
+		Aabb centroids{ bounds.min + bounds.max, bounds.min + bounds.max };
+		for (size_t i = first; i < last; i++)
+		{
+			const Aabb& box{ m_nodes[leaves[i]].box };
+			bounds		= combine(bounds, box);
+			centroids	= combine(centroids, Aabb{ box.min + box.max, box.min + box.max });
+		}
+
+		// split along the axis the centroids spread the most, centroids are doubled which doesn't change the bins
+		glm::vec3	extent	{ centroids.max - centroids.min };
+		int32_t		axis	{ extent.x > extent.y && extent.x > extent.z ? 0 : (extent.y > extent.z ? 1 : 2) };
+		size_t		middle	{ first + (last - first) / 2 };
+
+		if (extent[axis] > 0.0f)
+		{
+			auto binOf = [&](int32_t leaf)
+			{
+				const Node& node{ m_nodes[leaf] };
+				float centroid{ node.box.min[axis] + node.box.max[axis] };
+				float offset{ (centroid - centroids.min[axis]) / extent[axis] };
+				return std::min(static_cast<uint32_t>(offset * BIN_COUNT), BIN_COUNT - 1);
+			};
+
+			std::array<uint32_t, BIN_COUNT>	counts	{};
+			std::array<Aabb, BIN_COUNT>		boxes	{};
+			for (size_t i = first; i < last; i++)
+			{
+				uint32_t bin{ binOf(leaves[i]) };
+				boxes[bin] = counts[bin] ? combine(boxes[bin], m_nodes[leaves[i]].box) : m_nodes[leaves[i]].box;
+				counts[bin]++;
+			}
+
+			// sweep from the right for the cost of every split's right side, then from the left
+			std::array<float, BIN_COUNT> rightCosts{};
+			Aabb		rightBox	{};
+			uint32_t	rightCount	{ 0 };
+			for (uint32_t bin = BIN_COUNT - 1; bin > 0; bin--)
+			{
+				if (counts[bin])
+				{
+					rightBox	= rightCount ? combine(rightBox, boxes[bin]) : boxes[bin];
+					rightCount	+= counts[bin];
+				}
+				rightCosts[bin] = rightCount ? rightBox.area() * rightCount : 0.0f;
+			}
+
+			float		bestCost	{ std::numeric_limits<float>::max() };
+			uint32_t	bestSplit	{ 0 };
+			Aabb		leftBox		{};
+			uint32_t	leftCount	{ 0 };
+			for (uint32_t split = 1; split < BIN_COUNT; split++)
+			{
+				if (counts[split - 1])
+				{
+					leftBox		= leftCount ? combine(leftBox, boxes[split - 1]) : boxes[split - 1];
+					leftCount	+= counts[split - 1];
+				}
+				float cost{ leftBox.area() * leftCount + rightCosts[split] };
+				if (leftCount > 0 && leftCount < last - first && cost < bestCost)
+				{
+					bestCost	= cost;
+					bestSplit	= split;
+				}
+			}
+
+			if (bestSplit > 0)
+			{
+				auto split{ std::partition(leaves.begin() + first, leaves.begin() + last,
+					[&](int32_t leaf) { return binOf(leaf) < bestSplit; }) };
+				middle = static_cast<size_t>(split - leaves.begin());
+			}
+		}
+
+		int32_t node{ allocateNode() };
+		int32_t left{ build(leaves, first, middle) };
+		int32_t right{ build(leaves, middle, last) };
+		m_nodes[node].box		= bounds;
+		m_nodes[node].left		= left;
+		m_nodes[node].right		= right;
+		m_nodes[left].parent	= node;
+		m_nodes[right].parent	= node;
+		return node;
+	}
+
+	void DynamicBvh::collectLeaves(int32_t node, std::vector<void*>& results) const
+	{
+		// the query's stack is still in use, the subtree gets its own
+		m_collectStack.assign(1, node);
+		while (!m_collectStack.empty())
+		{
+			const Node& current{ m_nodes[m_collectStack.back()] };
+			m_collectStack.pop_back();
+			if (current.isLeaf())
+			{
+				results.push_back(current.userData);
+			}
+			else
+			{
+				m_collectStack.push_back(current.left);
+				m_collectStack.push_back(current.right);
+			}
+		}
+	}
+}
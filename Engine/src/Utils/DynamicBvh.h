@@ -0,0 +1,216 @@
+/**
+ * Dynamic bounding volume hierarchy of axis aligned boxes
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include "FrustumCulling.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Axis aligned bounding box
+	 */
+	struct Aabb
+	{
+		glm::vec3 min{ 0.0f };
+		glm::vec3 max{ 0.0f };
+
+		/**
+		 * Box enclosing sphere, center xyz and radius w
+		 */
+		static Aabb fromSphere(const glm::vec4& sphere)
+		{
+			glm::vec3 center{ sphere };
+			return Aabb{ center - sphere.w, center + sphere.w };
+		}
+
+		bool contains(const Aabb& other) const
+		{
+			return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+				max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+		}
+
+		/**
+		 * Half the surface area, the SAH only compares areas so the factor is dropped
+		 */
+		float area() const
+		{
+			glm::vec3 extent{ max - min };
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	/**
+	 * A box hit by DynamicBvh::queryRay
+	 */
+	struct RayHit
+	{
+		void*	userData	{};
+		float	distance	{ 0.0f };		// along the ray to where it enters the box, 0 if it starts inside
+	};
+
+	/**
+	 * Dynamic bounding volume hierarchy of axis aligned boxes.
+	 * Leaves are inserted next to the sibling that grows the surface area heuristic cost the least
+	 * and keep a box enlarged by a margin, so small moves only update the leaf. Incremental
+	 * changes slowly degrade the tree, optimize compares its SAH cost against the cost right after
+	 * the last rebuild and rebuilds it top down with binned SAH splits when it got too much worse.
+	 * Proxies returned by insert stay valid across rebuilds until they are removed.
+	 * Queries test leaves against the boxes they were given rather than the enlarged ones
+	 */
+	class DynamicBvh
+	{
+	public:
+		static constexpr int32_t NULL_NODE{ -1 };
+
+		/**
+		 * @param margin how far leaf boxes are enlarged on each side
+		 * @param rebuildRatio how much the SAH cost may grow over the last rebuild before optimize rebuilds
+		 */
+		explicit DynamicBvh(float margin = 0.1f, float rebuildRatio = 1.5f);
+
+		/**
+		 * Adds a leaf for box
+		 * @return proxy identifying the leaf
+		 */
+		int32_t insert(const Aabb& box, void* userData);
+
+		/**
+		 * Removes the leaf of proxy, the proxy may be handed out again
+		 */
+		void remove(int32_t proxy);
+
+		/**
+		 * Updates the box of proxy, the leaf is only moved in the tree when box left its enlarged box
+		 * @return whether the tree changed
+		 */
+		bool move(int32_t proxy, const Aabb& box);
+
+		/**
+		 * Rebuilds the tree when enough changed since the last check and its SAH cost degraded
+		 * @return whether the tree was rebuilt
+		 */
+		bool optimize();
+
+		/**
+		 * Rebuilds the whole tree top down, splitting the leaves by binned SAH
+		 */
+		void rebuild();
+
+		/**
+		 * Sum of the internal nodes' surface areas relative to the root's, lower is better
+		 */
+		float getCost() const;
+
+		/**
+		 * Number of leaves
+		 */
+		uint32_t size() const { return m_leafCount; }
+
+		void* getUserData(int32_t proxy) const { return m_nodes[proxy].userData; }
+
+		/**
+		 * Appends the user data of every leaf intersecting the frustum
+		 */
+		void queryFrustum(const FrustumPlanes& planes, std::vector<void*>& results) const;
+
+		/**
+		 * Appends the user data of every leaf intersecting sphere, center xyz and radius w
+		 */
+		void querySphere(const glm::vec4& sphere, std::vector<void*>& results) const;
+
+		/**
+		 * Appends every leaf the ray hits within maxDistance, nearest first
+		 * @param direction need not be normalized, distances are in multiples of it
+		 */
+		void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<RayHit>& results) const;
+
+	private:
+
+		/**
+		 * Leaf or internal node, leaves have no children
+		 */
+		struct Node
+		{
+			Aabb	box			{};					// enlarged for leaves
+			Aabb	tightBox	{};					// the box the leaf was given, unused by internal nodes
+			void*	userData	{};
+			int32_t	parent		{ NULL_NODE };		// next free node while on the free list
+			int32_t	left		{ NULL_NODE };
+			int32_t	right		{ NULL_NODE };
+
+			bool isLeaf() const { return left == NULL_NODE; }
+		};
+
+		/**
+		 * Every node, free ones are chained through their parent
+		 */
+		std::vector<Node> m_nodes{};
+
+		int32_t m_root{ NULL_NODE };
+
+		int32_t m_freeList{ NULL_NODE };
+
+		uint32_t m_leafCount{ 0 };
+
+		float m_margin{ 0.1f };
+
+		float m_rebuildRatio{ 1.5f };
+
+		/**
+		 * SAH cost right after the last rebuild
+		 */
+		float m_rebuildCost{ 0.0f };
+
+		/**
+		 * Inserts and removes since optimize last checked the cost
+		 */
+		uint32_t m_changes{ 0 };
+
+		/**
+		 * Scratch space of the queries and the rebuild, queries are not safe to run concurrently
+		 */
+		mutable std::vector<int32_t> m_stack{};
+
+		mutable std::vector<int32_t> m_collectStack{};
+
+		int32_t allocateNode();
+
+		void freeNode(int32_t node);
+
+		/**
+		 * Links an existing leaf into the tree
+		 */
+		void insertLeaf(int32_t leaf);
+
+		/**
+		 * Unlinks a leaf from the tree without freeing it
+		 */
+		void removeLeaf(int32_t leaf);
+
+		/**
+		 * Recomputes the boxes from node up to the root
+		 */
+		void refit(int32_t node);
+
+		/**
+		 * Builds the subtree over leaves [first, last) and returns its root
+		 */
+		int32_t build(std::vector<int32_t>& leaves, size_t first, size_t last);
+
+		/**
+		 * Appends the user data of every leaf below node, used when a node is entirely inside a query
+		 */
+		void collectLeaves(int32_t node, std::vector<void*>& results) const;
+	};
+}
@@ -0,0 +1,294 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Utils/TlsfAllocator.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ash
+{
+	namespace
+	{
+		/**
+		 * Index of the highest set bit, value must not be 0
+		 */
+		uint32_t highestBit(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+		}
+
+		/**
+		 * Index of the lowest set bit, value must not be 0
+		 */
+		uint32_t lowestBit(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward64(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+		}
+
+		uint64_t alignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	TlsfAllocator::TlsfAllocator(uint64_t size) :
+		m_size{ size }
+	{
+		m_freeHeads.fill(INVALID_NODE);
+
+		uint32_t node{ createNode() };
+		m_nodes[node].offset	= 0;
+		m_nodes[node].size		= size;
+		insertFreeNode(node);
+	}
+
+	TlsfAllocator::Allocation TlsfAllocator::allocate(uint64_t size, uint64_t alignment)
+	{
+		size		= size == 0 ? 1 : size;
+		alignment	= alignment == 0 ? 1 : alignment;
+
+		// the head of the good fit list is usually aligned already, only pay for the padding when it isn't
+		uint32_t node{ findFreeNode(size) };
+		if (node != INVALID_NODE)
+		{
+			const Node& candidate{ m_nodes[node] };
+			if (alignUp(candidate.offset, alignment) + size > candidate.offset + candidate.size)
+			{
+				node = INVALID_NODE;
+			}
+		}
+		if (node == INVALID_NODE && alignment > 1)
+		{
+			node = findFreeNode(size + alignment - 1);
+		}
+		if (node == INVALID_NODE)
+		{
+			return {};
+		}
+
+		removeFreeNode(node);
+
+		// padding in front of the aligned offset becomes its own free range,
+		// the previous physical node is in use since free neighbours are always merged
+		uint64_t padding{ alignUp(m_nodes[node].offset, alignment) - m_nodes[node].offset };
+		if (padding > 0)
+		{
+			uint32_t front{ createNode() };
+			Node& current{ m_nodes[node] };
+			Node& frontNode{ m_nodes[front] };
+
+			frontNode.offset		= current.offset;
+			frontNode.size			= padding;
+			frontNode.prevPhysical	= current.prevPhysical;
+			frontNode.nextPhysical	= node;
+			if (current.prevPhysical != INVALID_NODE)
+			{
+				m_nodes[current.prevPhysical].nextPhysical = front;
+			}
+			current.prevPhysical	= front;
+			current.offset			+= padding;
+			current.size			-= padding;
+
+			insertFreeNode(front);
+		}
+
+		splitTail(node, size);
+
+		m_nodes[node].free	= false;
+		m_usedSize			+= m_nodes[node].size;
+		m_allocationCount++;
+
+		return Allocation{ m_nodes[node].offset, node };
+	}
+
+	void TlsfAllocator::free(uint32_t node)
+	{
+		m_usedSize -= m_nodes[node].size;
+		m_allocationCount--;
+
+		// merge with the previous range
+		uint32_t prev{ m_nodes[node].prevPhysical };
+		if (prev != INVALID_NODE && m_nodes[prev].free)
+		{
+			removeFreeNode(prev);
+			m_nodes[prev].size			+= m_nodes[node].size;
+			m_nodes[prev].nextPhysical	= m_nodes[node].nextPhysical;
+			if (m_nodes[node].nextPhysical != INVALID_NODE)
+			{
+				m_nodes[m_nodes[node].nextPhysical].prevPhysical = prev;
+			}
+			m_unusedNodes.push_back(node);
+			node = prev;
+		}
+
+		// merge with the next range
+		uint32_t next{ m_nodes[node].nextPhysical };
+		if (next != INVALID_NODE && m_nodes[next].free)
+		{
+			removeFreeNode(next);
+			m_nodes[node].size			+= m_nodes[next].size;
+			m_nodes[node].nextPhysical	= m_nodes[next].nextPhysical;
+			if (m_nodes[next].nextPhysical != INVALID_NODE)
+			{
+				m_nodes[m_nodes[next].nextPhysical].prevPhysical = node;
+			}
+			m_unusedNodes.push_back(next);
+		}
+
+		insertFreeNode(node);
+	}
+
+	uint32_t TlsfAllocator::createNode()
+	{
+		if (!m_unusedNodes.empty())
+		{
+			uint32_t node{ m_unusedNodes.back() };
+			m_unusedNodes.pop_back();
+			m_nodes[node] = Node{};
+			return node;
+		}
+
+		m_nodes.emplace_back();
+		return static_cast<uint32_t>(m_nodes.size() - 1);
+	}
+
+	void TlsfAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+	{
+		if (size < SL_COUNT)
+		{
+			fl = 0;
+			sl = static_cast<uint32_t>(size);
+			return;
+		}
+
+		uint32_t log2{ highestBit(size) };
+		fl = log2 - SL_BITS + 1;
+		sl = static_cast<uint32_t>(size >> (log2 - SL_BITS)) ^ SL_COUNT;
+	}
+
+	uint32_t TlsfAllocator::findFreeNode(uint64_t size) const
+	{
+		// round up to the next list boundary so every range in the found list is big enough
+		if (size >= SL_COUNT)
+		{
+			uint64_t round{ (uint64_t{ 1 } << (highestBit(size) - SL_BITS)) - 1 };
+			if (size > UINT64_MAX - round)
+			{
+				return INVALID_NODE;
+			}
+			size += round;
+		}
+
+		uint32_t fl;
+		uint32_t sl;
+		mapping(size, fl, sl);
+
+		uint32_t slMap{ m_slBitmaps[fl] & (~0u << sl) };
+		if (slMap == 0)
+		{
+			uint64_t flMap{ fl + 1 < 64 ? m_flBitmap & (~uint64_t{ 0 } << (fl + 1)) : 0 };
+			if (flMap == 0)
+			{
+				return INVALID_NODE;
+			}
+			fl		= lowestBit(flMap);
+			slMap	= m_slBitmaps[fl];
+		}
+		sl = lowestBit(slMap);
+
+		return m_freeHeads[fl * SL_COUNT + sl];
+	}
+
+	void TlsfAllocator::insertFreeNode(uint32_t node)
+	{
+		uint32_t fl;
+		uint32_t sl;
+		mapping(m_nodes[node].size, fl, sl);
+
+		uint32_t& head{ m_freeHeads[fl * SL_COUNT + sl] };
+		m_nodes[node].free		= true;
+		m_nodes[node].prevFree	= INVALID_NODE;
+		m_nodes[node].nextFree	= head;
+		if (head != INVALID_NODE)
+		{
+			m_nodes[head].prevFree = node;
+		}
+		head = node;
+
+		m_flBitmap		|= uint64_t{ 1 } << fl;
+		m_slBitmaps[fl]	|= 1u << sl;
+	}
+
+	void TlsfAllocator::removeFreeNode(uint32_t node)
+	{
+		uint32_t fl;
+		uint32_t sl;
+		mapping(m_nodes[node].size, fl, sl);
+
+		Node& current{ m_nodes[node] };
+		if (current.prevFree != INVALID_NODE)
+		{
+			m_nodes[current.prevFree].nextFree = current.nextFree;
+		}
+		else
+		{
+			m_freeHeads[fl * SL_COUNT + sl] = current.nextFree;
+		}
+		if (current.nextFree != INVALID_NODE)
+		{
+			m_nodes[current.nextFree].prevFree = current.prevFree;
+		}
+		current.free		= false;
+		current.prevFree	= INVALID_NODE;
+		current.nextFree	= INVALID_NODE;
+
+		if (m_freeHeads[fl * SL_COUNT + sl] == INVALID_NODE)
+		{
+			m_slBitmaps[fl] &= ~(1u << sl);
+			if (m_slBitmaps[fl] == 0)
+			{
+				m_flBitmap &= ~(uint64_t{ 1 } << fl);
+			}
+		}
+	}
+
+	void TlsfAllocator::splitTail(uint32_t node, uint64_t size)
+	{
+		if (m_nodes[node].size <= size)
+		{
+			return;
+		}
+
+		// the next physical node is in use, node was free until now
+		uint32_t tail{ createNode() };
+		Node& current{ m_nodes[node] };
+		Node& tailNode{ m_nodes[tail] };
+
+		tailNode.offset			= current.offset + size;
+		tailNode.size			= current.size - size;
+		tailNode.prevPhysical	= node;
+		tailNode.nextPhysical	= current.nextPhysical;
+		if (current.nextPhysical != INVALID_NODE)
+		{
+			m_nodes[current.nextPhysical].prevPhysical = tail;
+		}
+		current.nextPhysical	= tail;
+		current.size			= size;
+
+		insertFreeNode(tail);
+	}
+}
@@ -0,0 +1,156 @@
+/**
+ * Two-level segregated fit allocator handing out offsets into a fixed size range
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Two-level segregated fit allocator handing out offsets into a fixed size range.
+	 * Does not own any memory, used to sub-allocate GPU memory blocks.
+	 * Allocation and free are O(1), neighbouring free ranges are merged on free
+	 */
+	class TlsfAllocator
+	{
+	public:
+		/**
+		 * Returned in Allocation::node when the range has no room for a request
+		 */
+		static constexpr uint32_t INVALID_NODE{ UINT32_MAX };
+
+		/**
+		 * A sub range handed out by allocate, node is needed to free it
+		 */
+		struct Allocation
+		{
+			uint64_t offset{ 0 };
+			uint32_t node{ INVALID_NODE };
+		};
+
+		explicit TlsfAllocator(uint64_t size);
+
+		/**
+		 * Finds a free range of at least size bytes starting at a multiple of alignment
+		 * @return allocation with node set to INVALID_NODE when nothing fits
+		 */
+		Allocation allocate(uint64_t size, uint64_t alignment);
+
+		/**
+		 * Returns the range of a previous allocation
+		 */
+		void free(uint32_t node);
+
+		/**
+		 * Size of the whole range
+		 */
+		uint64_t getSize() const { return m_size; }
+
+		/**
+		 * Bytes currently handed out, including alignment padding absorbed into allocations
+		 */
+		uint64_t getUsedSize() const { return m_usedSize; }
+
+		/**
+		 * Number of live allocations
+		 */
+		uint32_t getAllocationCount() const { return m_allocationCount; }
+
+	private:
+
+		/**
+		 * log2 of the number of second level lists per first level class
+		 */
+		static constexpr uint32_t SL_BITS{ 4 };
+
+		static constexpr uint32_t SL_COUNT{ 1u << SL_BITS };
+
+		/**
+		 * First level 0 holds sizes below SL_COUNT, the rest one power of two each
+		 */
+		static constexpr uint32_t FL_COUNT{ 64 - SL_BITS + 1 };
+
+		/**
+		 * A free or used range, linked to its physical neighbours and, while free, to its size class list
+		 */
+		struct Node
+		{
+			uint64_t	offset			{ 0 };
+			uint64_t	size			{ 0 };
+			uint32_t	prevPhysical	{ INVALID_NODE };
+			uint32_t	nextPhysical	{ INVALID_NODE };
+			uint32_t	prevFree		{ INVALID_NODE };
+			uint32_t	nextFree		{ INVALID_NODE };
+			bool		free			{ false };
+		};
+
+		/**
+		 * Size of the whole range
+		 */
+		uint64_t m_size{ 0 };
+
+		/**
+		 * Bytes currently handed out
+		 */
+		uint64_t m_usedSize{ 0 };
+
+		/**
+		 * Number of live allocations
+		 */
+		uint32_t m_allocationCount{ 0 };
+
+		/**
+		 * Node storage, indices stay valid while nodes are recycled through m_unusedNodes
+		 */
+		std::vector<Node> m_nodes{};
+
+		/**
+		 * Indices of m_nodes entries not describing any range
+		 */
+		std::vector<uint32_t> m_unusedNodes{};
+
+		/**
+		 * Bit per first level class with at least one non empty list
+		 */
+		uint64_t m_flBitmap{ 0 };
+
+		/**
+		 * Bit per non empty second level list of each first level class
+		 */
+		std::array<uint32_t, FL_COUNT> m_slBitmaps{};
+
+		/**
+		 * Head node of every size class list
+		 */
+		std::array<uint32_t, FL_COUNT * SL_COUNT> m_freeHeads{};
+
+		/**
+		 * Gets an unused node, growing the storage if needed
+		 */
+		uint32_t createNode();
+
+		/**
+		 * Finds the size class list a free range of the given size belongs to
+		 */
+		static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+
+		/**
+		 * Returns a free node of at least size bytes, INVALID_NODE if there is none
+		 */
+		uint32_t findFreeNode(uint64_t size) const;
+
+		void insertFreeNode(uint32_t node);
+
+		void removeFreeNode(uint32_t node);
+
+		/**
+		 * Splits the tail past size off node into a new free node
+		 */
+		void splitTail(uint32_t node, uint64_t size);
+	};
+}
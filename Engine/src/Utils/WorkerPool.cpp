@@ -0,0 +1,116 @@
+/**
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Utils/WorkerPool.h"
+
+#include <algorithm>
+
+namespace ash
+{
+	WorkerPool::WorkerPool(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		for (uint32_t i = 1; i < threadCount; i++)
+		{
+			m_threads.emplace_back(&WorkerPool::workerLoop, this);
+		}
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_stop = true;
+		}
+		m_wake.notify_all();
+
+		for (auto& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	void WorkerPool::run(uint32_t taskCount, const std::function<void(uint32_t taskIndex)>& task)
+	{
+		if (m_threads.empty() || taskCount <= 1)
+		{
+			for (uint32_t i = 0; i < taskCount; i++)
+			{
+				task(i);
+			}
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_task			= &task;
+			m_taskCount		= taskCount;
+			m_nextTask		= 0;
+			m_activeWorkers	= static_cast<uint32_t>(m_threads.size());
+			m_batch++;
+		}
+		m_wake.notify_all();
+
+		runTasks();
+
+		// the task is owned by the caller, it must outlive every worker's use of it
+		std::unique_lock<std::mutex> lock{ m_mutex };
+		m_done.wait(lock, [this]() { return m_activeWorkers == 0; });
+		m_task = nullptr;
+
+		if (m_error)
+		{
+			std::exception_ptr error{ m_error };
+			m_error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	void WorkerPool::workerLoop()
+	{
+		uint64_t lastBatch{ 0 };
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock{ m_mutex };
+				m_wake.wait(lock, [&]() { return m_stop || m_batch != lastBatch; });
+				if (m_stop)
+				{
+					return;
+				}
+				lastBatch = m_batch;
+			}
+
+			runTasks();
+
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			if (--m_activeWorkers == 0)
+			{
+				m_done.notify_one();
+			}
+		}
+	}
+
+	void WorkerPool::runTasks()
+	{
+		for (uint32_t i = m_nextTask++; i < m_taskCount; i = m_nextTask++)
+		{
+			try
+			{
+				(*m_task)(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock{ m_mutex };
+				if (!m_error)
+				{
+					m_error = std::current_exception();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,111 @@
+/**
+ * Fixed set of threads that run a batch of indexed tasks in parallel
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ash
+{
+	/**
+	 * Fixed set of threads that run a batch of indexed tasks in parallel.
+	 * The calling thread takes part in the batch, so a pool of one thread has no workers
+	 * and runs everything inline. Only one batch runs at a time
+	 */
+	class WorkerPool
+	{
+	public:
+		/**
+		 * @param threadCount threads taking part in a batch including the caller, 0 uses one per core
+		 */
+		explicit WorkerPool(uint32_t threadCount);
+		~WorkerPool();
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		/**
+		 * Number of threads taking part in a batch, including the caller
+		 */
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(m_threads.size()) + 1; }
+
+		/**
+		 * Calls task once for every index in [0, taskCount) spread over the threads, returns when all are done.
+		 * The first exception thrown by a task is rethrown once the batch finished
+		 */
+		void run(uint32_t taskCount, const std::function<void(uint32_t taskIndex)>& task);
+
+	private:
+
+		/**
+		 * Worker threads, the caller of run is not included
+		 */
+		std::vector<std::thread> m_threads{};
+
+		/**
+		 * Guards the batch state below
+		 */
+		std::mutex m_mutex{};
+
+		/**
+		 * Wakes the workers when a batch starts or the pool is destroyed
+		 */
+		std::condition_variable m_wake{};
+
+		/**
+		 * Wakes the caller when the last worker leaves the batch
+		 */
+		std::condition_variable m_done{};
+
+		/**
+		 * Task and size of the current batch
+		 */
+		const std::function<void(uint32_t)>* m_task{};
+
+		uint32_t m_taskCount{ 0 };
+
+		/**
+		 * Next task index to be taken
+		 */
+		std::atomic<uint32_t> m_nextTask{ 0 };
+
+		/**
+		 * Workers still inside the current batch
+		 */
+		uint32_t m_activeWorkers{ 0 };
+
+		/**
+		 * Incremented for every batch so workers can tell a new one from a spurious wake up
+		 */
+		uint64_t m_batch{ 0 };
+
+		/**
+		 * First exception thrown by a task of the current batch, rethrown by run
+		 */
+		std::exception_ptr m_error{};
+
+		/**
+		 * Set when the pool is destroyed
+		 */
+		bool m_stop{ false };
+
+		/**
+		 * Loop run by every worker thread
+		 */
+		void workerLoop();
+
+		/**
+		 * Takes and runs tasks of the current batch until none are left
+		 */
+		void runTasks();
+	};
+}
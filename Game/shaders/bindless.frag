@@ -0,0 +1,60 @@
+// BINDLESS FRAGEMENT SHADER
+// Copyright (C) 2021, Jesse Springborn
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// every texture registered with the BindlessSet, indexed through the material buffer
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// must match MaterialData.hpp
+struct Material
+{
+	vec4 baseColorFactor;
+	vec4 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float alphaCutoff;
+	int baseColorTexture;
+	int metallicRoughnessTexture;
+	int normalTexture;
+	int occlusionTexture;
+	int emissiveTexture;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer Materials
+{
+	Material materials[];
+};
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+layout(push_constant) uniform Push
+{
+	mat4 modelMatrix;
+	uint materialIndex;
+} push;
+
+void main()
+{
+	Material material = materials[push.materialIndex];
+
+	vec4 baseColor = material.baseColorFactor;
+	if (material.baseColorTexture >= 0)
+	{
+		baseColor *= texture(textures[nonuniformEXT(material.baseColorTexture)], fragTexCoord);
+	}
+
+	if (material.emissiveTexture >= 0)
+	{
+		baseColor.rgb += material.emissiveFactor.rgb * texture(textures[nonuniformEXT(material.emissiveTexture)], fragTexCoord).rgb;
+	}
+	else
+	{
+		baseColor.rgb += material.emissiveFactor.rgb;
+	}
+
+	outColor = baseColor;
+}
\ No newline at end of file
@@ -1,3 +1,14 @@
 C:\libs\vulkan\Bin\glslc.exe shader.vert -o vert.spv
 C:\libs\vulkan\Bin\glslc.exe shader.frag -o frag.spv
+C:\libs\vulkan\Bin\glslc.exe bindless.frag -o bindless_frag.spv
+C:\libs\vulkan\Bin\glslc.exe skinned.vert -o skinned_vert.spv
+C:\libs\vulkan\Bin\glslc.exe -DINSTANCED shader.vert -o instanced_vert.spv
+C:\libs\vulkan\Bin\glslc.exe -DINSTANCED skinned.vert -o skinned_instanced_vert.spv
+C:\libs\vulkan\Bin\glslc.exe cull.comp -o cull_comp.spv
+C:\libs\vulkan\Bin\glslc.exe hiz.comp -o hiz_comp.spv
+C:\libs\vulkan\Bin\glslc.exe -DOCCLUSION cull.comp -o cull_occlusion_comp.spv
+C:\libs\vulkan\Bin\glslc.exe -DDEPTH_ONLY shader.vert -o depth_vert.spv
+C:\libs\vulkan\Bin\glslc.exe -DDEPTH_ONLY -DINSTANCED shader.vert -o depth_instanced_vert.spv
+C:\libs\vulkan\Bin\glslc.exe -DDEPTH_ONLY skinned.vert -o skinned_depth_vert.spv
+C:\libs\vulkan\Bin\glslc.exe -DDEPTH_ONLY -DINSTANCED skinned.vert -o skinned_depth_instanced_vert.spv
 pause
\ No newline at end of file
@@ -9,7 +9,16 @@ layout(set = 0, binding = 0) uniform UniformBufferObject
 	mat4 proj;
 } ubo;
 
+#ifdef INSTANCED
+// transforms of instanced draws, gl_InstanceIndex includes the draw's first instance
+layout(std430, set = 0, binding = 1) readonly buffer JointPalette
+{
+	mat4 joints[];
+} palette;
+#endif
+
 layout(location = 0) in vec3 inPosition;
+#ifndef DEPTH_ONLY
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUV;
 layout(location = 3) in vec3 inColor;
@@ -18,6 +27,10 @@ layout(location = 5) in vec3 inWeights;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+#endif
+
+// the depth prepass and the shading pass must compute the same depth
+invariant gl_Position;
 
 layout(push_constant) uniform Push
 {
@@ -26,7 +39,14 @@ layout(push_constant) uniform Push
 
 void main()
 {
-	gl_Position = ubo.proj * ubo.view * push.modelMatrix * vec4(inPosition, 1.0); 
+#ifdef INSTANCED
+	mat4 modelMatrix = palette.joints[gl_InstanceIndex];
+#else
+	mat4 modelMatrix = push.modelMatrix;
+#endif
+	gl_Position = ubo.proj * ubo.view * modelMatrix * vec4(inPosition, 1.0); 
+#ifndef DEPTH_ONLY
 	fragColor = inColor;
 	fragTexCoord = inUV;
+#endif
 }
\ No newline at end of file
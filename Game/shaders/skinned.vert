@@ -0,0 +1,66 @@
+// SKINNED VERTEX SHADER
+// Copyright (C) 2021, Jesse Springborn
+#version 450
+
+layout(set = 0, binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+// joints of every skin for this frame, selected with a dynamic offset,
+// followed by the transforms of instanced draws
+layout(std430, set = 0, binding = 1) readonly buffer JointPalette
+{
+	mat4 joints[];
+} palette;
+
+layout(location = 0) in vec3 inPosition;
+#ifndef DEPTH_ONLY
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec3 inColor;
+#endif
+layout(location = 4) in vec4 inJoints;
+layout(location = 5) in vec4 inWeights;
+
+#ifndef DEPTH_ONLY
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+#endif
+
+// the depth prepass and the shading pass must compute the same depth
+invariant gl_Position;
+
+layout(push_constant) uniform Push
+{
+	mat4 modelMatrix;
+	uint materialIndex;
+	int jointOffset;
+} push;
+
+void main()
+{
+	mat4 skinMatrix = mat4(1.0);
+	if (push.jointOffset >= 0)
+	{
+		uint first = uint(push.jointOffset);
+		skinMatrix =
+			inWeights.x * palette.joints[first + uint(inJoints.x)] +
+			inWeights.y * palette.joints[first + uint(inJoints.y)] +
+			inWeights.z * palette.joints[first + uint(inJoints.z)] +
+			inWeights.w * palette.joints[first + uint(inJoints.w)];
+	}
+
+#ifdef INSTANCED
+	mat4 modelMatrix = palette.joints[gl_InstanceIndex];
+#else
+	mat4 modelMatrix = push.modelMatrix;
+#endif
+	gl_Position = ubo.proj * ubo.view * modelMatrix * skinMatrix * vec4(inPosition, 1.0);
+#ifndef DEPTH_ONLY
+	fragColor = inColor;
+	fragTexCoord = inUV;
+#endif
+}
@@ -0,0 +1,263 @@
+/**
+ * Headless tests of the engine parts that run without a GPU
+ *
+ * Copyright (C) 2021, Jesse Springborn
+ */
+#include "Graphics/OcclusionBuffer.h"
+#include "Utils/WorkerPool.h"
+
+#include <iostream>		// for printing failed checks
+#include <cstdlib>		// for EXIT_FAILURE & EXIT_SUCCESS
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	/**
+	 * Number of checks that failed so far
+	 */
+	int failures{ 0 };
+
+	void check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::cerr << "FAILED: " << name << std::endl;
+			failures++;
+		}
+	}
+
+	/**
+	 * Same sequence on every platform, unlike the standard distributions
+	 */
+	struct Random
+	{
+		uint32_t state{ 12345 };
+
+		float next(float minimum, float maximum)
+		{
+			state = state * 1664525u + 1013904223u;
+			return minimum + (maximum - minimum) * static_cast<float>(state >> 8) / static_cast<float>(1u << 24);
+		}
+	};
+
+	/**
+	 * Occluders scattered over the screen with an identity camera, clip space is world space
+	 */
+	void drawScene(ash::OcclusionBuffer& buffer, ash::WorkerPool* workerPool)
+	{
+		Random random{};
+		buffer.begin(glm::mat4(1.0f));
+
+		for (uint32_t i = 0; i < 64; i++)
+		{
+			ash::OccluderMesh mesh{};
+			for (uint32_t v = 0; v < 3; v++)
+			{
+				mesh.positions.push_back(glm::vec3(random.next(-1.2f, 1.2f), random.next(-1.2f, 1.2f), random.next(0.1f, 0.9f)));
+				mesh.indices.push_back(v);
+			}
+			buffer.addOccluder(mesh, glm::mat4(1.0f));
+		}
+		buffer.rasterize(workerPool);
+	}
+
+	std::vector<float> readDepth(const ash::OcclusionBuffer& buffer)
+	{
+		std::vector<float> depth{};
+		for (uint32_t y = 0; y < buffer.getHeight(); y++)
+		{
+			for (uint32_t x = 0; x < buffer.getWidth(); x++)
+			{
+				depth.push_back(buffer.getDepth(x, y));
+			}
+		}
+		return depth;
+	}
+
+	bool sameBits(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+	}
+
+	/**
+	 * The buffer is bit for bit the same however many threads draw the tiles
+	 */
+	void testDeterminism()
+	{
+		ash::OcclusionBuffer	buffer	{ 256, 128 };
+		ash::WorkerPool			pool3	{ 3 };
+		ash::WorkerPool			pool4	{ 4 };
+
+		drawScene(buffer, nullptr);
+		const std::vector<float> reference{ readDepth(buffer) };
+
+		drawScene(buffer, &pool3);
+		check(sameBits(reference, readDepth(buffer)), "three threads match one");
+
+		drawScene(buffer, &pool4);
+		check(sameBits(reference, readDepth(buffer)), "four threads match one");
+
+		drawScene(buffer, nullptr);
+		check(sameBits(reference, readDepth(buffer)), "drawing again matches");
+
+		check(std::any_of(reference.begin(), reference.end(), [](float depth) { return depth < 1.0f; }), "the scene covers pixels");
+	}
+
+	/**
+	 * Only pixels the triangle covers entirely are written, with a depth no nearer than the triangle's over the pixel
+	 */
+	void testConservativeCoverage()
+	{
+		ash::OcclusionBuffer buffer{ 64, 32 };
+		buffer.begin(glm::mat4(1.0f));
+
+		ash::OccluderMesh mesh{};
+		mesh.positions	= { glm::vec3(-0.83f, -0.71f, 0.2f), glm::vec3(0.77f, -0.52f, 0.6f), glm::vec3(-0.11f, 0.88f, 0.4f) };
+		mesh.indices	= { 0, 1, 2 };
+		buffer.addOccluder(mesh, glm::mat4(1.0f));
+		buffer.rasterize();
+
+		// the same triangle in pixels
+		glm::vec3 screen[3]{};
+		for (uint32_t v = 0; v < 3; v++)
+		{
+			screen[v] = glm::vec3((mesh.positions[v].x * 0.5f + 0.5f) * buffer.getWidth(),
+				(mesh.positions[v].y * 0.5f + 0.5f) * buffer.getHeight(), mesh.positions[v].z);
+		}
+		const float area{ (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y) };
+
+		bool insideOnly	{ true };
+		bool farEnough	{ true };
+		bool anyWritten	{ false };
+		for (uint32_t y = 0; y < buffer.getHeight(); y++)
+		{
+			for (uint32_t x = 0; x < buffer.getWidth(); x++)
+			{
+				const float depth{ buffer.getDepth(x, y) };
+				if (depth == 1.0f)
+				{
+					continue;
+				}
+				anyWritten = true;
+
+				for (uint32_t corner = 0; corner < 4; corner++)
+				{
+					const float px{ static_cast<float>(x + (corner & 1)) };
+					const float py{ static_cast<float>(y + (corner >> 1)) };
+
+					// barycentric weights of the corner, all of them non negative inside
+					float weights[3]{};
+					for (uint32_t v = 0; v < 3; v++)
+					{
+						const glm::vec3& a{ screen[(v + 1) % 3] };
+						const glm::vec3& b{ screen[(v + 2) % 3] };
+						weights[v] = ((b.x - a.x) * (py - a.y) - (px - a.x) * (b.y - a.y)) / area;
+					}
+					insideOnly = insideOnly && weights[0] >= -1e-5f && weights[1] >= -1e-5f && weights[2] >= -1e-5f;
+
+					const float planeDepth{ weights[0] * screen[0].z + weights[1] * screen[1].z + weights[2] * screen[2].z };
+					farEnough = farEnough && depth >= planeDepth - 1e-5f;
+				}
+			}
+		}
+
+		check(anyWritten, "the triangle covers pixels");
+		check(insideOnly, "written pixels are entirely inside the triangle");
+		check(farEnough, "written depth is no nearer than the triangle over the pixel");
+	}
+
+	/**
+	 * Objects are only reported hidden when they are behind the occluder over all their pixels
+	 */
+	void testOcclusionQueries()
+	{
+		ash::OcclusionBuffer buffer{ 128, 64 };
+		buffer.begin(glm::mat4(1.0f));
+
+		ash::OccluderMesh quad{};
+		quad.positions	= { glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(-0.5f, 0.5f, 0.5f) };
+		quad.indices	= { 0, 1, 2, 0, 2, 3 };
+		buffer.addOccluder(quad, glm::mat4(1.0f));
+		buffer.rasterize();
+
+		// pixels on the diagonal are in neither triangle entirely, so the hidden sphere is kept to one side
+		check(buffer.isOccluded(glm::vec4(0.25f, -0.25f, 0.8f, 0.1f)), "a sphere behind the quad is hidden");
+		check(!buffer.isOccluded(glm::vec4(0.0f, 0.0f, 0.3f, 0.1f)), "a sphere in front of the quad is visible");
+		check(!buffer.isOccluded(glm::vec4(0.45f, 0.0f, 0.8f, 0.1f)), "a sphere reaching past the quad's edge is visible");
+		check(!buffer.isOccluded(glm::vec4(0.0f, 0.0f, 0.5f, 0.1f)), "a sphere crossing the quad is visible");
+	}
+
+	/**
+	 * The simplified occluder is made of the original's triangles, without unused vertices
+	 */
+	void testSimplifyOccluder()
+	{
+		// a bumpy 32 x 32 grid and one vertex no triangle uses
+		constexpr uint32_t SIZE{ 32 };
+		std::vector<glm::vec3>	positions	{ glm::vec3(0.0f) };
+		std::vector<uint32_t>	indices		{};
+		for (uint32_t y = 0; y <= SIZE; y++)
+		{
+			for (uint32_t x = 0; x <= SIZE; x++)
+			{
+				const float fx{ static_cast<float>(x) };
+				const float fy{ static_cast<float>(y) };
+				positions.push_back(glm::vec3(fx * (1.0f + fx / SIZE), fy, static_cast<float>((x * 7 + y * 3) % 5) * 0.1f));
+			}
+		}
+		for (uint32_t y = 0; y < SIZE; y++)
+		{
+			for (uint32_t x = 0; x < SIZE; x++)
+			{
+				const uint32_t corner{ 1 + y * (SIZE + 1) + x };
+				indices.insert(indices.end(), { corner, corner + 1, corner + SIZE + 2, corner, corner + SIZE + 2, corner + SIZE + 1 });
+			}
+		}
+
+		const ash::OccluderMesh simplified{ ash::simplifyOccluder(positions, indices, 256) };
+		check(simplified.getTriangleCount() == 256, "the budget is filled");
+
+		bool fromOriginal{ true };
+		for (size_t i = 0; i + 2 < simplified.indices.size(); i += 3)
+		{
+			bool found{ false };
+			for (size_t j = 0; j + 2 < indices.size() && !found; j += 3)
+			{
+				found = simplified.positions[simplified.indices[i]] == positions[indices[j]]
+					&& simplified.positions[simplified.indices[i + 1]] == positions[indices[j + 1]]
+					&& simplified.positions[simplified.indices[i + 2]] == positions[indices[j + 2]];
+			}
+			fromOriginal = fromOriginal && found;
+		}
+		check(fromOriginal, "every simplified triangle is a triangle of the original");
+
+		std::vector<bool> used(simplified.positions.size(), false);
+		for (uint32_t index : simplified.indices)
+		{
+			used[index] = true;
+		}
+		check(std::all_of(used.begin(), used.end(), [](bool isUsed) { return isUsed; }), "every simplified vertex is used");
+
+		const ash::OccluderMesh again{ ash::simplifyOccluder(positions, indices, 256) };
+		check(again.indices == simplified.indices && again.positions == simplified.positions, "simplifying again gives the same mesh");
+	}
+}
+
+int main()
+{
+	testDeterminism();
+	testConservativeCoverage();
+	testOcclusionQueries();
+	testSimplifyOccluder();
+
+	if (failures > 0)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All tests passed" << std::endl;
+	return EXIT_SUCCESS;
+}